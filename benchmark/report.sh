@@ -0,0 +1,69 @@
+#!/bin/bash
+#
+# Compares the governors of a results.csv written by run.sh. For each workload
+# and governor the mean runtime, energy and energy-delay product (EDP) are
+# printed, also relative to a baseline governor.
+
+BASELINE="performance"
+
+usage() {
+	echo "Usage: $0 [-b BASELINE_GOVERNOR ($BASELINE)] <results.csv>"
+}
+
+while getopts "hb:" option; do
+	case $option in
+		b) BASELINE="$OPTARG" ;;
+		h) usage; exit 0 ;;
+		*) usage; exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+if [ $# -ne 1 ]; then
+	usage
+	exit 1
+fi
+
+awk -F, -v baseline="$BASELINE" '
+NR == 1 { next }
+{
+	key = $2 SUBSEP $1
+	if (!(key in runs)) {
+		order[++key_count] = key
+	}
+	runs[key]++
+	runtime[key] += $4
+	runtime_sq[key] += $4 * $4
+	if ($5 != "") {
+		energy_runs[key]++
+		energy[key] += $5
+	}
+}
+function relative(value, base) {
+	return (base > 0) ? sprintf("%+.1f%%", (value / base - 1) * 100) : "-"
+}
+END {
+	printf "%-10s %-12s %4s %12s %10s %12s %14s %10s %10s %10s\n", "workload", "governor", "runs", \
+		"runtime_s", "stddev_s", "energy_j", "edp_js", "d_runtime", "d_energy", "d_edp"
+	for (i = 1; i <= key_count; i++) {
+		key = order[i]
+		split(key, parts, SUBSEP)
+		mean_runtime[key] = runtime[key] / runs[key]
+		variance = runtime_sq[key] / runs[key] - mean_runtime[key] ^ 2
+		stddev[key] = (variance > 0 ? sqrt(variance) : 0)
+		mean_energy[key] = (energy_runs[key] ? energy[key] / energy_runs[key] : -1)
+		edp[key] = (mean_energy[key] >= 0 ? mean_energy[key] * mean_runtime[key] : -1)
+	}
+	for (i = 1; i <= key_count; i++) {
+		key = order[i]
+		split(key, parts, SUBSEP)
+		base = parts[1] SUBSEP baseline
+		has_base = (base in runs)
+		printf "%-10s %-12s %4d %12.3f %10.3f %12s %14s %10s %10s %10s\n", parts[1], parts[2], runs[key], \
+			mean_runtime[key], stddev[key], \
+			(mean_energy[key] >= 0 ? sprintf("%.3f", mean_energy[key]) : "-"), \
+			(edp[key] >= 0 ? sprintf("%.3f", edp[key]) : "-"), \
+			(has_base ? relative(mean_runtime[key], mean_runtime[base]) : "-"), \
+			(has_base && mean_energy[key] >= 0 ? relative(mean_energy[key], mean_energy[base]) : "-"), \
+			(has_base && edp[key] >= 0 ? relative(edp[key], edp[base]) : "-")
+	}
+}' "$1" | { read -r header; echo "$header"; sort -k1,1 -s; }
@@ -0,0 +1,178 @@
+#!/bin/bash
+#
+# Runs the workloads under each governor and records runtime, package energy
+# (RAPL via powercap, if available) and, for memutil, the governor log.
+# Results are appended to <output_dir>/results.csv, use report.sh to compare
+# the governors. Has to be run as root.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+WORKLOAD="$SCRIPT_DIR/workload"
+LOGDEMUX="$SCRIPT_DIR/../src/tools/memutil-logdemux"
+MEMUTIL_LOG="/sys/kernel/debug/memutil/log"
+POWERCAP="/sys/class/powercap"
+
+GOVERNORS="memutil schedutil performance powersave"
+REPETITIONS=3
+OUTPUT_DIR="results"
+PAUSE_S=5
+# name and arguments of each workload, the work is fixed so runtimes are comparable
+WORKLOADS=(
+	"stream stream -s 512 -n 40"
+	"chase chase -s 512 -n 100000000"
+	"dense dense -d 128 -n 400"
+	"phases phases -s 256 -d 128 -n 20 -p 10"
+	"mixed mixed -s 128 -d 128 -n 20"
+)
+
+usage() {
+	echo "Usage: $0 [-g \"GOVERNORS\" ($GOVERNORS) | -r REPETITIONS ($REPETITIONS) | -o OUTPUT_DIR ($OUTPUT_DIR) |"
+	echo "          -w \"WORKLOAD ...\" (all) | -p PAUSE_S ($PAUSE_S)]"
+	echo ""
+	echo "Workloads:"
+	for workload in "${WORKLOADS[@]}"; do
+		echo "	$workload"
+	done
+}
+
+SELECTED_WORKLOADS=""
+while getopts "hg:r:o:w:p:" option; do
+	case $option in
+		g) GOVERNORS="$OPTARG" ;;
+		r) REPETITIONS="$OPTARG" ;;
+		o) OUTPUT_DIR="$OPTARG" ;;
+		w) SELECTED_WORKLOADS="$OPTARG" ;;
+		p) PAUSE_S="$OPTARG" ;;
+		h) usage; exit 0 ;;
+		*) usage; exit 1 ;;
+	esac
+done
+
+if [ "$UID" -ne 0 ]; then
+	echo "Run this script as root to change the governor"
+	exit 1
+fi
+if [ ! -x "$WORKLOAD" ]; then
+	make -C "$SCRIPT_DIR"
+fi
+
+# Package domains (intel-rapl:N, not the subdomains intel-rapl:N:M)
+RAPL_DOMAINS=$(ls -d "$POWERCAP"/intel-rapl:[0-9]* 2>/dev/null | grep -E 'intel-rapl:[0-9]+$' || true)
+
+# Prints the energy counter (uJ) of each package, empty if not available
+read_energy_uj() {
+	local domain
+	for domain in $RAPL_DOMAINS; do
+		echo -n "$(cat "$domain/energy_uj") "
+	done
+}
+
+# Prints the energy (J) used by all packages between two read_energy_uj calls
+energy_delta_j() {
+	local start=($1) end=($2) total=0 index=0 delta domain
+	for domain in $RAPL_DOMAINS; do
+		delta=$((${end[$index]} - ${start[$index]}))
+		if [ "$delta" -lt 0 ]; then
+			# the counter wrapped around
+			delta=$((delta + $(cat "$domain/max_energy_range_uj")))
+		fi
+		total=$((total + delta))
+		index=$((index + 1))
+	done
+	awk "BEGIN { printf \"%.3f\", $total / 1000000 }"
+}
+
+ORIGINAL_GOVERNOR=$(cat /sys/devices/system/cpu/cpufreq/policy0/scaling_governor)
+
+set_governor() {
+	local policy
+	for policy in /sys/devices/system/cpu/cpufreq/policy*; do
+		echo "$1" > "$policy/scaling_governor"
+	done
+}
+
+LOGDEMUX_PID=""
+cleanup() {
+	if [ -n "$LOGDEMUX_PID" ]; then
+		kill -INT "$LOGDEMUX_PID" 2>/dev/null || true
+		wait "$LOGDEMUX_PID" 2>/dev/null || true
+	fi
+	set_governor "$ORIGINAL_GOVERNOR"
+}
+trap cleanup EXIT
+
+# Whether the given workload was selected with -w
+is_selected() {
+	[ -z "$SELECTED_WORKLOADS" ] || [[ " $SELECTED_WORKLOADS " == *" $1 "* ]]
+}
+
+# memutil-logdemux appends to its files, so the logs of an earlier run would be mixed into the new ones
+for governor in $GOVERNORS; do
+	for workload in "${WORKLOADS[@]}"; do
+		read -r name arguments <<< "$workload"
+		for repetition in $(seq 1 "$REPETITIONS"); do
+			log_dir="$OUTPUT_DIR/log/$governor-$name-$repetition"
+			if is_selected "$name" && [ -e "$log_dir" ]; then
+				echo "Log directory $log_dir already exists, remove it or choose another output directory"
+				exit 1
+			fi
+		done
+	done
+done
+
+mkdir -p "$OUTPUT_DIR"
+RESULTS="$OUTPUT_DIR/results.csv"
+if [ ! -f "$RESULTS" ]; then
+	echo "governor,workload,repetition,runtime_s,energy_j" > "$RESULTS"
+fi
+if [ -z "$RAPL_DOMAINS" ]; then
+	echo "No RAPL package domains found, energy is not recorded"
+fi
+
+for governor in $GOVERNORS; do
+	if ! set_governor "$governor" 2>/dev/null; then
+		echo "Cannot use governor $governor (is the module loaded?), skipping"
+		continue
+	fi
+	for workload in "${WORKLOADS[@]}"; do
+		read -r name arguments <<< "$workload"
+		if ! is_selected "$name"; then
+			continue
+		fi
+		for repetition in $(seq 1 "$REPETITIONS"); do
+			sleep "$PAUSE_S"
+
+			if [ "$governor" = "memutil" ] && [ -x "$LOGDEMUX" ] && [ -e "$MEMUTIL_LOG" ]; then
+				log_dir="$OUTPUT_DIR/log/$governor-$name-$repetition"
+				mkdir -p "$log_dir"
+				# drop what was logged before the run
+				cat "$MEMUTIL_LOG" > /dev/null
+				"$LOGDEMUX" -s "$MEMUTIL_LOG" -i 200 "$log_dir" 2> "$log_dir/logdemux.txt" &
+				LOGDEMUX_PID=$!
+			fi
+
+			energy_start=$(read_energy_uj)
+			start=$(date +%s%N)
+			"$WORKLOAD" $arguments > /dev/null
+			end=$(date +%s%N)
+			energy_end=$(read_energy_uj)
+
+			if [ -n "$LOGDEMUX_PID" ]; then
+				# memutil-logdemux drains the log a last time on SIGINT, the wait
+				# makes sure the end of the run is in the files before they are used
+				kill -INT "$LOGDEMUX_PID"
+				wait "$LOGDEMUX_PID" || true
+				LOGDEMUX_PID=""
+			fi
+
+			energy=""
+			if [ -n "$RAPL_DOMAINS" ]; then
+				energy=$(energy_delta_j "$energy_start" "$energy_end")
+			fi
+			runtime=$(awk "BEGIN { printf \"%.3f\", ($end - $start) / 1000000000 }")
+			echo "$governor,$name,$repetition,$runtime,$energy" >> "$RESULTS"
+			echo "$governor $name #$repetition: ${runtime}s ${energy:-?}J"
+		done
+	done
+done
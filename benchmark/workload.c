@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * workload.c
+ *
+ * Parametrized workloads for evaluating the governor on the cases its
+ * heuristics target. Every workload does a fixed amount of work (not a fixed
+ * time), so runtime and energy can be compared across governors.
+ *
+ *   stream: STREAM-like triad over large arrays (memory bandwidth bound)
+ *   chase:  Pointer chasing through a random cycle (memory latency bound)
+ *   dense:  Dense matrix multiplication on cache resident data (compute bound)
+ *   phases: Alternates between stream and dense phases
+ *   mixed:  Multiple threads, each running stream, chase or dense
+ *
+ * phases and mixed count their work in stream passes and convert it into
+ * multiplications and steps with a rough cost model (see work_units), so that
+ * the memory and compute bound parts take about as long as each other.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE 64
+#define MAX_THREADS 256
+
+/*
+ * Rough cost model of a typical core, used to give every kind of work in phases
+ * and mixed the estimated time of one stream pass. The work itself stays fixed,
+ * so runtimes are still comparable across governors.
+ */
+#define STREAM_BYTES_PER_NS 10
+#define DENSE_FMAS_PER_NS 4
+#define CHASE_NS_PER_STEP 100
+
+/**
+ * struct workload_config - Parameters of a workload run
+ *
+ * @size_mb: Size of the working set in MiB (stream, chase)
+ * @dimension: Dimension of the matrices (dense)
+ * @iterations: Amount of work: passes over the arrays (stream), steps (chase),
+ *              multiplications (dense), iterations per phase (phases)
+ * @phases: Amount of phases (phases)
+ * @threads: Amount of threads (mixed)
+ */
+struct workload_config {
+	size_t size_mb;
+	size_t dimension;
+	uint64_t iterations;
+	unsigned int phases;
+	unsigned int threads;
+};
+
+/* One element of the pointer chasing cycle, padded to a cache line */
+struct chase_node {
+	struct chase_node *next;
+	char padding[CACHE_LINE_SIZE - sizeof(struct chase_node *)];
+};
+
+/* Prevent the compiler from optimizing the results away */
+static volatile double double_sink;
+static volatile uintptr_t pointer_sink;
+
+static void *alloc_aligned(size_t size)
+{
+	void *memory = NULL;
+
+	if (posix_memalign(&memory, CACHE_LINE_SIZE, size) != 0) {
+		fprintf(stderr, "Failed to allocate %zu bytes\n", size);
+		exit(EXIT_FAILURE);
+	}
+	memset(memory, 0, size);
+	return memory;
+}
+
+static double now_seconds(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * run_stream - STREAM triad a = b + s * c over three arrays that together have
+ *              the size of the working set.
+ */
+static void run_stream(size_t size_mb, uint64_t iterations)
+{
+	size_t count = size_mb * 1024 * 1024 / (3 * sizeof(double));
+	double *a = alloc_aligned(count * sizeof(double));
+	double *b = alloc_aligned(count * sizeof(double));
+	double *c = alloc_aligned(count * sizeof(double));
+	uint64_t iteration;
+	size_t i;
+
+	for (i = 0; i < count; ++i) {
+		b[i] = 1.0;
+		c[i] = 2.0;
+	}
+	for (iteration = 0; iteration < iterations; ++iteration) {
+		for (i = 0; i < count; ++i) {
+			a[i] = b[i] + 3.0 * c[i];
+		}
+		//make the passes depend on each other
+		b[iteration % count] = a[(iteration * 7) % count];
+	}
+	double_sink = a[count / 2];
+	free(a);
+	free(b);
+	free(c);
+}
+
+/**
+ * run_chase - Follow a random cycle through the working set (Sattolo's
+ *             algorithm), one cache line per step.
+ */
+static void run_chase(size_t size_mb, uint64_t steps)
+{
+	size_t count = size_mb * 1024 * 1024 / sizeof(struct chase_node);
+	struct chase_node *nodes = alloc_aligned(count * sizeof(struct chase_node));
+	size_t *order = malloc(count * sizeof(size_t));
+	struct chase_node *node;
+	uint64_t random = 88172645463325252ULL;
+	size_t i, j, tmp;
+
+	if (!order || count < 2) {
+		fprintf(stderr, "Invalid working set size\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < count; ++i) {
+		order[i] = i;
+	}
+	for (i = count - 1; i > 0; --i) {
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		j = random % i;
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	for (i = 0; i < count; ++i) {
+		nodes[order[i]].next = &nodes[order[(i + 1) % count]];
+	}
+	free(order);
+
+	node = &nodes[0];
+	for (; steps > 0; --steps) {
+		node = node->next;
+	}
+	pointer_sink = (uintptr_t)node;
+	free(nodes);
+}
+
+/**
+ * run_dense - Multiply two dimension x dimension matrices iterations times.
+ *             Keep the dimension small enough for the matrices to stay in
+ *             the cache (e.g. 128 => 3 * 128 KiB).
+ */
+static void run_dense(size_t dimension, uint64_t iterations)
+{
+	size_t elements = dimension * dimension;
+	double *a = alloc_aligned(elements * sizeof(double));
+	double *b = alloc_aligned(elements * sizeof(double));
+	double *c = alloc_aligned(elements * sizeof(double));
+	uint64_t iteration;
+	size_t i, j, k;
+
+	for (i = 0; i < elements; ++i) {
+		a[i] = (double)(i % 7) / 7.0;
+		b[i] = (double)(i % 5) / 5.0;
+	}
+	for (iteration = 0; iteration < iterations; ++iteration) {
+		for (i = 0; i < dimension; ++i) {
+			for (k = 0; k < dimension; ++k) {
+				double value = a[i * dimension + k];
+
+				for (j = 0; j < dimension; ++j) {
+					c[i * dimension + j] += value * b[k * dimension + j];
+				}
+			}
+		}
+		a[iteration % elements] = c[(iteration * 3) % elements] * 1e-9;
+	}
+	double_sink = c[elements / 2];
+	free(a);
+	free(b);
+	free(c);
+}
+
+/**
+ * struct work_units - Work of each kind that takes about as long as one stream
+ *                     pass over the working set according to the cost model
+ *
+ * @dense: Matrix multiplications
+ * @chase: Pointer chasing steps
+ */
+struct work_units {
+	uint64_t dense;
+	uint64_t chase;
+};
+
+static struct work_units work_units(const struct workload_config *config)
+{
+	uint64_t pass_ns = config->size_mb * 1024 * 1024 / STREAM_BYTES_PER_NS;
+	uint64_t multiplication_fmas = (uint64_t)config->dimension * config->dimension * config->dimension;
+	struct work_units units = {
+		.dense = pass_ns * DENSE_FMAS_PER_NS / multiplication_fmas,
+		.chase = pass_ns / CHASE_NS_PER_STEP,
+	};
+
+	if (units.dense == 0) {
+		units.dense = 1;
+	}
+	if (units.chase == 0) {
+		units.chase = 1;
+	}
+	return units;
+}
+
+static void run_phases(const struct workload_config *config)
+{
+	struct work_units units = work_units(config);
+	unsigned int phase;
+
+	for (phase = 0; phase < config->phases; ++phase) {
+		if (phase % 2 == 0) {
+			run_stream(config->size_mb, config->iterations);
+		} else {
+			run_dense(config->dimension, config->iterations * units.dense);
+		}
+	}
+}
+
+struct mixed_thread {
+	pthread_t thread;
+	unsigned int index;
+	const struct workload_config *config;
+};
+
+static void *mixed_thread_fn(void *data)
+{
+	struct mixed_thread *thread = data;
+	const struct workload_config *config = thread->config;
+	struct work_units units = work_units(config);
+
+	switch (thread->index % 3) {
+	case 0:
+		run_stream(config->size_mb, config->iterations);
+		break;
+	case 1:
+		run_chase(config->size_mb, config->iterations * units.chase);
+		break;
+	default:
+		run_dense(config->dimension, config->iterations * units.dense);
+		break;
+	}
+	return NULL;
+}
+
+static int run_mixed(const struct workload_config *config)
+{
+	struct mixed_thread threads[MAX_THREADS];
+	unsigned int i;
+
+	if (config->threads == 0 || config->threads > MAX_THREADS) {
+		fprintf(stderr, "Invalid amount of threads (1 - %d)\n", MAX_THREADS);
+		return -1;
+	}
+	for (i = 0; i < config->threads; ++i) {
+		threads[i].index = i;
+		threads[i].config = config;
+		if (pthread_create(&threads[i].thread, NULL, mixed_thread_fn, &threads[i]) != 0) {
+			fprintf(stderr, "Failed to create thread %u\n", i);
+			return -1;
+		}
+	}
+	for (i = 0; i < config->threads; ++i) {
+		pthread_join(threads[i].thread, NULL);
+	}
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s stream|chase|dense|phases|mixed [-s SIZE_MB | -d DIMENSION | -n ITERATIONS | -p PHASES | -t THREADS]\n"
+		"\n"
+		"Runs a fixed amount of work and prints the runtime.\n"
+		"Parameters:\n"
+		"\t-s SIZE_MB: Working set of stream and chase (256)\n"
+		"\t-d DIMENSION: Matrix dimension of dense (128)\n"
+		"\t-n ITERATIONS: Passes (stream), steps (chase), multiplications (dense),\n"
+		"\t               per phase (phases) or per thread (mixed), in the latter two\n"
+		"\t               counted in stream passes that dense and chase are scaled to (10)\n"
+		"\t-p PHASES: Amount of alternating stream / dense phases (10)\n"
+		"\t-t THREADS: Threads of mixed, running stream, chase and dense in turn (number of cpus)\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct workload_config config = {
+		.size_mb = 256,
+		.dimension = 128,
+		.iterations = 10,
+		.phases = 10,
+		.threads = sysconf(_SC_NPROCESSORS_ONLN),
+	};
+	const char *workload;
+	double start;
+	int option, result = 0;
+
+	if (argc < 2 || argv[1][0] == '-') {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	workload = argv[1];
+	optind = 2;
+	while ((option = getopt(argc, argv, "hs:d:n:p:t:")) != -1) {
+		switch (option) {
+		case 's':
+			config.size_mb = strtoull(optarg, NULL, 10);
+			break;
+		case 'd':
+			config.dimension = strtoull(optarg, NULL, 10);
+			break;
+		case 'n':
+			config.iterations = strtoull(optarg, NULL, 10);
+			break;
+		case 'p':
+			config.phases = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			config.threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (config.size_mb == 0 || config.dimension == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	start = now_seconds();
+	if (strcmp(workload, "stream") == 0) {
+		run_stream(config.size_mb, config.iterations);
+	} else if (strcmp(workload, "chase") == 0) {
+		run_chase(config.size_mb, config.iterations);
+	} else if (strcmp(workload, "dense") == 0) {
+		run_dense(config.dimension, config.iterations);
+	} else if (strcmp(workload, "phases") == 0) {
+		run_phases(&config);
+	} else if (strcmp(workload, "mixed") == 0) {
+		result = run_mixed(&config);
+	} else {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (result) {
+		return EXIT_FAILURE;
+	}
+	printf("%s,%.6f\n", workload, now_seconds() - start);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_app_hint.c
+ *
+ * Implementation file for the application phase hints.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#include "memutil_app_hint.h"
+
+#define APP_HINT_HASH_BITS 8
+
+/**
+ * struct app_hint - Hint of one thread
+ *
+ * @node: Entry in app_hints
+ * @rcu: Frees the entry after the readers are done
+ * @pid: The thread (global pid)
+ * @hint: The announced hint
+ * @expires_ns: local_clock() timestamp at which the hint expires
+ */
+struct app_hint {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	pid_t pid;
+	int hint;
+	u64 expires_ns;
+};
+
+static DEFINE_HASHTABLE(app_hints, APP_HINT_HASH_BITS);
+/* Protects the entries of app_hints, app_hint_count and app_hint_enabled against concurrent writers */
+static DEFINE_SPINLOCK(app_hint_lock);
+static unsigned int app_hint_count;
+/* Whether the device accepts hints, false after the last user is gone */
+static bool app_hint_enabled;
+/* Protects app_hint_users */
+static DEFINE_MUTEX(app_hint_mutex);
+static unsigned int app_hint_users;
+static DEFINE_PER_CPU(bool, app_hint_pending);
+
+/**
+ * find_hint - Find the entry of the given thread, NULL if it has none. Has to
+ *             be called with app_hint_lock or the RCU read lock held.
+ */
+static struct app_hint *find_hint(pid_t pid)
+{
+	struct app_hint *entry;
+
+	hash_for_each_possible_rcu(app_hints, entry, node, pid) {
+		if (entry->pid == pid) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * remove_hint - Remove the given entry. Has to be called with app_hint_lock held.
+ */
+static void remove_hint(struct app_hint *entry)
+{
+	hash_del_rcu(&entry->node);
+	kfree_rcu(entry, rcu);
+	app_hint_count--;
+}
+
+/**
+ * remove_expired_hints - Remove the entries of the threads whose hint expired
+ *                        (or which exited). Has to be called with app_hint_lock
+ *                        held.
+ */
+static void remove_expired_hints(u64 time)
+{
+	struct app_hint *entry;
+	struct hlist_node *tmp;
+	int bucket;
+
+	hash_for_each_safe(app_hints, bucket, tmp, entry, node) {
+		if ((s64)(time - entry->expires_ns) >= 0) {
+			remove_hint(entry);
+		}
+	}
+}
+
+static int set_hint(pid_t pid, int hint, u64 expires_ns, u64 time)
+{
+	struct app_hint *entry, *new_entry;
+	int return_value = 0;
+
+	//allocated up front, as the allocation must not happen under the spinlock
+	new_entry = kzalloc(sizeof(*new_entry), GFP_KERNEL);
+	if (!new_entry) {
+		return -ENOMEM;
+	}
+	new_entry->pid = pid;
+	new_entry->hint = hint;
+	new_entry->expires_ns = expires_ns;
+
+	spin_lock(&app_hint_lock);
+	if (!app_hint_enabled) {
+		return_value = -ENODEV;
+		goto unlock;
+	}
+	entry = find_hint(pid);
+	if (hint == MEMUTIL_APP_HINT_NONE) {
+		if (entry) {
+			remove_hint(entry);
+		}
+		goto unlock;
+	}
+	if (entry) {
+		//the update hook may read the fields concurrently, a mix of both hints expires soon enough
+		WRITE_ONCE(entry->hint, hint);
+		WRITE_ONCE(entry->expires_ns, expires_ns);
+		goto unlock;
+	}
+	if (app_hint_count >= MEMUTIL_APP_HINT_MAX_THREADS) {
+		remove_expired_hints(time);
+		if (app_hint_count >= MEMUTIL_APP_HINT_MAX_THREADS) {
+			return_value = -ENOSPC;
+			goto unlock;
+		}
+	}
+	hash_add_rcu(app_hints, &new_entry->node, pid);
+	app_hint_count++;
+	new_entry = NULL;
+
+unlock:
+	spin_unlock(&app_hint_lock);
+	kfree(new_entry);
+	return return_value;
+}
+
+static long app_hint_ioctl(struct file *file, unsigned int command, unsigned long argument)
+{
+	struct memutil_app_hint_request request;
+	u64 time;
+	int return_value;
+
+	if (command != MEMUTIL_APP_HINT_IOC_SET) {
+		return -ENOTTY;
+	}
+	if (copy_from_user(&request, (void __user *)argument, sizeof(request))) {
+		return -EFAULT;
+	}
+	if (request.hint > MEMUTIL_APP_HINT_LATENCY || request.ttl_ms > MEMUTIL_APP_HINT_MAX_TTL_MS) {
+		return -EINVAL;
+	}
+	if (request.ttl_ms == 0) {
+		request.hint = MEMUTIL_APP_HINT_NONE;
+	}
+
+	time = local_clock();
+	return_value = set_hint(task_pid_nr(current), request.hint, time + (u64)request.ttl_ms * NSEC_PER_MSEC,
+				time);
+	if (return_value == 0) {
+		//the thread most likely still runs on this cpu
+		raw_cpu_write(app_hint_pending, true);
+	}
+	return return_value;
+}
+
+static const struct file_operations app_hint_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = app_hint_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.llseek = noop_llseek,
+};
+
+static struct miscdevice app_hint_device = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "memutil",
+	.fops = &app_hint_fops,
+};
+
+int memutil_app_hint_get(void)
+{
+	int return_value = 0;
+
+	mutex_lock(&app_hint_mutex);
+	if (app_hint_users == 0) {
+		spin_lock(&app_hint_lock);
+		app_hint_enabled = true;
+		spin_unlock(&app_hint_lock);
+		return_value = misc_register(&app_hint_device);
+		if (return_value) {
+			spin_lock(&app_hint_lock);
+			app_hint_enabled = false;
+			spin_unlock(&app_hint_lock);
+			goto unlock;
+		}
+	}
+	app_hint_users++;
+
+unlock:
+	mutex_unlock(&app_hint_mutex);
+	return return_value;
+}
+
+void memutil_app_hint_put(void)
+{
+	struct app_hint *entry;
+	struct hlist_node *tmp;
+	int bucket;
+
+	mutex_lock(&app_hint_mutex);
+	if (--app_hint_users == 0) {
+		misc_deregister(&app_hint_device);
+		//files that are still open cannot add hints anymore
+		spin_lock(&app_hint_lock);
+		app_hint_enabled = false;
+		hash_for_each_safe(app_hints, bucket, tmp, entry, node) {
+			remove_hint(entry);
+		}
+		spin_unlock(&app_hint_lock);
+	}
+	mutex_unlock(&app_hint_mutex);
+}
+
+int memutil_app_hint_current(u64 time)
+{
+	struct app_hint *entry;
+	int hint = MEMUTIL_APP_HINT_NONE;
+
+	rcu_read_lock();
+	entry = find_hint(task_pid_nr(current));
+	if (entry && (s64)(time - READ_ONCE(entry->expires_ns)) < 0) {
+		hint = READ_ONCE(entry->hint);
+	}
+	rcu_read_unlock();
+	return hint;
+}
+
+bool memutil_app_hint_announced(void)
+{
+	if (likely(!this_cpu_read(app_hint_pending))) {
+		return false;
+	}
+	this_cpu_write(app_hint_pending, false);
+	return true;
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_app_hint.h
+ *
+ * Header file for the application phase hints. An application often knows
+ * that it enters a memory bound (e.g. a scan) or compute bound phase before
+ * the counters of the next interval show it. Through the misc device
+ * /dev/memutil a thread can announce the phase it is in for a limited time:
+ *
+ *   memory:   The frequency is capped at the lowest frequency that loses at most
+ *             MEMUTIL_APP_HINT_BUDGET for a stall share of
+ *             MEMUTIL_APP_HINT_MEMORY_SHARE (stall model of slowdown_budget),
+ *             or lower if the counters show even more stalls.
+ *   compute:  The frequency is raised to policy->max. The package caps
+ *             (saturation, power cap) still apply.
+ *   latency:  The frequency is raised to policy->max after the package caps,
+ *             like a uclamp_min boost.
+ *
+ * The hints are stored per thread (by pid) and applied by the update hook of
+ * the cpu the thread currently runs on, as the hook runs in the context of
+ * the cpu's current task. Announcing a hint triggers a frequency update at
+ * the next scheduler callback of the thread's cpu, so the new phase does not
+ * wait for the update interval to pass.
+ *
+ * The ioctl interface (the part outside of __KERNEL__) can be included from
+ * userspace.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_APP_HINT_H
+#define _MEMUTIL_APP_HINT_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* Hints, MEMUTIL_APP_HINT_NONE removes the hint of the thread */
+#define MEMUTIL_APP_HINT_NONE 0
+#define MEMUTIL_APP_HINT_MEMORY 1
+#define MEMUTIL_APP_HINT_COMPUTE 2
+#define MEMUTIL_APP_HINT_LATENCY 3
+
+/* Longest time (in milliseconds) a hint is valid, longer phases renew their hint */
+#define MEMUTIL_APP_HINT_MAX_TTL_MS 10000
+
+/**
+ * struct memutil_app_hint_request - Argument of MEMUTIL_APP_HINT_IOC_SET
+ *
+ * @hint: One of the MEMUTIL_APP_HINT_* values
+ * @ttl_ms: Time (in milliseconds, at most MEMUTIL_APP_HINT_MAX_TTL_MS) after
+ *          which the hint expires, 0 removes the hint
+ */
+struct memutil_app_hint_request {
+	__u32 hint;
+	__u32 ttl_ms;
+};
+
+/* Set the hint of the calling thread, replacing its previous hint */
+#define MEMUTIL_APP_HINT_IOC_SET _IOW('M', 1, struct memutil_app_hint_request)
+
+#ifdef __KERNEL__
+
+/* Stall share (in permille) that is assumed for the memory hint */
+#define MEMUTIL_APP_HINT_MEMORY_SHARE 600
+/* Slowdown budget (in permille) of the memory hint */
+#define MEMUTIL_APP_HINT_BUDGET 100
+/* Largest amount of threads with a hint */
+#define MEMUTIL_APP_HINT_MAX_THREADS 1024
+
+/**
+ * memutil_app_hint_get - Register the misc device if this is its first user.
+ *
+ *                        Returns 0 on success, otherwise an error code.
+ *                        This function may sleep.
+ */
+int memutil_app_hint_get(void);
+/**
+ * memutil_app_hint_put - Deregister the misc device and drop all hints if this
+ *                        was its last user. The update hooks of the users must
+ *                        not run anymore.
+ *
+ *                        This function may sleep.
+ */
+void memutil_app_hint_put(void);
+/**
+ * memutil_app_hint_current - Get the hint of the current task.
+ *
+ *                            Returns the hint, MEMUTIL_APP_HINT_NONE if the
+ *                            task has none or it expired.
+ *                            This function does not sleep.
+ * @time: Current local_clock() timestamp
+ */
+int memutil_app_hint_current(u64 time);
+/**
+ * memutil_app_hint_announced - Check whether a hint was announced on the
+ *                              current cpu since the last call, and clear
+ *                              the announcement.
+ *
+ *                              This function does not sleep.
+ */
+bool memutil_app_hint_announced(void);
+
+#endif //__KERNEL__
+
+#endif //_MEMUTIL_APP_HINT_H
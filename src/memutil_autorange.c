@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_autorange.c
+ *
+ * Implementation file for the online auto-ranging of the heuristic thresholds.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifdef __KERNEL__
+#include <linux/math.h>
+#include <linux/minmax.h>
+#include <linux/string.h>
+#else
+#include <string.h>
+#endif
+
+#include "memutil_autorange.h"
+
+/* Weight of one sample, so that the decay keeps some precision */
+#define SAMPLE_WEIGHT 16
+/* The range moves 1 / 2^ADAPTATION_SHIFT of the way to the target per step */
+#define ADAPTATION_SHIFT 3
+
+void memutil_autorange_init(struct memutil_autorange *autorange, const struct memutil_heuristic_params *initial)
+{
+	memset(autorange, 0, sizeof(*autorange));
+	autorange->min_ratio_x16 = initial->min_ratio * 16;
+	autorange->max_ratio_x16 = initial->max_ratio * 16;
+}
+
+/**
+ * bucket_ratio - The ratio (in percent) a bucket stands for (its center)
+ */
+static s32 bucket_ratio(unsigned int bucket)
+{
+	return bucket * MEMUTIL_AUTORANGE_BUCKET_WIDTH + MEMUTIL_AUTORANGE_BUCKET_WIDTH / 2;
+}
+
+/**
+ * decay_and_find_percentiles - Decay the histogram and find the buckets of
+ *                              the low and high percentile in the same pass.
+ *
+ *                              Returns false if the histogram is empty.
+ */
+static bool decay_and_find_percentiles(struct memutil_autorange *autorange, s32 *low, s32 *high)
+{
+	u64 total = 0, cumulative = 0, low_weight, high_weight;
+	unsigned int i;
+	bool found_low = false;
+
+	for (i = 0; i < MEMUTIL_AUTORANGE_BUCKETS; ++i) {
+		total += autorange->histogram[i];
+	}
+	if (total == 0) {
+		return false;
+	}
+	low_weight = total * MEMUTIL_AUTORANGE_LOW_PERCENTILE / 100;
+	high_weight = total * MEMUTIL_AUTORANGE_HIGH_PERCENTILE / 100;
+	*low = bucket_ratio(0);
+	*high = bucket_ratio(MEMUTIL_AUTORANGE_BUCKETS - 1);
+	for (i = 0; i < MEMUTIL_AUTORANGE_BUCKETS; ++i) {
+		cumulative += autorange->histogram[i];
+		if (!found_low && cumulative > low_weight) {
+			*low = bucket_ratio(i);
+			found_low = true;
+		}
+		if (cumulative >= high_weight && cumulative - autorange->histogram[i] < high_weight) {
+			*high = bucket_ratio(i);
+		}
+		//rounded up, so that buckets of an old phase decay to zero
+		autorange->histogram[i] -= DIV_ROUND_UP(autorange->histogram[i], 8);
+	}
+	return true;
+}
+
+/**
+ * apply_guard_rails - Write the current range into the bounds of params that
+ *                     are not fixed, enforcing the minimum spread and
+ *                     non-negative thresholds.
+ */
+static void apply_guard_rails(struct memutil_autorange *autorange, bool keep_min, bool keep_max,
+			      struct memutil_heuristic_params *params)
+{
+	s32 min_ratio = keep_min ? params->min_ratio : autorange->min_ratio_x16 / 16;
+	s32 max_ratio = keep_max ? params->max_ratio : autorange->max_ratio_x16 / 16;
+	s32 center;
+
+	if (keep_min && keep_max) {
+		return;
+	}
+	if (max_ratio - min_ratio < MEMUTIL_AUTORANGE_MIN_SPREAD) {
+		if (keep_min) {
+			max_ratio = min_ratio + MEMUTIL_AUTORANGE_MIN_SPREAD;
+		} else if (keep_max) {
+			min_ratio = max_ratio - MEMUTIL_AUTORANGE_MIN_SPREAD;
+		} else {
+			center = (min_ratio + max_ratio) / 2;
+			min_ratio = center - MEMUTIL_AUTORANGE_MIN_SPREAD / 2;
+			max_ratio = min_ratio + MEMUTIL_AUTORANGE_MIN_SPREAD;
+		}
+	}
+	if (min_ratio < 0 && !keep_min) {
+		if (!keep_max) {
+			max_ratio -= min_ratio;
+		}
+		min_ratio = 0;
+	}
+	if (!keep_min) {
+		params->min_ratio = min_ratio;
+	}
+	if (!keep_max) {
+		params->max_ratio = max_ratio;
+	}
+}
+
+void memutil_autorange_update(struct memutil_autorange *autorange, s64 ratio, bool keep_min, bool keep_max,
+			      struct memutil_heuristic_params *params)
+{
+	unsigned int bucket = min_t(s64, ratio / MEMUTIL_AUTORANGE_BUCKET_WIDTH, MEMUTIL_AUTORANGE_BUCKETS - 1);
+	s32 low, high;
+
+	autorange->histogram[bucket] += SAMPLE_WEIGHT;
+	if (++autorange->samples_since_decay < MEMUTIL_AUTORANGE_DECAY_INTERVAL) {
+		return;
+	}
+	autorange->samples_since_decay = 0;
+	if (!decay_and_find_percentiles(autorange, &low, &high)) {
+		return;
+	}
+	if (autorange->steps < MEMUTIL_AUTORANGE_WARMUP_STEPS) {
+		autorange->steps++;
+		return;
+	}
+	autorange->min_ratio_x16 += (low * 16 - autorange->min_ratio_x16) >> ADAPTATION_SHIFT;
+	autorange->max_ratio_x16 += (high * 16 - autorange->max_ratio_x16) >> ADAPTATION_SHIFT;
+	apply_guard_rails(autorange, keep_min, keep_max, params);
+}
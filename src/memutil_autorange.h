@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_autorange.h
+ *
+ * Header file for the online auto-ranging of the heuristic thresholds. Each
+ * policy keeps an exponentially decayed histogram of the ratios (stalls per
+ * cycle or IPC) it observed over the last couple of seconds. The low and high
+ * percentiles of the histogram slowly pull the interpolation range of the
+ * heuristic towards the values the cpu actually runs, so that the full
+ * frequency range is used on every workload mix.
+ *
+ * Like memutil_heuristic.c this is also compiled into the userspace simulator.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_AUTORANGE_H
+#define _MEMUTIL_AUTORANGE_H
+
+#include "memutil_heuristic.h"
+
+/*
+ * Amount and width (in percent) of the histogram buckets. The last bucket
+ * also collects all larger ratios (IPC > 5.1).
+ */
+#define MEMUTIL_AUTORANGE_BUCKETS 256
+#define MEMUTIL_AUTORANGE_BUCKET_WIDTH 2
+/* Percentiles that become the min / max of the interpolation */
+#define MEMUTIL_AUTORANGE_LOW_PERCENTILE 5
+#define MEMUTIL_AUTORANGE_HIGH_PERCENTILE 95
+/*
+ * The histogram decays by 1/8 every MEMUTIL_AUTORANGE_DECAY_INTERVAL decisions,
+ * i.e. the horizon is roughly 8 * 128 decisions (~5s at the usual 5ms update
+ * interval). The decay is rounded up, so that the buckets of an old phase reach
+ * zero. The range is adapted at the same time.
+ */
+#define MEMUTIL_AUTORANGE_DECAY_INTERVAL 128
+/* Guard rail: minimum distance (in percent) between min and max */
+#define MEMUTIL_AUTORANGE_MIN_SPREAD 10
+/* Decay steps (warm-up) before the range is adapted for the first time */
+#define MEMUTIL_AUTORANGE_WARMUP_STEPS 2
+
+/**
+ * struct memutil_autorange - Auto-ranging state of one policy. Only accessed
+ *                            by the policy's cpu.
+ *
+ * @histogram: Decayed weights of the observed ratios
+ * @samples_since_decay: Decisions since the last decay step
+ * @steps: Amount of decay steps so far (saturates)
+ * @min_ratio_x16: Current min of the range (in percent, * 16)
+ * @max_ratio_x16: Current max of the range (in percent, * 16)
+ */
+struct memutil_autorange {
+	u32 histogram[MEMUTIL_AUTORANGE_BUCKETS];
+	u32 samples_since_decay;
+	u32 steps;
+	s32 min_ratio_x16;
+	s32 max_ratio_x16;
+};
+
+/**
+ * memutil_autorange_init - Initialize the auto-ranging state
+ * @autorange: The state to initialize
+ * @initial: The range to start from (the configured or calibrated thresholds)
+ */
+void memutil_autorange_init(struct memutil_autorange *autorange, const struct memutil_heuristic_params *initial);
+/**
+ * memutil_autorange_update - Record the ratio of one decision and, every
+ *                            MEMUTIL_AUTORANGE_DECAY_INTERVAL decisions, move
+ *                            params a bit towards the observed percentiles.
+ *
+ *                            This function does not sleep.
+ * @autorange: The state of the policy
+ * @ratio: Ratio (in percent) of the decision, has to be >= 0
+ * @keep_min: Whether params->min_ratio is fixed (e.g. set by the user), the
+ *            minimum spread is then kept by moving max_ratio only
+ * @keep_max: Whether params->max_ratio is fixed, like keep_min
+ * @params: The interpolation range that is adapted
+ */
+void memutil_autorange_update(struct memutil_autorange *autorange, s64 ratio, bool keep_min, bool keep_max,
+			      struct memutil_heuristic_params *params);
+
+#endif //_MEMUTIL_AUTORANGE_H
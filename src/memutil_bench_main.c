@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_bench_main.c
+ *
+ * Self-benchmark module for the memutil hot path. On insertion it drives the
+ * decision code path of the governor (perf counter reads, memutil_decide_frequency()
+ * and a log entry built with memutil_init_log_entry() written into a ringbuffer),
+ * i.e. the same code the update hook runs with the default configuration,
+ * millions of times on a growing set of cpus (1, 2, 4, ...,
+ * all online cpus), each time without and with a concurrent thread that drains
+ * the ringbuffers like a log reader does. The results (ns per decision and the
+ * scalability compared to a single cpu) are printed to the kernel log.
+ *
+ * The frequency is never changed. The optional features of the update hook
+ * (energy, feedback, probing, phase detection and the package coordination)
+ * keep state per policy or package and are not part of the benchmark. By default the software event cpu-clock is
+ * used for all counters, so the benchmark also runs inside VMs without a PMU.
+ *
+ * Build with "make bench", then run "insmod memutil_bench.ko" and check dmesg.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/perf_event.h>
+#include <linux/preempt.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/topology.h>
+
+#include "memutil_heuristic.h"
+#include "memutil_perf_counter.h"
+#include "memutil_perf_read_local.h"
+#include "memutil_ringbuffer_log.h"
+
+/* The amount of perf events read per decision, the same as in memutil_main.c (see MEMUTIL_VALUE_*) */
+#define BENCH_EVENT_COUNT 3
+/* Decisions that are done with preemption disabled, between two preemption points */
+#define BENCH_CHUNK_SIZE 1024
+/* Frequency range (in KHz) the heuristic interpolates in */
+#define BENCH_MIN_FREQ 800000
+#define BENCH_MAX_FREQ 3000000
+
+static unsigned long iterations = 1000000;
+static int slowdown_budget = 0;
+static unsigned int ringbuffer_size = 2000;
+static char *event_name1 = "cpu-clock";
+static char *event_name2 = "cpu-clock";
+static char *event_name3 = "cpu-clock";
+
+module_param(iterations, ulong, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(iterations, "Decisions per cpu and run");
+module_param(slowdown_budget, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(slowdown_budget, "Benchmark the slowdown budget heuristic with this budget (permille), 0 for the offcore stalls heuristic");
+module_param(ringbuffer_size, uint, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ringbuffer_size, "Size of the log ringbuffers (in elements)");
+module_param(event_name1, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(event_name1, "First perf counter name");
+module_param(event_name2, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(event_name2, "Second perf counter name (used as cycles)");
+module_param(event_name3, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(event_name3, "Third perf counter name (used as stalls)");
+
+/**
+ * struct bench_cpu - Benchmark state of one cpu
+ *
+ * @cpu: The cpu
+ * @events: The perf events read with every decision
+ * @last_event_value: The last value each event had
+ * @last_freq: The last calculated frequency
+ * @logbuffer: Ringbuffer the decisions are logged into
+ * @thread: Worker thread bound to the cpu (during a run)
+ * @duration_ns: Time the worker needed for all decisions of the last run
+ * @error: Error that occurred during the last run (0 if none)
+ */
+struct bench_cpu {
+	unsigned int cpu;
+	struct perf_event *events[BENCH_EVENT_COUNT];
+	u64 last_event_value[BENCH_EVENT_COUNT];
+	unsigned int last_freq;
+	struct memutil_ringbuffer *logbuffer;
+	struct task_struct *thread;
+	u64 duration_ns;
+	int error;
+};
+
+/** Benchmark state, indexed by cpu */
+static struct bench_cpu *bench_cpus;
+/** Released once all workers of a run are created, so they start together */
+static DECLARE_COMPLETION(start_completion);
+/** Completed by the last worker of a run that finishes */
+static DECLARE_COMPLETION(workers_done);
+static atomic_t running_workers;
+
+static struct memutil_heuristic_params heuristic_params = {
+	.min_ratio = 10,
+	.max_ratio = 65,
+};
+/* HEURISTIC_OFFCORE_STALLS, or HEURISTIC_SLOWDOWN_BUDGET if a budget is set, like in the governor */
+static int heuristic = HEURISTIC_OFFCORE_STALLS;
+
+/**
+ * bench_decision - Do one decision with the decision and log entry code of
+ *                  memutil_update_frequency(), except for setting the frequency.
+ *
+ *                  Returns 0 on success, otherwise the error of the perf read.
+ * @bench: The state of the current cpu
+ */
+static int bench_decision(struct bench_cpu *bench)
+{
+	struct memutil_log_entry entry;
+	u64 values[BENCH_EVENT_COUNT];
+	u64 absolute_value, enabled_time, running_time;
+	s64 ratio;
+	int i, return_value;
+
+	for (i = 0; i < BENCH_EVENT_COUNT; ++i) {
+		return_value = memutil_perf_event_read_local(bench->events[i], &absolute_value,
+							     &enabled_time, &running_time);
+		if (unlikely(return_value)) {
+			return return_value;
+		}
+		values[i] = absolute_value - bench->last_event_value[i];
+		bench->last_event_value[i] = absolute_value;
+	}
+
+	bench->last_freq = memutil_decide_frequency(heuristic, values, BENCH_MAX_FREQ, BENCH_MIN_FREQ,
+						    bench->last_freq, &heuristic_params, &ratio);
+
+	memutil_init_log_entry(&entry, local_clock(), values, bench->cpu, bench->last_freq);
+	memutil_write_ringbuffer(bench->logbuffer, &entry, 1);
+	return 0;
+}
+
+/**
+ * wait_for_stop - Sleep until kthread_stop() is called for the current thread
+ */
+static void wait_for_stop(void)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop()) {
+			break;
+		}
+		schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+}
+
+/**
+ * bench_worker - Thread function of the worker that is bound to one cpu
+ * @data: The struct bench_cpu of the cpu
+ */
+static int bench_worker(void *data)
+{
+	struct bench_cpu *bench = data;
+	unsigned long i, j, chunk;
+	u64 start_ns;
+
+	wait_for_completion(&start_completion);
+
+	bench->error = 0;
+	start_ns = local_clock();
+	for (i = 0; i < iterations && !bench->error; i += chunk) {
+		chunk = min_t(unsigned long, iterations - i, BENCH_CHUNK_SIZE);
+		//the hook runs with preemption disabled as well
+		preempt_disable();
+		for (j = 0; j < chunk; ++j) {
+			bench->error = bench_decision(bench);
+			if (unlikely(bench->error)) {
+				break;
+			}
+		}
+		preempt_enable();
+		cond_resched();
+	}
+	bench->duration_ns = local_clock() - start_ns;
+
+	if (atomic_dec_and_test(&running_workers)) {
+		complete(&workers_done);
+	}
+	wait_for_stop();
+	return 0;
+}
+
+/**
+ * bench_drainer - Thread function of the drainer, which takes the content out
+ *                 of the ringbuffers of all cpus of the run until it is stopped.
+ * @data: The cpumask of the run
+ */
+static int bench_drainer(void *data)
+{
+	const struct cpumask *cpus = data;
+	struct memutil_log_entry *entries;
+	unsigned int cpu;
+
+	entries = kvmalloc_array(ringbuffer_size, sizeof(*entries), GFP_KERNEL);
+	if (!entries) {
+		pr_warn("Memutil bench: Failed to allocate drainer buffer");
+		wait_for_stop();
+		return -ENOMEM;
+	}
+	while (!kthread_should_stop()) {
+		for_each_cpu(cpu, cpus) {
+			memutil_ringbuffer_take(bench_cpus[cpu].logbuffer, entries, ringbuffer_size);
+		}
+		cond_resched();
+	}
+	kvfree(entries);
+	return 0;
+}
+
+/**
+ * ns_per_op_x100 - Nanoseconds per decision of the last run of the given cpu,
+ *                  multiplied by 100
+ */
+static u64 ns_per_op_x100(struct bench_cpu *bench)
+{
+	return div64_u64(bench->duration_ns * 100, iterations);
+}
+
+/**
+ * bench_run - Run the benchmark once on the given cpus and print the results.
+ *
+ *             Returns the mean nanoseconds per decision (* 100) of the cpus,
+ *             0 if the run failed.
+ * @cpus: The cpus that run the benchmark at the same time
+ * @with_drainer: Whether a drainer thread runs concurrently
+ * @single_x100: Mean nanoseconds per decision (* 100) of the run on one cpu,
+ *               used for the scalability. 0 if not known yet.
+ * @print_cpus: Whether the result of every cpu should be printed
+ */
+static u64 bench_run(const struct cpumask *cpus, bool with_drainer, u64 single_x100, bool print_cpus)
+{
+	struct task_struct *drainer = NULL;
+	unsigned int cpu, created = 0;
+	u64 value, sum_x100 = 0, max_x100 = 0, mean_x100;
+	bool failed = false;
+
+	reinit_completion(&start_completion);
+	reinit_completion(&workers_done);
+	for_each_cpu(cpu, cpus) {
+		struct bench_cpu *bench = &bench_cpus[cpu];
+
+		bench->thread = kthread_create_on_cpu(bench_worker, bench, cpu, "memutil_bench/%u");
+		if (IS_ERR(bench->thread)) {
+			pr_err("Memutil bench: Failed to create worker for cpu %u: %pe", cpu, bench->thread);
+			bench->thread = NULL;
+			failed = true;
+			continue;
+		}
+		wake_up_process(bench->thread);
+		++created;
+	}
+	atomic_set(&running_workers, created);
+
+	if (with_drainer && created) {
+		drainer = kthread_create(bench_drainer, (void *)cpus, "memutil_bench_drain");
+		if (IS_ERR(drainer)) {
+			pr_err("Memutil bench: Failed to create drainer: %pe", drainer);
+			drainer = NULL;
+			failed = true;
+		} else {
+			//keep the drainer off the measured cpu if there is just one
+			if (cpumask_weight(cpus) == 1 && num_online_cpus() > 1) {
+				kthread_bind(drainer, cpumask_any_but(cpu_online_mask, cpumask_first(cpus)));
+			}
+			wake_up_process(drainer);
+		}
+	}
+
+	complete_all(&start_completion);
+	if (created) {
+		wait_for_completion(&workers_done);
+	}
+	if (drainer) {
+		kthread_stop(drainer);
+	}
+
+	for_each_cpu(cpu, cpus) {
+		struct bench_cpu *bench = &bench_cpus[cpu];
+
+		if (!bench->thread) {
+			continue;
+		}
+		kthread_stop(bench->thread);
+		bench->thread = NULL;
+		if (bench->error) {
+			pr_err("Memutil bench: Perf read failed on cpu %u: %d", cpu, bench->error);
+			failed = true;
+			continue;
+		}
+		value = ns_per_op_x100(bench);
+		sum_x100 += value;
+		max_x100 = max(max_x100, value);
+		if (print_cpus) {
+			pr_info("Memutil bench: drainer=%d cpu=%u ns_per_op=%llu.%02llu",
+				with_drainer, cpu, value / 100, value % 100);
+		}
+	}
+	if (failed || !created) {
+		return 0;
+	}
+
+	mean_x100 = div64_u64(sum_x100, created);
+	pr_info("Memutil bench: cpus=%u drainer=%d mean_ns_per_op=%llu.%02llu max_ns_per_op=%llu.%02llu "
+		"decisions_per_sec=%llu scalability=%llu%%",
+		created, with_drainer, mean_x100 / 100, mean_x100 % 100, max_x100 / 100, max_x100 % 100,
+		mean_x100 ? div64_u64((u64)created * NSEC_PER_SEC * 100, mean_x100) : 0,
+		single_x100 && mean_x100 ? div64_u64(single_x100 * 100, mean_x100) : 100);
+	return mean_x100;
+}
+
+/**
+ * bench_all - Run the benchmark on 1, 2, 4, ... and finally all online cpus,
+ *             first without and then with a concurrent drainer.
+ */
+static int bench_all(void)
+{
+	cpumask_var_t cpus;
+	unsigned int cpu, count, online = num_online_cpus();
+	u64 single_x100;
+	int drainer;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL)) {
+		return -ENOMEM;
+	}
+	for (drainer = 0; drainer <= 1; ++drainer) {
+		single_x100 = 0;
+		count = 1;
+		for (;;) {
+			cpumask_clear(cpus);
+			for_each_online_cpu(cpu) {
+				if (cpumask_weight(cpus) >= count) {
+					break;
+				}
+				cpumask_set_cpu(cpu, cpus);
+			}
+			if (count == 1) {
+				single_x100 = bench_run(cpus, drainer, 0, false);
+			} else {
+				bench_run(cpus, drainer, single_x100, count == online);
+			}
+			if (count == online) {
+				break;
+			}
+			count = min(count * 2, online);
+		}
+	}
+	free_cpumask_var(cpus);
+	return 0;
+}
+
+/**
+ * bench_setup_cpu - Allocate the perf events and the ringbuffer of one cpu
+ */
+static int bench_setup_cpu(unsigned int cpu)
+{
+	struct bench_cpu *bench = &bench_cpus[cpu];
+	char *event_names[BENCH_EVENT_COUNT] = {
+		event_name1,
+		event_name2,
+		event_name3
+	};
+	int return_value;
+
+	bench->cpu = cpu;
+	bench->last_freq = BENCH_MAX_FREQ;
+	return_value = memutil_allocate_perf_counters_for_cpu(cpu, event_names, bench->events, BENCH_EVENT_COUNT);
+	if (return_value) {
+		return return_value;
+	}
+	bench->logbuffer = memutil_open_ringbuffer(ringbuffer_size, cpu_to_node(cpu));
+	if (!bench->logbuffer) {
+		memutil_release_perf_events(bench->events, BENCH_EVENT_COUNT);
+		bench->events[0] = NULL;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void bench_teardown(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct bench_cpu *bench = &bench_cpus[cpu];
+
+		if (bench->logbuffer) {
+			memutil_close_ringbuffer(bench->logbuffer);
+			memutil_release_perf_events(bench->events, BENCH_EVENT_COUNT);
+		}
+	}
+	kfree(bench_cpus);
+	bench_cpus = NULL;
+	memutil_teardown_events_map();
+}
+
+static int __init memutil_bench_init(void)
+{
+	unsigned int cpu;
+	int return_value = 0;
+
+	if (iterations == 0 || ringbuffer_size == 0 || slowdown_budget < 0 || slowdown_budget > 1000) {
+		return -EINVAL;
+	}
+	if (slowdown_budget > 0) {
+		heuristic_params.slowdown_budget = slowdown_budget;
+		heuristic = HEURISTIC_SLOWDOWN_BUDGET;
+	}
+	if (memutil_setup_events_map() != 0) {
+		//portable events such as cpu-clock are still available
+		pr_warn("Memutil bench: No platform specific events available");
+	}
+	bench_cpus = kcalloc(nr_cpu_ids, sizeof(*bench_cpus), GFP_KERNEL);
+	if (!bench_cpus) {
+		memutil_teardown_events_map();
+		return -ENOMEM;
+	}
+	for_each_online_cpu(cpu) {
+		return_value = bench_setup_cpu(cpu);
+		if (return_value) {
+			pr_err("Memutil bench: Setup failed for cpu %u: %d", cpu, return_value);
+			goto out;
+		}
+	}
+
+	pr_info("Memutil bench: iterations=%lu events=%s,%s,%s ringbuffer_size=%u slowdown_budget=%d",
+		iterations, event_name1, event_name2, event_name3, ringbuffer_size, slowdown_budget);
+	return_value = bench_all();
+	pr_info("Memutil bench: done");
+out:
+	bench_teardown();
+	return return_value;
+}
+
+static void __exit memutil_bench_exit(void)
+{
+}
+
+module_init(memutil_bench_init);
+module_exit(memutil_bench_exit);
+
+MODULE_LICENSE(		"GPL");
+MODULE_AUTHOR(		"Erik Griese <erik.griese@student.hpi.de>, "
+			"Leon Matthes <leon.matthes@student.hpi.de>, "
+			"Maximilian Stiede <maximilian.stiede@student.hpi.de>");
+MODULE_DESCRIPTION(	"Self-benchmark for the hot path of the memutil CpuFreq governor.");
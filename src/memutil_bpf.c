@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_bpf.c
+ *
+ * Implementation file for the BPF kfuncs of the memory stall signal.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/cpumask.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
+
+#include "memutil_bpf.h"
+#include "memutil_idle_hint.h"
+
+#define WITH_KFUNCS (IS_ENABLED(CONFIG_DEBUG_INFO_BTF_MODULES) && LINUX_VERSION_CODE >= KERNEL_VERSION(6,9,0))
+
+#if WITH_KFUNCS
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+
+/**
+ * read_signal - Read the signal of the given cpu, all zero for an invalid cpu.
+ */
+static void read_signal(s32 cpu, struct memutil_signal *signal)
+{
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu)) {
+		*signal = (struct memutil_signal) {0};
+		return;
+	}
+	memutil_cpu_signal(cpu, signal);
+}
+
+__bpf_kfunc_start_defs();
+
+__bpf_kfunc u32 bpf_memutil_cpu_boundness(s32 cpu)
+{
+	struct memutil_signal signal;
+
+	read_signal(cpu, &signal);
+	return signal.boundness;
+}
+
+__bpf_kfunc u32 bpf_memutil_cpu_stall_share(s32 cpu)
+{
+	struct memutil_signal signal;
+
+	read_signal(cpu, &signal);
+	return signal.stall_share;
+}
+
+__bpf_kfunc u64 bpf_memutil_cpu_signal_time(s32 cpu)
+{
+	struct memutil_signal signal;
+
+	read_signal(cpu, &signal);
+	return signal.time_ns;
+}
+
+__bpf_kfunc_end_defs();
+
+BTF_KFUNCS_START(memutil_kfunc_ids)
+BTF_ID_FLAGS(func, bpf_memutil_cpu_boundness)
+BTF_ID_FLAGS(func, bpf_memutil_cpu_stall_share)
+BTF_ID_FLAGS(func, bpf_memutil_cpu_signal_time)
+BTF_KFUNCS_END(memutil_kfunc_ids)
+
+static const struct btf_kfunc_id_set memutil_kfunc_set = {
+	.owner = THIS_MODULE,
+	.set = &memutil_kfunc_ids,
+};
+
+int memutil_bpf_register(void)
+{
+	int return_value;
+
+	return_value = register_btf_kfunc_id_set(BPF_PROG_TYPE_STRUCT_OPS, &memutil_kfunc_set);
+	if (return_value) {
+		return return_value;
+	}
+	return register_btf_kfunc_id_set(BPF_PROG_TYPE_TRACING, &memutil_kfunc_set);
+}
+
+#else //WITH_KFUNCS
+
+int memutil_bpf_register(void)
+{
+	return -EOPNOTSUPP;
+}
+
+#endif //WITH_KFUNCS
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_bpf.h
+ *
+ * Header file for the BPF kfuncs that export the memory stall signal (see
+ * memutil_idle_hint.h) to BPF programs, e.g. sched_ext schedulers that place
+ * memory and compute bound tasks, so that they do not compete for the PMU
+ * with counters of their own. The kfuncs are available to struct_ops (e.g.
+ * sched_ext) and tracing programs:
+ *
+ *   u32 bpf_memutil_cpu_boundness(s32 cpu): smoothed stall share (in permille)
+ *                                           of the cpu's busy intervals
+ *   u32 bpf_memutil_cpu_stall_share(s32 cpu): stall share (in permille) of the
+ *                                             cpu's last busy interval
+ *   u64 bpf_memutil_cpu_signal_time(s32 cpu): timestamp (scheduler clock) of
+ *                                             the last busy interval
+ *
+ * All return 0 for invalid cpus and cpus memutil does not run on. A scheduler
+ * derives the boundness of a task by sampling the signal of the task's cpu
+ * when the task stops running (e.g. in ops.stopping) into task local storage.
+ *
+ * Needs a kernel with CONFIG_DEBUG_INFO_BTF_MODULES (Linux 6.9 or newer, for
+ * the kfunc set macros), otherwise the registration fails.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_BPF_H
+#define _MEMUTIL_BPF_H
+
+/**
+ * memutil_bpf_register - Register the kfuncs with the BPF verifier. The
+ *                        registration lasts until the module is unloaded, so
+ *                        it is only done once.
+ *
+ *                        Returns 0 on success, otherwise an error code.
+ *                        This function may sleep.
+ */
+int memutil_bpf_register(void);
+
+#endif //_MEMUTIL_BPF_H
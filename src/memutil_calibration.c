@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_calibration.c
+ *
+ * Implementation file for the startup calibration of the heuristic thresholds.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/compiler.h>
+#include <linux/minmax.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/preempt.h>
+#include <linux/sched/topology.h>
+#include <linux/smp.h>
+#include <linux/topology.h>
+
+#include "memutil_calibration.h"
+#include "memutil_perf_read_local.h"
+
+/*
+ * Size of the buffer the memory bound probe chases pointers through. It has
+ * to be much larger than the L2 cache (stalls_l2_miss) and should exceed the
+ * last level cache slice of a core so that the IPC drops as well.
+ */
+#define PROBE_BUFFER_SIZE (64 * 1024 * 1024)
+/* Pointer chasing steps of the memory bound probe (~100ns each) */
+#define PROBE_MEMORY_STEPS 100000
+/* Iterations of the compute bound probe */
+#define PROBE_COMPUTE_ITERATIONS 2000000
+/*
+ * Minimum distance (in percent) between the ratios of both probes. If the
+ * events do not separate the probes better, they are not usable for the
+ * heuristic and the configured thresholds are kept.
+ */
+#define MIN_RATIO_SPREAD 10
+/*
+ * Share of the measured range (in percent) that is cut off at both ends. The
+ * probes are the extremes, real workloads should reach min / max frequency
+ * before they are as compute / memory bound as the probes.
+ */
+#define RANGE_MARGIN_PERCENT 10
+
+/** One element of the probe buffer, padded to a cache line */
+struct probe_node {
+	u32 next;
+	u32 padding[15];
+};
+
+/**
+ * struct memutil_calibration_class - Calibration of one core type
+ *
+ * @capacity: The cpu capacity of the core type
+ * @max_freq: Maximum hardware frequency (in KHz) of the core type
+ * @compute_ratio: Ratio (in percent) measured by the compute bound probe
+ * @memory_ratio: Ratio (in percent) measured by the memory bound probe
+ * @params: Interpolation range derived from both ratios
+ * @valid: Whether the probes succeeded and the ratios are usable
+ */
+struct memutil_calibration_class {
+	unsigned long capacity;
+	unsigned int max_freq;
+	s64 compute_ratio;
+	s64 memory_ratio;
+	struct memutil_heuristic_params params;
+	bool valid;
+};
+
+/**
+ * struct calibration_probe - Input and output of the probes run on the cpu
+ *
+ * @events: The perf events (indexed by MEMUTIL_VALUE_*)
+ * @heuristic: The heuristic whose ratio is measured
+ * @nodes: Buffer for the memory bound probe
+ * @node_count: Amount of elements in nodes
+ * @compute_ratio: Set to the ratio measured by the compute bound probe
+ * @memory_ratio: Set to the ratio measured by the memory bound probe
+ */
+struct calibration_probe {
+	struct perf_event **events;
+	int heuristic;
+	struct probe_node *nodes;
+	u32 node_count;
+	s64 compute_ratio;
+	s64 memory_ratio;
+};
+
+static struct memutil_calibration_class calibration_classes[MEMUTIL_CALIBRATION_MAX_CLASSES];
+static unsigned int calibration_class_count;
+/* Serializes calibrations and protects calibration_classes */
+static DEFINE_MUTEX(calibration_mutex);
+
+/**
+ * init_probe_buffer - Link the probe buffer into one random cycle
+ *                     (Sattolo's algorithm), so that the hardware prefetchers
+ *                     cannot predict the next access.
+ */
+static void init_probe_buffer(struct probe_node *nodes, u32 node_count)
+{
+	u64 random = 88172645463325252ULL;
+	u32 i, j, tmp;
+
+	for (i = 0; i < node_count; ++i) {
+		nodes[i].next = i;
+	}
+	for (i = node_count - 1; i > 0; --i) {
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		j = random % i;
+		tmp = nodes[i].next;
+		nodes[i].next = nodes[j].next;
+		nodes[j].next = tmp;
+	}
+}
+
+static void run_compute_probe(void)
+{
+	u64 value = 1;
+	u32 i;
+
+	for (i = 0; i < PROBE_COMPUTE_ITERATIONS; ++i) {
+		value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+		OPTIMIZER_HIDE_VAR(value);
+	}
+}
+
+static void run_memory_probe(struct calibration_probe *probe)
+{
+	u32 index = 0;
+	u32 i;
+
+	for (i = 0; i < PROBE_MEMORY_STEPS; ++i) {
+		index = READ_ONCE(probe->nodes[index].next);
+	}
+	OPTIMIZER_HIDE_VAR(index);
+}
+
+/**
+ * read_events - Read the absolute values of the probe's events on this cpu
+ */
+static int read_events(struct calibration_probe *probe, u64 *values)
+{
+	int i, return_value;
+
+	for (i = MEMUTIL_VALUE_INSTRUCTIONS; i <= MEMUTIL_VALUE_STALLS; ++i) {
+		return_value = memutil_perf_event_read_local(probe->events[i], &values[i], NULL, NULL);
+		if (return_value) {
+			return return_value;
+		}
+	}
+	return 0;
+}
+
+/**
+ * measure - Run one probe with preemption disabled and compute its ratio.
+ *
+ *           Returns 0 on success, otherwise an error code.
+ * @probe: The probe data
+ * @memory_bound: Whether the memory bound or the compute bound probe is run
+ * @ratio: Set to the measured ratio
+ */
+static int measure(struct calibration_probe *probe, bool memory_bound, s64 *ratio)
+{
+	u64 start[MEMUTIL_VALUE_STALLS + 1], end[MEMUTIL_VALUE_STALLS + 1];
+	s64 cycles, value;
+	int return_value;
+
+	preempt_disable();
+	return_value = read_events(probe, start);
+	if (!return_value) {
+		if (memory_bound) {
+			run_memory_probe(probe);
+		} else {
+			run_compute_probe();
+		}
+		return_value = read_events(probe, end);
+	}
+	preempt_enable();
+	if (return_value) {
+		return return_value;
+	}
+
+	cycles = end[MEMUTIL_VALUE_CYCLES] - start[MEMUTIL_VALUE_CYCLES];
+	if (cycles <= 0) {
+		return -ENODATA;
+	}
+	if (probe->heuristic == HEURISTIC_IPC) {
+		value = end[MEMUTIL_VALUE_INSTRUCTIONS] - start[MEMUTIL_VALUE_INSTRUCTIONS];
+	} else {
+		value = end[MEMUTIL_VALUE_STALLS] - start[MEMUTIL_VALUE_STALLS];
+	}
+	*ratio = memutil_ratio_percent(value, cycles);
+	return 0;
+}
+
+/**
+ * run_probes - Run both probes, called on the cpu that is calibrated
+ * @data: The struct calibration_probe
+ */
+static int run_probes(void *data)
+{
+	struct calibration_probe *probe = data;
+	int return_value;
+
+	//warm up the TLB and the caches that should be hit
+	run_memory_probe(probe);
+	run_compute_probe();
+
+	return_value = measure(probe, false, &probe->compute_ratio);
+	if (return_value) {
+		return return_value;
+	}
+	return measure(probe, true, &probe->memory_ratio);
+}
+
+/**
+ * calibrate_class - Run the probes on the given cpu and fill the calibration.
+ *
+ *                   Returns 0 if the probes ran (the calibration is only valid
+ *                   if they were told apart), otherwise the error, which may
+ *                   be transient, so the class is not kept.
+ * @class: The calibration to fill. capacity and max_freq have to be set.
+ */
+static int calibrate_class(struct memutil_calibration_class *class, unsigned int cpu,
+			    struct perf_event **events, int heuristic)
+{
+	struct calibration_probe probe = {
+		.events = events,
+		.heuristic = heuristic,
+		.node_count = PROBE_BUFFER_SIZE / sizeof(struct probe_node),
+	};
+	s64 low, high, margin;
+	int return_value;
+
+	probe.nodes = kvmalloc_node(PROBE_BUFFER_SIZE, GFP_KERNEL, cpu_to_node(cpu));
+	if (!probe.nodes) {
+		pr_warn("Memutil: Failed to allocate calibration buffer");
+		return -ENOMEM;
+	}
+	init_probe_buffer(probe.nodes, probe.node_count);
+	return_value = smp_call_on_cpu(cpu, run_probes, &probe, false);
+	kvfree(probe.nodes);
+	if (return_value) {
+		pr_warn("Memutil: Calibration probes failed on cpu %u: %d", cpu, return_value);
+		return return_value;
+	}
+
+	class->compute_ratio = probe.compute_ratio;
+	class->memory_ratio = probe.memory_ratio;
+	low = min(probe.compute_ratio, probe.memory_ratio);
+	high = max(probe.compute_ratio, probe.memory_ratio);
+	if (high - low < MIN_RATIO_SPREAD) {
+		pr_warn("Memutil: Calibration on cpu %u: events do not separate compute (%lld) and memory (%lld) bound probes",
+			cpu, probe.compute_ratio, probe.memory_ratio);
+		return 0;
+	}
+	margin = (high - low) * RANGE_MARGIN_PERCENT / 100;
+	class->params.min_ratio = low + margin;
+	class->params.max_ratio = high - margin;
+	class->valid = true;
+	pr_info("Memutil: Calibrated cpu %u (capacity=%lu, max_freq=%u): compute=%lld memory=%lld => range %d-%d",
+		cpu, class->capacity, class->max_freq, class->compute_ratio, class->memory_ratio,
+		class->params.min_ratio, class->params.max_ratio);
+	return 0;
+}
+
+int memutil_calibrate(struct cpufreq_policy *policy, struct perf_event **events, int heuristic,
+		      struct memutil_heuristic_params *params)
+{
+	struct memutil_calibration_class *class = NULL;
+	unsigned long capacity = arch_scale_cpu_capacity(policy->cpu);
+	unsigned int max_freq = policy->cpuinfo.max_freq;
+	unsigned int i;
+	int return_value = -ENODATA;
+
+	mutex_lock(&calibration_mutex);
+	for (i = 0; i < calibration_class_count; ++i) {
+		if (calibration_classes[i].capacity == capacity && calibration_classes[i].max_freq == max_freq) {
+			class = &calibration_classes[i];
+			break;
+		}
+	}
+	if (!class) {
+		if (calibration_class_count >= MEMUTIL_CALIBRATION_MAX_CLASSES) {
+			pr_warn("Memutil: Too many core types to calibrate");
+			goto out;
+		}
+		class = &calibration_classes[calibration_class_count];
+		*class = (struct memutil_calibration_class) {
+			.capacity = capacity,
+			.max_freq = max_freq,
+		};
+		return_value = calibrate_class(class, policy->cpu, events, heuristic);
+		if (return_value) {
+			//not kept, so that the next start of a cpu of this type tries again
+			goto out;
+		}
+		calibration_class_count++;
+	}
+	if (class->valid) {
+		*params = class->params;
+		return_value = 0;
+	} else {
+		return_value = -ENODATA;
+	}
+out:
+	mutex_unlock(&calibration_mutex);
+	return return_value;
+}
+
+void memutil_calibration_show(struct seq_file *seq)
+{
+	struct memutil_calibration_class *class;
+	unsigned int i;
+
+	mutex_lock(&calibration_mutex);
+	for (i = 0; i < calibration_class_count; ++i) {
+		class = &calibration_classes[i];
+		seq_printf(seq, "calibration%u=%lu,%u,%lld,%lld,%d,%d,%d\n", i, class->capacity, class->max_freq,
+			   class->compute_ratio, class->memory_ratio, class->params.min_ratio,
+			   class->params.max_ratio, class->valid);
+	}
+	mutex_unlock(&calibration_mutex);
+}
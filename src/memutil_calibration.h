@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_calibration.h
+ *
+ * Header file for the optional startup calibration of the heuristic
+ * thresholds. Two short probe loops are run on the cpu with the configured
+ * perf events: a compute bound loop (cache resident, few stalls, high IPC)
+ * and a memory bound loop (pointer chasing through a buffer much larger than
+ * the L2 cache, many stalls, low IPC). The interpolation range of the
+ * heuristic is derived from the ratios both probes measure.
+ *
+ * Cpus of the same core type (same capacity and maximum frequency) share
+ * one calibration, so the probes only run once per core type.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_CALIBRATION_H
+#define _MEMUTIL_CALIBRATION_H
+
+#include <linux/cpufreq.h>
+#include <linux/perf_event.h>
+#include <linux/seq_file.h>
+
+#include "memutil_heuristic.h"
+
+/* Maximum amount of core types whose calibration is remembered */
+#define MEMUTIL_CALIBRATION_MAX_CLASSES 8
+
+/**
+ * memutil_calibrate - Get the calibrated interpolation range for the cpu of the
+ *                     given policy. If its core type was not calibrated yet, the
+ *                     probes are run on the cpu (this takes a couple of ms).
+ *
+ *                     Returns 0 on success. If the events do not separate the
+ *                     probes (e.g. software events) or the probes fail, an
+ *                     error code is returned and params is not changed. Failed
+ *                     probes are not remembered, the next call for the core
+ *                     type runs them again.
+ *                     This function may sleep and must be called before the
+ *                     update hook of the policy is installed.
+ * @policy: The policy whose cpu should be calibrated
+ * @events: The perf events of the policy's cpu, indexed by MEMUTIL_VALUE_*
+ * @heuristic: HEURISTIC_IPC or HEURISTIC_OFFCORE_STALLS
+ * @params: Set to the calibrated interpolation range
+ */
+int memutil_calibrate(struct cpufreq_policy *policy, struct perf_event **events, int heuristic,
+		      struct memutil_heuristic_params *params);
+/**
+ * memutil_calibration_show - Print the calibration of each core type into the
+ *                            given seq_file, one line per core type:
+ *                            calibration<i>=<capacity>,<max_freq>,<compute_ratio>,
+ *                            <memory_ratio>,<min_ratio>,<max_ratio>,<valid>
+ *
+ *                            This function may sleep.
+ * @seq: The seq_file to print into
+ */
+void memutil_calibration_show(struct seq_file *seq);
+
+#endif //_MEMUTIL_CALIBRATION_H
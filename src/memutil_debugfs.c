@@ -15,11 +15,15 @@
 #include "memutil_debugfs.h"
 #include "memutil_debugfs_logfile.h"
 #include "memutil_debugfs_infofile.h"
+#include "memutil_debugfs_statsfile.h"
+#include "memutil_debugfs_timingfile.h"
+#include "memutil_debugfs_qtablefile.h"
+#include "memutil_debugfs_boundnessfile.h"
 
 /** The root memutil debugfs directory */
 static struct dentry *root_dir = NULL;
 
-int memutil_debugfs_init(struct memutil_infofile_data *infofile_data)
+int memutil_debugfs_init(struct memutil_infofile_data *infofile_data, bool with_qtable)
 {
 	int return_value = 0;
 	if (root_dir != NULL) {
@@ -42,9 +46,40 @@ int memutil_debugfs_init(struct memutil_infofile_data *infofile_data)
 		pr_warn("Memutil: Failed to initialize memutil debugfs info file");
 		goto infofile_error;
 	}
+	return_value = memutil_debugfs_statsfile_init(root_dir);
+	if (return_value != 0) {
+		pr_warn("Memutil: Failed to initialize memutil debugfs stats file");
+		goto statsfile_error;
+	}
+	return_value = memutil_debugfs_timingfile_init(root_dir);
+	if (return_value != 0) {
+		pr_warn("Memutil: Failed to initialize memutil debugfs timing file");
+		goto timingfile_error;
+	}
+	if (with_qtable) {
+		return_value = memutil_debugfs_qtablefile_init(root_dir);
+		if (return_value != 0) {
+			pr_warn("Memutil: Failed to initialize memutil debugfs qtable file");
+			goto qtablefile_error;
+		}
+	}
+	return_value = memutil_debugfs_boundnessfile_init(root_dir);
+	if (return_value != 0) {
+		pr_warn("Memutil: Failed to initialize memutil debugfs boundness file");
+		goto boundnessfile_error;
+	}
 	pr_info("Memutil: Initialized memutil debugfs (<debugfs>/memutil)");
 	return 0;
 
+boundnessfile_error:
+	//does nothing if the qtable file was not created
+	memutil_debugfs_qtablefile_exit();
+qtablefile_error:
+	memutil_debugfs_timingfile_exit();
+timingfile_error:
+	memutil_debugfs_statsfile_exit();
+statsfile_error:
+	memutil_debugfs_infofile_exit();
 infofile_error:
 	memutil_debugfs_logfile_exit();
 logfile_error:
@@ -58,6 +93,10 @@ void memutil_debugfs_exit(void)
 {
 	memutil_debugfs_logfile_exit();
 	memutil_debugfs_infofile_exit();
+	memutil_debugfs_statsfile_exit();
+	memutil_debugfs_timingfile_exit();
+	memutil_debugfs_qtablefile_exit();
+	memutil_debugfs_boundnessfile_exit();
 	debugfs_remove_recursive(root_dir);
 	root_dir = NULL;
 }
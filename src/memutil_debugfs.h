@@ -19,14 +19,19 @@
 /**
  * memutil_debugfs_init - Initialize the memutil debugfs directory.
  *                        This will create a folder
- *                        <debugfs>/memutil that contains a logfile called "log"
- *                        and an infofile called "info".
+ *                        <debugfs>/memutil that contains a logfile called "log",
+ *                        an infofile called "info", a statsfile called "stats",
+ *                        a timingfile called "timing", a boundnessfile called
+ *                        "boundness" and, with with_qtable, a qtablefile
+ *                        called "qtable".
  *                        This function may sleep.
  *                        If the function succeeds it returns 0, otherwise an
  *                        error code is returned.
  * @infofile_data: Data that the infofile should contain
+ * @with_qtable: Whether the qtablefile is created, i.e. whether the module was
+ *               built with the Q-learning heuristic
  */
-int memutil_debugfs_init(struct memutil_infofile_data *infofile_data);
+int memutil_debugfs_init(struct memutil_infofile_data *infofile_data, bool with_qtable);
 /**
  * memutil_debugfs_exit - Deinitialize the memutil debugfs directory. This removes
  *                        The directory in the debugfs.
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_boundnessfile.c
+ *
+ * Implementation file for the debugfs boundnessfile.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/seq_file.h>
+
+#include "memutil_debugfs_boundnessfile.h"
+#include "memutil_idle_hint.h"
+
+/** The boundnessfile filesystem entry */
+static struct dentry *boundness_file = NULL;
+
+static int boundness_show(struct seq_file *seq, void *unused)
+{
+	seq_puts(seq, "cpu,boundness,stall_share\n");
+	memutil_idle_hint_show(seq);
+	return 0;
+}
+
+static int boundness_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boundness_show, inode->i_private);
+}
+
+/**
+ * file operations for the boundnessfile
+ */
+static const struct file_operations fops_boundness = {
+	.owner = THIS_MODULE,
+	.open = boundness_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int memutil_debugfs_boundnessfile_init(struct dentry *root_dir)
+{
+	boundness_file = debugfs_create_file("boundness", S_IRUSR | S_IRGRP | S_IROTH, root_dir, NULL,
+					     &fops_boundness);
+	if (IS_ERR(boundness_file)) {
+		int return_value = PTR_ERR(boundness_file);
+
+		pr_warn("Memutil: Create file failed: %pe", boundness_file);
+		boundness_file = NULL;
+		return return_value;
+	}
+	return 0;
+}
+
+void memutil_debugfs_boundnessfile_exit(void)
+{
+	debugfs_remove(boundness_file);
+	boundness_file = NULL;
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_boundnessfile.h
+ *
+ * Header file for the debugfs boundnessfile. Reading the boundnessfile prints
+ * the memory stall signal of every cpu memutil runs on (see
+ * memutil_idle_hint.h), it cannot be written.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_DEBUGFS_BOUNDNESSFILE_H
+#define _MEMUTIL_DEBUGFS_BOUNDNESSFILE_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+
+/**
+ * memutil_debugfs_boundnessfile_init - Initialize / create the memutil
+ *                                      boundnessfile under the
+ *                                      <debugfs>/memutil folder
+ *
+ *                                      This function may sleep.
+ *                                      If the function succeeds it returns 0,
+ *                                      otherwise an error code is returned.
+ * @root_dir: Directory in which the boundnessfile should be created
+ */
+int memutil_debugfs_boundnessfile_init(struct dentry *root_dir);
+/**
+ * memutil_debugfs_boundnessfile_exit - Deinitialize / remove the boundnessfile
+ */
+void memutil_debugfs_boundnessfile_exit(void);
+
+#endif //_MEMUTIL_DEBUGFS_BOUNDNESSFILE_H
@@ -7,10 +7,12 @@
  * The debugfs infofile provides some information about memutil in a text file.
  * The information contains: The amount of cores that are online,
  * the interval with which memutil does frequency updates, the size of the log
- * ringbuffers. The format is:
+ * ringbuffers and the result of the calibration (if enabled). The format is:
  * core_count=<core_count>
  * update_interval=<update_interval_milliseconds>
  * log_ringbuffer_size=<log_ringbuffer_size>
+ * followed by one line per calibrated core type (see memutil_calibration.h):
+ * calibration<i>=<capacity>,<max_freq>,<compute_ratio>,<memory_ratio>,<min_ratio>,<max_ratio>,<valid>
  *
  * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
  *
@@ -45,7 +47,7 @@ struct memutil_infofile_data {
  *                                 If the function succeeds it returns 0, otherwise
  *                                 an error code is returned.
  * @root_dir: Directory in which the infofile should be created
- * @data: Data that the infofile will provide
+ * @data: Data that the infofile will provide. The data is copied.
  */
 int memutil_debugfs_infofile_init(struct dentry *root_dir, struct memutil_infofile_data *data);
 /**
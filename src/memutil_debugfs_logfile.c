@@ -12,134 +12,309 @@
  * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
  */
 
+#include <linux/cpumask.h>
 #include <linux/debugfs.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
-#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
 
 #include "memutil_debugfs_logfile.h"
 #include "memutil_ringbuffer_log.h"
 #include "memutil_printk_helper.h"
 
-/** The filesystem entry for the logfile */
+/** The filesystem entry for the logfile of all cpus */
 static struct dentry *log_file = NULL;
-
-/** Maximum amount of ringbuffers that may register to write to the logfile */
-#define MAX_RINGBUFFER_COUNT 32
-
-/*
- * The upper bound for the capcity can be calculated as ringbuffer_size * text_bytes_per_entry * ringbuffer_count
- * The text_bytes_per_entry specifies how many bytes are needed for one ringbuffer entry when it is formatted as text and appended
- * to the log.
- *
- * An example for a computer with 8 virtual cores would be 2000*130*8=2'080'000 ~ 2MB
- * Care has to be taken choosing the capcity as we do not want to waste memory or
- * run into performance issues but we also need enough room for all of our logging.
- * Especially with increasing core count the limit could become to small.
- * However as the logging is deterministic with consistent behaviour of how much
- * data is written in a given timeframe, this limit can be easily tuned experimentally.
- * In case not enough space is availabe a warning is printed to the kernel log.
- *
- * We did all of our tests with 2MB as the logfile capacity
- */
-#define LOGFILE_CAPACITY 2000000 //2MB
+/** The folder containing the per cpu logfiles */
+static struct dentry *cpu_log_dir = NULL;
+/** Serializes claiming and releasing the cpus of the readers */
+static DEFINE_MUTEX(claim_lock);
 
 /**
  * struct memutil_ringbuffer_registry - Structure for tracking which ringbuffers
- *                                      are registered to write to the logfile
- * @buffers: Array of the registered buffers
- * @count: Count of registered buffers
+ *                                      are registered to write to the logfiles.
+ *                                      Registration and unregistration are
+ *                                      serialized by the caller (memutil_main.c
+ *                                      holds its init mutex), readers only use RCU.
+ * @buffers: Array of the registered buffers, indexed by cpu
+ * @files: Array of the per cpu logfiles, indexed by cpu
+ * @claimed: Array of flags, indexed by cpu, whether an opened logfile reads
+ *           the cpu's ringbuffer. Reading takes the entries out of the
+ *           ringbuffer, so each cpu can only have one reader at a time,
+ *           protected by claim_lock.
+ * @size: Size of the arrays (nr_cpu_ids)
+ * @max_buffer_size: Size (in elements) of the largest registered buffer
  */
 struct memutil_ringbuffer_registry {
-	struct memutil_ringbuffer *buffers[MAX_RINGBUFFER_COUNT];
-	unsigned int count;
+	struct memutil_ringbuffer __rcu **buffers;
+	struct dentry **files;
+	bool *claimed;
+	unsigned int size;
+	u32 max_buffer_size;
 };
 
-/** Global variable to store the registered ringbuffers for the logfile */
+/** Global variable to store the registered ringbuffers for the logfiles */
 static struct memutil_ringbuffer_registry ringbuffers = {
-	.count = 0
+	.buffers = NULL,
+	.files = NULL,
+	.claimed = NULL,
+	.size = 0,
+	.max_buffer_size = 0
 };
 
 /**
- * struct memutil_logfile_data - structure to track information about the logfile
+ * struct memutil_log_reader - State of one opened logfile. Every reader drains
+ *                             the ringbuffers of its cpus into its own buffers,
+ *                             one cpu at a time, and passes the text on to the
+ *                             user.
  *
- * @data: The actual data contained in the file
- * @size_used: The size (in bytes) of the logfile that is currently filled with
- *             valid data
- * @size_total: The total size (in bytes) of the logfile (valid + free data)
+ * @lock: Serializes concurrent reads of the same opened file
+ * @first_cpu: The first cpu whose ringbuffer is read
+ * @end_cpu: One past the last cpu whose ringbuffer is read
+ * @next_cpu: The cpu whose ringbuffer is drained next
+ * @entries: Buffer for the entries taken out of a ringbuffer
+ * @entries_capacity: Size (in elements) of the entries buffer
+ * @text: The textual representation of the taken entries
+ * @text_size: Size (in bytes) of the text buffer
+ * @text_used: Amount of bytes in the text buffer that are valid
+ * @text_offset: Amount of valid bytes already passed on to the user
  */
-struct memutil_logfile_data {
-	void *data;
-	size_t size_used;
-	size_t size_total;
+struct memutil_log_reader {
+	struct mutex lock;
+	unsigned int first_cpu;
+	unsigned int end_cpu;
+	unsigned int next_cpu;
+	struct memutil_log_entry *entries;
+	u32 entries_capacity;
+	char *text;
+	size_t text_size;
+	size_t text_used;
+	size_t text_offset;
 };
 
-/** Global variable to track information about the logfile */
-static struct memutil_logfile_data *logfile_data = NULL;
+/*
+ * The private data of the logfiles is the cpu + 1 for the per cpu files and
+ * ALL_CPUS for the logfile that contains the data of all cpus.
+ */
+#define ALL_CPUS 0UL
+
+/**
+ * reader_ensure_capacity - Make sure the buffers of the given reader are large
+ *                          enough to take the content of any registered ringbuffer
+ *
+ *                          On success 0 is returned, otherwise an error code.
+ * @reader: The reader whose buffers are checked
+ */
+static int reader_ensure_capacity(struct memutil_log_reader *reader)
+{
+	u32 capacity = READ_ONCE(ringbuffers.max_buffer_size);
+
+	if (reader->entries_capacity >= capacity) {
+		return 0;
+	}
+	kvfree(reader->entries);
+	kvfree(reader->text);
+	reader->entries_capacity = 0;
+	reader->entries = kvmalloc_array(capacity, sizeof(struct memutil_log_entry), GFP_KERNEL);
+	reader->text_size = (size_t)capacity * MEMUTIL_LOG_ENTRY_TEXT_SIZE;
+	reader->text = kvmalloc(reader->text_size, GFP_KERNEL);
+	if (!reader->entries || !reader->text) {
+		pr_warn("Memutil: Failed to allocate memory for log reader");
+		kvfree(reader->entries);
+		kvfree(reader->text);
+		reader->entries = NULL;
+		reader->text = NULL;
+		return -ENOMEM;
+	}
+	reader->entries_capacity = capacity;
+	return 0;
+}
 
 /**
- * clear_log - Clear the log.
+ * reader_drain_cpu - Take the content of the ringbuffer of the given cpu (which
+ *                    clears the ringbuffer) and format it into the text buffer
+ *                    of the reader.
+ *
+ *                    On success 0 is returned, otherwise an error code.
+ * @reader: Reader into which the content should be taken
+ * @cpu: The cpu whose ringbuffer is drained
  */
-static void clear_log(void)
+static int reader_drain_cpu(struct memutil_log_reader *reader, unsigned int cpu)
 {
-	logfile_data->size_used = 0;
+	struct memutil_ringbuffer *buffer;
+	u32 count = 0;
+	int return_value;
+
+	return_value = reader_ensure_capacity(reader);
+	if (return_value) {
+		return return_value;
+	}
+
+	rcu_read_lock();
+	buffer = rcu_dereference(ringbuffers.buffers[cpu]);
+	if (buffer) {
+		count = memutil_ringbuffer_take(buffer, reader->entries, reader->entries_capacity);
+	}
+	rcu_read_unlock();
+
+	reader->text_used = memutil_format_log_entries(reader->entries, count, reader->text, reader->text_size);
+	reader->text_offset = 0;
+	return 0;
 }
 
 /**
- * user_read_log - Function that is called when the logfile is read from userspace.
- *                 All ringbuffers and the logfile are cleared after one complete
- *                 read of the logfile.
+ * claim_cpus - Claim the cpus from first_cpu to end_cpu (exclusive) for a
+ *              reader.
+ *
+ *              Returns 0 on success, -EBUSY if another opened logfile
+ *              already reads one of the cpus.
+ */
+static int claim_cpus(unsigned int first_cpu, unsigned int end_cpu)
+{
+	unsigned int cpu;
+	int return_value = 0;
+
+	mutex_lock(&claim_lock);
+	for (cpu = first_cpu; cpu < end_cpu; ++cpu) {
+		if (ringbuffers.claimed[cpu]) {
+			return_value = -EBUSY;
+			goto unlock;
+		}
+	}
+	for (cpu = first_cpu; cpu < end_cpu; ++cpu) {
+		ringbuffers.claimed[cpu] = true;
+	}
+unlock:
+	mutex_unlock(&claim_lock);
+	return return_value;
+}
+
+static void release_cpus(unsigned int first_cpu, unsigned int end_cpu)
+{
+	unsigned int cpu;
+
+	mutex_lock(&claim_lock);
+	for (cpu = first_cpu; cpu < end_cpu; ++cpu) {
+		ringbuffers.claimed[cpu] = false;
+	}
+	mutex_unlock(&claim_lock);
+}
+
+static int user_open_log(struct inode *inode, struct file *file)
+{
+	unsigned long private = (unsigned long)inode->i_private;
+	struct memutil_log_reader *reader;
+	int return_value;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader) {
+		return -ENOMEM;
+	}
+	mutex_init(&reader->lock);
+	if (private == ALL_CPUS) {
+		reader->first_cpu = 0;
+		reader->end_cpu = ringbuffers.size;
+	} else {
+		reader->first_cpu = private - 1;
+		reader->end_cpu = private;
+	}
+	reader->next_cpu = reader->first_cpu;
+	return_value = claim_cpus(reader->first_cpu, reader->end_cpu);
+	if (return_value) {
+		kfree(reader);
+		return return_value;
+	}
+	file->private_data = reader;
+	return nonseekable_open(inode, file);
+}
+
+static int user_release_log(struct inode *inode, struct file *file)
+{
+	struct memutil_log_reader *reader = file->private_data;
+
+	release_cpus(reader->first_cpu, reader->end_cpu);
+	kvfree(reader->entries);
+	kvfree(reader->text);
+	kfree(reader);
+	return 0;
+}
+
+/**
+ * user_read_log - Function that is called when a logfile is read from userspace.
+ *                 The ringbuffers of the file's cpus are drained one after
+ *                 another as the user reads. After one pass over all of them
+ *                 the end of the file is reported; reading on afterwards
+ *                 starts the next pass, so the file can be read continuously.
  * @file: The file that is read
  * @user_buf: Userspace buffer into which the content of the file should be written
  */
 static ssize_t user_read_log(struct file *file, char __user *user_buf, size_t count, loff_t *ppos)
 {
+	struct memutil_log_reader *reader = file->private_data;
 	ssize_t return_value;
-	unsigned int i;
-	if (ppos && *ppos == 0) {
-		//This function can be called multiple times to read the logfile
-		//entirely, hence only clear the logfile before a new read when
-		//we start at the beginning.
-		clear_log();
-		for (i = 0; i < ringbuffers.count; ++i) {
-			memutil_ringbuffer_append_to_logfile(ringbuffers.buffers[i]);
+	size_t available;
+
+	mutex_lock(&reader->lock);
+	while (reader->text_offset >= reader->text_used) {
+		if (reader->next_cpu >= reader->end_cpu) {
+			reader->next_cpu = reader->first_cpu;
+			return_value = 0;
+			goto out;
 		}
-	} else if (!ppos) {
-		pr_warn("Memutil: No ppos in read log");
+		return_value = reader_drain_cpu(reader, reader->next_cpu++);
+		if (return_value) {
+			goto out;
+		}
+	}
+	available = min(count, reader->text_used - reader->text_offset);
+	if (copy_to_user(user_buf, reader->text + reader->text_offset, available)) {
+		return_value = -EFAULT;
+		goto out;
 	}
-	return_value = simple_read_from_buffer(user_buf, count, ppos, logfile_data->data, logfile_data->size_used);
+	reader->text_offset += available;
+	*ppos += available;
+	return_value = available;
+out:
+	mutex_unlock(&reader->lock);
 	return return_value;
 }
 
 /**
- * file operations for the logfile
+ * file operations for the logfiles
  */
 static const struct file_operations fops_memutil = {
 	.owner = THIS_MODULE,
 	.read = user_read_log,
-	.open = simple_open,
-	.llseek = default_llseek,
+	.open = user_open_log,
+	.release = user_release_log,
+	.llseek = noop_llseek,
 };
 
 int memutil_debugfs_logfile_init(struct dentry *root_dir)
 {
 	int return_value = 0;
-	logfile_data = kzalloc(sizeof(struct memutil_logfile_data), GFP_KERNEL);
-	if (!logfile_data) {
-		pr_warn("Memutil: Alloc logfile_data failed");
+
+	ringbuffers.size = nr_cpu_ids;
+	ringbuffers.max_buffer_size = 0;
+	ringbuffers.buffers = kcalloc(ringbuffers.size, sizeof(*ringbuffers.buffers), GFP_KERNEL);
+	ringbuffers.files = kcalloc(ringbuffers.size, sizeof(*ringbuffers.files), GFP_KERNEL);
+	ringbuffers.claimed = kcalloc(ringbuffers.size, sizeof(*ringbuffers.claimed), GFP_KERNEL);
+	if (!ringbuffers.buffers || !ringbuffers.files || !ringbuffers.claimed) {
+		pr_warn("Memutil: Alloc ringbuffer registry failed");
 		return_value = -ENOMEM;
-		goto filedata_error;
+		goto registry_error;
 	}
-	logfile_data->data = vmalloc(LOGFILE_CAPACITY);
-	if (!logfile_data->data) {
-		pr_warn("Memutil: Alloc logfile_data's buf failed");
-		return_value = -ENOMEM;
-		goto filedata_buffer_error;
+
+	cpu_log_dir = debugfs_create_dir("logs", root_dir);
+	if (IS_ERR(cpu_log_dir)) {
+		pr_warn("Memutil: Create dir failed: %pe", cpu_log_dir);
+		return_value = PTR_ERR(cpu_log_dir);
+		goto dir_error;
 	}
-	logfile_data->size_used = 0;
-	logfile_data->size_total = LOGFILE_CAPACITY;
 
-	log_file = debugfs_create_file("log", S_IRUSR | S_IRGRP | S_IROTH, root_dir, logfile_data, &fops_memutil);
+	log_file = debugfs_create_file("log", S_IRUSR | S_IRGRP | S_IROTH, root_dir, (void *)ALL_CPUS, &fops_memutil);
 	if (IS_ERR(log_file)) {
 		pr_warn("Memutil: Create file failed: %pe", log_file);
 		return_value = PTR_ERR(log_file);
@@ -149,46 +324,71 @@ int memutil_debugfs_logfile_init(struct dentry *root_dir)
 
 file_error:
 	log_file = NULL;
-	vfree(logfile_data->data);
-filedata_buffer_error:
-	kfree(logfile_data);
-	logfile_data = NULL;
-filedata_error:
+	debugfs_remove_recursive(cpu_log_dir);
+dir_error:
+	cpu_log_dir = NULL;
+registry_error:
+	kfree(ringbuffers.buffers);
+	kfree(ringbuffers.files);
+	kfree(ringbuffers.claimed);
+	ringbuffers.buffers = NULL;
+	ringbuffers.files = NULL;
+	ringbuffers.claimed = NULL;
+	ringbuffers.size = 0;
 	return return_value;
 }
 
 void memutil_debugfs_logfile_exit(void)
 {
-	ringbuffers.count = 0;
-	vfree(logfile_data->data);
-	kfree(logfile_data);
-	logfile_data = NULL;
+	//removing the files waits for all readers that are currently reading
 	debugfs_remove(log_file);
 	log_file = NULL;
+	debugfs_remove_recursive(cpu_log_dir);
+	cpu_log_dir = NULL;
+
+	kfree(ringbuffers.buffers);
+	kfree(ringbuffers.files);
+	kfree(ringbuffers.claimed);
+	ringbuffers.buffers = NULL;
+	ringbuffers.files = NULL;
+	ringbuffers.claimed = NULL;
+	ringbuffers.size = 0;
+	ringbuffers.max_buffer_size = 0;
 }
 
-int memutil_debugfs_register_ringbuffer(struct memutil_ringbuffer *buffer)
+int memutil_debugfs_register_ringbuffer(struct memutil_ringbuffer *buffer, unsigned int cpu)
 {
-	debug_info("Memutil: Registering ringbuffer for logfile");
-	if (ringbuffers.count >= MAX_RINGBUFFER_COUNT) {
-		pr_warn("Memutil: Cannot register additional memutil ringbuffer");
+	char name[16];
+	struct dentry *file;
+
+	debug_info("Memutil: Registering ringbuffer for logfile (cpu=%u)", cpu);
+	if (cpu >= ringbuffers.size) {
+		pr_warn("Memutil: Cannot register memutil ringbuffer for cpu %u", cpu);
 		return -EINVAL;
 	}
-	ringbuffers.buffers[ringbuffers.count++] = buffer;
+	ringbuffers.max_buffer_size = max(ringbuffers.max_buffer_size, buffer->size);
+	rcu_assign_pointer(ringbuffers.buffers[cpu], buffer);
+
+	snprintf(name, sizeof(name), "cpu%u", cpu);
+	file = debugfs_create_file(name, S_IRUSR | S_IRGRP | S_IROTH, cpu_log_dir,
+				   (void *)(unsigned long)(cpu + 1), &fops_memutil);
+	if (IS_ERR(file)) {
+		//the data of the cpu is still available through the logfile of all cpus
+		pr_warn("Memutil: Create file failed: %pe", file);
+		file = NULL;
+	}
+	ringbuffers.files[cpu] = file;
 	return 0;
 }
 
-int memutil_debugfs_append_to_logfile(char *buffer, size_t buffer_size)
+void memutil_debugfs_unregister_ringbuffer(unsigned int cpu)
 {
-	if (logfile_data->size_used + buffer_size > logfile_data->size_total) {
-		pr_warn("Memutil: logfile is getting to large. Force clear");
-		clear_log();
-	}
-	if (logfile_data->size_total < buffer_size) {
-		pr_warn("Memutil: cleared logfile is to small for message");
-		return -EINVAL;
+	if (cpu >= ringbuffers.size) {
+		return;
 	}
-	memcpy(logfile_data->data + logfile_data->size_used, buffer, buffer_size);
-	logfile_data->size_used += buffer_size;
-	return 0;
+	debugfs_remove(ringbuffers.files[cpu]);
+	ringbuffers.files[cpu] = NULL;
+	RCU_INIT_POINTER(ringbuffers.buffers[cpu], NULL);
+	//wait for readers of the logfile of all cpus that may still use the buffer
+	synchronize_rcu();
 }
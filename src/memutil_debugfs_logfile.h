@@ -6,6 +6,15 @@
  * provides data that was logged to the user in the form of a text file. For
  * more information see the memutil architecture wiki page.
  *
+ * Besides the logfile "log" that contains the data of all cpus, there is one
+ * logfile per cpu in the "logs" folder (<debugfs>/memutil/logs/cpu<N>). Each
+ * reader drains the ringbuffers itself while reading, so readers of different
+ * per-cpu logfiles do not contend with each other and no global text buffer
+ * is needed, no matter the cpu count. As reading takes the entries out of the
+ * ringbuffers, a cpu can only be read by one opened logfile at a time: opening
+ * a logfile fails with -EBUSY while another opened logfile reads one of its
+ * cpus (e.g. "log" while "logs/cpu3" is open).
+ *
  * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
  *
  * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
@@ -20,8 +29,9 @@
 struct memutil_ringbuffer;
 
 /**
- * memutil_debugfs_logfile_init - Initialize / create the memutil logfile in the
- *                                "<debugfs>/memutil" folder.
+ * memutil_debugfs_logfile_init - Initialize / create the memutil logfile and the
+ *                                per cpu logfile folder in the "<debugfs>/memutil"
+ *                                folder.
  *
  *                                This function may sleep.
  *                                If this function succeeds it returns 0, otherwise
@@ -30,41 +40,38 @@ struct memutil_ringbuffer;
  */
 int memutil_debugfs_logfile_init(struct dentry *root_dir);
 /**
- * memutil_debugfs_logfile_exit - Deinitialize / remove the logfile from the memutil
+ * memutil_debugfs_logfile_exit - Deinitialize / remove the logfiles from the memutil
  *                                debugfs folder
  */
 void memutil_debugfs_logfile_exit(void);
 /**
- * memutil_debugfs_register_ringbuffer - Register the given ringbuffer as someone
- *                                       who wants to write log data to the logfile.
+ * memutil_debugfs_register_ringbuffer - Register the given ringbuffer as the one
+ *                                       that logs the data of the given cpu.
  *                                       Because the logging works in a way where
  *                                       the data is only written to the logfile
  *                                       when the user reads it, the ringbuffers
- *                                       have to register themself to be called
- *                                       when the user reads the log. Then the
- *                                       ringbuffers can append their content
- *                                       to the log before the user gets the data.
+ *                                       have to register themself to be drained
+ *                                       when the user reads the log.
+ *                                       This also creates the logfile of the cpu.
  *                                       See the memutil architecture wiki page.
  *
+ *                                       This function may sleep.
  *                                       On success 0 is returned, otherwise an
  *                                       error code is returned.
  * @buffer: The ringbuffer which is registered
+ * @cpu: The cpu whose data is logged into the ringbuffer
  */
-int memutil_debugfs_register_ringbuffer(struct memutil_ringbuffer *buffer);
+int memutil_debugfs_register_ringbuffer(struct memutil_ringbuffer *buffer, unsigned int cpu);
 /**
- * memutil_debugfs_append_to_logfile - Append the given text to the logfile.
- *
- *                                     Note that the text that is appended may not
- *                                     be larger than the logfile itself, otherwise
- *                                     this function fails. If the logfile is to full
- *                                     to hold the text, the logfile is cleared and
- *                                     the text appended.
+ * memutil_debugfs_unregister_ringbuffer - Unregister the ringbuffer of the given cpu
+ *                                         and remove the logfile of the cpu.
+ *                                         After this function returns, the
+ *                                         ringbuffer is no longer accessed by
+ *                                         any reader and may be closed.
  *
- *                                     On success this function returns 0, otherwise
- *                                     an error code is returned.
- * @buffer: Text that should be appended
- * @buffer_size: Size of the given buffer
+ *                                         This function may sleep.
+ * @cpu: The cpu whose ringbuffer should be unregistered
  */
-int memutil_debugfs_append_to_logfile(char *buffer, size_t buffer_size);
+void memutil_debugfs_unregister_ringbuffer(unsigned int cpu);
 
 #endif //_MEMUTIL_DEBUGFS_LOGFILE_H
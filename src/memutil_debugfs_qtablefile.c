@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_qtablefile.c
+ *
+ * Implementation file for the debugfs qtablefile.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#include "memutil_debugfs_qtablefile.h"
+#include "memutil_qlearning.h"
+
+/* Maximum amount of bytes that are imported per write call */
+#define IMPORT_CHUNK_SIZE (64 * 1024)
+
+/** The qtablefile filesystem entry */
+static struct dentry *qtable_file = NULL;
+
+static int qtable_show(struct seq_file *seq, void *unused)
+{
+	seq_printf(seq, "# stall_buckets=%d ipc_buckets=%d freq_levels=%d\n",
+		   MEMUTIL_QL_STALL_BUCKETS, MEMUTIL_QL_IPC_BUCKETS, MEMUTIL_QL_FREQ_LEVELS);
+	seq_puts(seq, MEMUTIL_QL_TABLE_HEADER "\n");
+	memutil_qlearning_show(seq);
+	return 0;
+}
+
+static int qtable_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qtable_show, inode->i_private);
+}
+
+/**
+ * qtable_write - Function that is called when the qtablefile is written from
+ *                userspace. Imports the complete lines of the written data and
+ *                returns the amount of bytes consumed, so that a line that is
+ *                split across two writes is written again with the next call.
+ */
+static ssize_t qtable_write(struct file *file, const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	size_t size = min_t(size_t, count, IMPORT_CHUNK_SIZE);
+	char *buffer, *line, *end, *next;
+	ssize_t consumed;
+	int return_value = 0;
+
+	buffer = kmalloc(size + 1, GFP_KERNEL);
+	if (!buffer) {
+		return -ENOMEM;
+	}
+	if (copy_from_user(buffer, user_buf, size)) {
+		consumed = -EFAULT;
+		goto out;
+	}
+	buffer[size] = '\0';
+
+	end = strrchr(buffer, '\n');
+	if (!end) {
+		if (size < count) {
+			//a line longer than the chunk cannot be valid
+			consumed = -EINVAL;
+			goto out;
+		}
+		//the last line of the input without a newline
+		end = buffer + size;
+	}
+	*end = '\0';
+	consumed = end - buffer + (end < buffer + size ? 1 : 0);
+
+	for (line = buffer; line; line = next) {
+		next = strchr(line, '\n');
+		if (next) {
+			*next++ = '\0';
+		}
+		return_value = memutil_qlearning_import(line);
+		if (return_value) {
+			pr_warn("Memutil: Invalid qtable line \"%s\": %d", line, return_value);
+			consumed = return_value;
+			goto out;
+		}
+	}
+out:
+	kfree(buffer);
+	return consumed;
+}
+
+/**
+ * file operations for the qtablefile
+ */
+static const struct file_operations fops_qtable = {
+	.owner = THIS_MODULE,
+	.open = qtable_open,
+	.read = seq_read,
+	.write = qtable_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int memutil_debugfs_qtablefile_init(struct dentry *root_dir)
+{
+	qtable_file = debugfs_create_file("qtable", S_IRUSR | S_IWUSR, root_dir, NULL, &fops_qtable);
+	if (IS_ERR(qtable_file)) {
+		int return_value = PTR_ERR(qtable_file);
+
+		pr_warn("Memutil: Create file failed: %pe", qtable_file);
+		qtable_file = NULL;
+		return return_value;
+	}
+	return 0;
+}
+
+void memutil_debugfs_qtablefile_exit(void)
+{
+	debugfs_remove(qtable_file);
+	qtable_file = NULL;
+}
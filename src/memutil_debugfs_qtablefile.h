@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_qtablefile.h
+ *
+ * Header file for the debugfs qtablefile. Reading the qtablefile exports the
+ * action values of the Q-learning heuristic of all cpus (see
+ * memutil_qlearning.h), writing the exported format imports them.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_DEBUGFS_QTABLEFILE_H
+#define _MEMUTIL_DEBUGFS_QTABLEFILE_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+
+/**
+ * memutil_debugfs_qtablefile_init - Initialize / create the memutil qtablefile under
+ *                                   the <debugfs>/memutil folder
+ *
+ *                                   This function may sleep.
+ *                                   If the function succeeds it returns 0, otherwise
+ *                                   an error code is returned.
+ * @root_dir: Directory in which the qtablefile should be created
+ */
+int memutil_debugfs_qtablefile_init(struct dentry *root_dir);
+/**
+ * memutil_debugfs_qtablefile_exit - Deinitialize / remove the qtablefile
+ */
+void memutil_debugfs_qtablefile_exit(void);
+
+#endif //_MEMUTIL_DEBUGFS_QTABLEFILE_H
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_statsfile.c
+ *
+ * Implementation file for the debugfs statsfile.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/seq_file.h>
+
+#include "memutil_debugfs_statsfile.h"
+#include "memutil_stats.h"
+#include "memutil_probing.h"
+
+/** The statsfile filesystem entry */
+static struct dentry *stats_file = NULL;
+
+static int stats_show(struct seq_file *seq, void *unused)
+{
+	seq_puts(seq, "cpu,histogram,bucket,value\n");
+	memutil_stats_show(seq);
+	memutil_probing_show(seq);
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, inode->i_private);
+}
+
+/**
+ * stats_write - Function that is called when the statsfile is written from
+ *               userspace. Any write resets the statistics of all cpus.
+ */
+static ssize_t stats_write(struct file *file, const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	memutil_stats_reset();
+	return count;
+}
+
+/**
+ * file operations for the statsfile
+ */
+static const struct file_operations fops_stats = {
+	.owner = THIS_MODULE,
+	.open = stats_open,
+	.read = seq_read,
+	.write = stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int memutil_debugfs_statsfile_init(struct dentry *root_dir)
+{
+	stats_file = debugfs_create_file("stats", S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, root_dir, NULL, &fops_stats);
+	if (IS_ERR(stats_file)) {
+		int return_value = PTR_ERR(stats_file);
+
+		pr_warn("Memutil: Create file failed: %pe", stats_file);
+		stats_file = NULL;
+		return return_value;
+	}
+	return 0;
+}
+
+void memutil_debugfs_statsfile_exit(void)
+{
+	debugfs_remove(stats_file);
+	stats_file = NULL;
+}
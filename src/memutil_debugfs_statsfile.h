@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_statsfile.h
+ *
+ * Header file for the debugfs statsfile. Reading the statsfile prints the
+ * always-on histograms of all cpus (see memutil_stats.h), writing anything to
+ * it resets them.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_DEBUGFS_STATSFILE_H
+#define _MEMUTIL_DEBUGFS_STATSFILE_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+
+/**
+ * memutil_debugfs_statsfile_init - Initialize / create the memutil statsfile under
+ *                                  the <debugfs>/memutil folder
+ *
+ *                                  This function may sleep.
+ *                                  If the function succeeds it returns 0, otherwise
+ *                                  an error code is returned.
+ * @root_dir: Directory in which the statsfile should be created
+ */
+int memutil_debugfs_statsfile_init(struct dentry *root_dir);
+/**
+ * memutil_debugfs_statsfile_exit - Deinitialize / remove the statsfile
+ */
+void memutil_debugfs_statsfile_exit(void);
+
+#endif //_MEMUTIL_DEBUGFS_STATSFILE_H
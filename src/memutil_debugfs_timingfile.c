@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_timingfile.c
+ *
+ * Implementation file for the debugfs timingfile.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+
+#include "memutil_debugfs_timingfile.h"
+#include "memutil_timing.h"
+
+/** The timingfile filesystem entry */
+static struct dentry *timing_file = NULL;
+
+static int timing_show(struct seq_file *seq, void *unused)
+{
+	seq_printf(seq, "# enabled=%d\n", static_key_enabled(&memutil_timing_key));
+	seq_puts(seq, "cpu,stage,count,min_ns,mean_ns,max_ns,log2_ns_histogram\n");
+	memutil_timing_show(seq);
+	return 0;
+}
+
+static int timing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, timing_show, inode->i_private);
+}
+
+/**
+ * timing_write - Function that is called when the timingfile is written from
+ *                userspace. A boolean value (e.g. 1 / 0) enables or disables
+ *                the timing.
+ */
+static ssize_t timing_write(struct file *file, const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	bool enabled;
+	int return_value;
+
+	return_value = kstrtobool_from_user(user_buf, count, &enabled);
+	if (return_value) {
+		return return_value;
+	}
+	memutil_timing_set_enabled(enabled);
+	return count;
+}
+
+/**
+ * file operations for the timingfile
+ */
+static const struct file_operations fops_timing = {
+	.owner = THIS_MODULE,
+	.open = timing_open,
+	.read = seq_read,
+	.write = timing_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int memutil_debugfs_timingfile_init(struct dentry *root_dir)
+{
+	timing_file = debugfs_create_file("timing", S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, root_dir, NULL, &fops_timing);
+	if (IS_ERR(timing_file)) {
+		int return_value = PTR_ERR(timing_file);
+
+		pr_warn("Memutil: Create file failed: %pe", timing_file);
+		timing_file = NULL;
+		return return_value;
+	}
+	return 0;
+}
+
+void memutil_debugfs_timingfile_exit(void)
+{
+	debugfs_remove(timing_file);
+	timing_file = NULL;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_debugfs_timingfile.h
+ *
+ * Header file for the debugfs timingfile. Reading the timingfile prints the
+ * hot path timings of all cpus (see memutil_timing.h). Writing 1 to it enables
+ * (and resets) the timing, writing 0 disables it.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_DEBUGFS_TIMINGFILE_H
+#define _MEMUTIL_DEBUGFS_TIMINGFILE_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+
+/**
+ * memutil_debugfs_timingfile_init - Initialize / create the memutil timingfile
+ *                                   under the <debugfs>/memutil folder
+ *
+ *                                   This function may sleep.
+ *                                   If the function succeeds it returns 0,
+ *                                   otherwise an error code is returned.
+ * @root_dir: Directory in which the timingfile should be created
+ */
+int memutil_debugfs_timingfile_init(struct dentry *root_dir);
+/**
+ * memutil_debugfs_timingfile_exit - Deinitialize / remove the timingfile
+ */
+void memutil_debugfs_timingfile_exit(void);
+
+#endif //_MEMUTIL_DEBUGFS_TIMINGFILE_H
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_energy.c
+ *
+ * Implementation file for the energy sources of memutil.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/percpu.h>
+#include <linux/printk.h>
+#include <linux/sched/clock.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+#ifdef CONFIG_X86
+#include <asm/msr.h>
+#include <asm/processor.h>
+#endif
+
+#include "memutil_energy.h"
+
+#ifdef CONFIG_X86
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,16,0)
+#define memutil_rdmsr_safe rdmsrq_safe
+#else
+#define memutil_rdmsr_safe rdmsrl_safe
+#endif
+
+/**
+ * struct msr_energy_cpu - Per cpu state of the msr energy source. The MSRs are
+ *                         32 bit counters, this state extends them to 64 bit.
+ *
+ * @initialized: Whether the MSRs were read on this cpu before
+ * @last_package_raw: Last raw value of the package energy MSR
+ * @last_core_raw: Last raw value of the core energy MSR
+ * @sample: The extended counters
+ */
+struct msr_energy_cpu {
+	bool initialized;
+	u32 last_package_raw;
+	u32 last_core_raw;
+	struct memutil_energy_sample sample;
+};
+
+static DEFINE_PER_CPU(struct msr_energy_cpu, msr_energy);
+static u32 msr_package;
+/* 0 if the core energy is not available */
+static u32 msr_core;
+/* The MSRs count in units of 1 / 2^energy_unit_shift joules */
+static unsigned int energy_unit_shift;
+
+static int msr_probe(void)
+{
+	u32 unit_msr;
+	u64 value;
+
+	switch (boot_cpu_data.x86_vendor) {
+	case X86_VENDOR_INTEL:
+		unit_msr = MSR_RAPL_POWER_UNIT;
+		msr_package = MSR_PKG_ENERGY_STATUS;
+		msr_core = MSR_PP0_ENERGY_STATUS;
+		break;
+	case X86_VENDOR_AMD:
+	case X86_VENDOR_HYGON:
+		unit_msr = MSR_AMD_RAPL_POWER_UNIT;
+		msr_package = MSR_AMD_PKG_ENERGY_STATUS;
+		msr_core = MSR_AMD_CORE_ENERGY_STATUS;
+		break;
+	default:
+		return -ENODEV;
+	}
+	if (memutil_rdmsr_safe(unit_msr, &value)) {
+		return -ENODEV;
+	}
+	energy_unit_shift = (value >> 8) & 0x1f;
+	if (memutil_rdmsr_safe(msr_package, &value)) {
+		return -ENODEV;
+	}
+	if (memutil_rdmsr_safe(msr_core, &value)) {
+		msr_core = 0;
+	}
+	return 0;
+}
+
+/**
+ * extend_counter - Add the energy since the last raw value to the counter
+ * @counter_nj: The extended counter (in nanojoules)
+ * @last_raw: The last raw value, updated to raw
+ * @raw: The current raw value
+ * @initialized: Whether last_raw is valid
+ */
+static void extend_counter(u64 *counter_nj, u32 *last_raw, u32 raw, bool initialized)
+{
+	if (initialized) {
+		//unsigned 32 bit arithmetic handles the wraparound
+		*counter_nj += ((u64)(u32)(raw - *last_raw) * NSEC_PER_SEC) >> energy_unit_shift;
+	}
+	*last_raw = raw;
+}
+
+static int msr_read(struct memutil_energy_sample *sample, unsigned int freq)
+{
+	struct msr_energy_cpu *state = this_cpu_ptr(&msr_energy);
+	u64 raw;
+
+	if (unlikely(memutil_rdmsr_safe(msr_package, &raw))) {
+		return -EIO;
+	}
+	extend_counter(&state->sample.package_nj, &state->last_package_raw, raw, state->initialized);
+	if (msr_core) {
+		if (unlikely(memutil_rdmsr_safe(msr_core, &raw))) {
+			return -EIO;
+		}
+		extend_counter(&state->sample.core_nj, &state->last_core_raw, raw, state->initialized);
+	}
+	state->initialized = true;
+	*sample = state->sample;
+	return 0;
+}
+
+static const struct memutil_energy_source msr_source = {
+	.name = "msr",
+	.probe = msr_probe,
+	.read = msr_read,
+};
+
+#endif //CONFIG_X86
+
+/* Power model of the mock source (in milliwatts) */
+#define MOCK_STATIC_MW 2000
+/* Dynamic power at MOCK_REFERENCE_FREQ, scales with the cube of the frequency */
+#define MOCK_DYNAMIC_MW 10000
+#define MOCK_REFERENCE_FREQ 3000000
+/* Limit of the relative frequency (in permille) so that the model cannot overflow */
+#define MOCK_MAX_RELATIVE_FREQ 3000
+
+/**
+ * struct mock_energy_cpu - Per cpu state of the mock energy source
+ *
+ * @last_time_ns: Time of the last read, 0 if there was none
+ * @sample: The synthetic counters
+ */
+struct mock_energy_cpu {
+	u64 last_time_ns;
+	struct memutil_energy_sample sample;
+};
+
+static DEFINE_PER_CPU(struct mock_energy_cpu, mock_energy);
+
+static int mock_probe(void)
+{
+	return 0;
+}
+
+static int mock_read(struct memutil_energy_sample *sample, unsigned int freq)
+{
+	struct mock_energy_cpu *state = this_cpu_ptr(&mock_energy);
+	u64 now = local_clock();
+	u64 elapsed_ns, relative_freq, dynamic_mw;
+
+	if (state->last_time_ns) {
+		elapsed_ns = now - state->last_time_ns;
+		relative_freq = min_t(u64, (u64)freq * 1000 / MOCK_REFERENCE_FREQ, MOCK_MAX_RELATIVE_FREQ);
+		dynamic_mw = MOCK_DYNAMIC_MW * relative_freq * relative_freq * relative_freq / 1000000000;
+		// mW * ns = pJ
+		state->sample.core_nj += dynamic_mw * elapsed_ns / 1000;
+		state->sample.package_nj += (MOCK_STATIC_MW + dynamic_mw) * elapsed_ns / 1000;
+	}
+	state->last_time_ns = now;
+	*sample = state->sample;
+	return 0;
+}
+
+static const struct memutil_energy_source mock_source = {
+	.name = "mock",
+	.probe = mock_probe,
+	.read = mock_read,
+	.cpu_scope = true,
+};
+
+static const struct memutil_energy_source *energy_sources[] = {
+#ifdef CONFIG_X86
+	&msr_source,
+#endif
+	&mock_source,
+};
+
+const struct memutil_energy_source *memutil_energy_select(const char *name)
+{
+	unsigned int i;
+	int return_value;
+
+	if (!name || !*name || strcmp(name, "none") == 0) {
+		return NULL;
+	}
+	for (i = 0; i < ARRAY_SIZE(energy_sources); ++i) {
+		if (strcmp(name, energy_sources[i]->name) != 0) {
+			continue;
+		}
+		return_value = energy_sources[i]->probe();
+		if (return_value) {
+			pr_warn("Memutil: Energy source %s is not available: %d", name, return_value);
+			return NULL;
+		}
+		pr_info("Memutil: Using energy source %s", name);
+		return energy_sources[i];
+	}
+	pr_warn("Memutil: Unknown energy source %s", name);
+	return NULL;
+}
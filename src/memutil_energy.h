@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_energy.h
+ *
+ * Header file for the energy sources of memutil. An energy source provides
+ * monotonic package and core energy counters that can be read from the update
+ * hook of any cpu. Available sources:
+ *
+ *   msr:  The RAPL energy status MSRs (Intel, AMD and Hygon). The MSRs are
+ *         read directly, because the power PMU perf events are bound to one
+ *         reader cpu per package and cannot be read locally on the other cpus.
+ *   mock: Synthetic energy computed from the requested frequency and the
+ *         elapsed time, for machines without RAPL (e.g. VMs and test machines).
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_ENERGY_H
+#define _MEMUTIL_ENERGY_H
+
+#include <linux/types.h>
+
+/**
+ * struct memutil_energy_sample - Energy counters of the current cpu
+ *
+ * @package_nj: Energy (in nanojoules) of the cpu's package
+ * @core_nj: Energy (in nanojoules) of the cores (per core or all cores of the
+ *           package, depending on the hardware)
+ */
+struct memutil_energy_sample {
+	u64 package_nj;
+	u64 core_nj;
+};
+
+/**
+ * struct memutil_energy_source - An energy source
+ *
+ * @name: Name of the source, used for the energy_source module parameter
+ * @probe: Check whether the source is usable on this machine. Returns 0 if it
+ *         is, otherwise an error code. May sleep.
+ * @read: Read the counters of the current cpu. Returns 0 on success. Must not
+ *        sleep, it is called from the update hook.
+ *        freq is the frequency (in KHz) the cpu used since the last read
+ *        (only used by the mock source).
+ * @cpu_scope: Whether package_nj only contains the energy of the current cpu
+ *             instead of the whole package (the mock source)
+ */
+struct memutil_energy_source {
+	const char *name;
+	int (*probe)(void);
+	int (*read)(struct memutil_energy_sample *sample, unsigned int freq);
+	bool cpu_scope;
+};
+
+/**
+ * memutil_energy_select - Select the energy source with the given name.
+ *
+ *                         Returns the source on success, NULL if the name is
+ *                         "none" or the source is unknown / not usable.
+ *                         This function may sleep.
+ * @name: Name of the energy source
+ */
+const struct memutil_energy_source *memutil_energy_select(const char *name);
+
+#endif //_MEMUTIL_ENERGY_H
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_feedback.c
+ *
+ * Implementation file for the closed-loop energy feedback.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#include "memutil_feedback.h"
+#include "memutil_package.h"
+
+/* Fixed point shift of the per work values, keeps precision without overflowing the product */
+#define PER_WORK_SHIFT 16
+/* The objective has to get worse by more than 1 / 2^NOISE_SHIFT to turn around */
+#define NOISE_SHIFT 5
+
+int memutil_feedback_parse_objective(const char *name)
+{
+	if (!name || !*name || strcmp(name, "none") == 0) {
+		return MEMUTIL_FEEDBACK_NONE;
+	}
+	if (strcmp(name, "edp") == 0) {
+		return MEMUTIL_FEEDBACK_EDP;
+	}
+	if (strcmp(name, "epi") == 0) {
+		return MEMUTIL_FEEDBACK_EPI;
+	}
+	return -EINVAL;
+}
+
+/**
+ * struct feedback_package - Energy attribution state of one package
+ *
+ * The cpus report their unhalted cycles per microsecond as their first value.
+ *
+ * @base: Generic package state
+ * @cycles_rate: Sum of the cycles per microsecond of the recently busy cpus
+ */
+struct feedback_package {
+	struct memutil_package base;
+	u64 cycles_rate;
+};
+
+static int feedback_join(struct memutil_package *base, unsigned int cpu, void *arg)
+{
+	struct feedback_package *package = container_of(base, struct feedback_package, base);
+
+	WRITE_ONCE(package->cycles_rate, 0);
+	return 0;
+}
+
+static struct memutil_package_set feedback_set =
+	MEMUTIL_PACKAGE_SET_INIT(feedback_set, struct feedback_package, MEMUTIL_FEEDBACK_SHARE_PERIOD_NS,
+				 feedback_join, NULL);
+
+int memutil_feedback_init(struct memutil_feedback *feedback, int objective, unsigned int cpu, bool cpu_scope)
+{
+	memset(feedback, 0, sizeof(*feedback));
+	feedback->objective = objective;
+	feedback->direction = 1;
+	feedback->package_energy = !cpu_scope;
+	if (!feedback->package_energy) {
+		return 0;
+	}
+	return memutil_package_join(&feedback_set, cpu, NULL);
+}
+
+void memutil_feedback_exit(struct memutil_feedback *feedback, unsigned int cpu)
+{
+	if (feedback->package_energy) {
+		memutil_package_leave(&feedback_set, cpu);
+	}
+}
+
+/**
+ * attribute_energy - The share of the package energy of an interval that
+ *                    belongs to the current cpu, by its share of the unhalted
+ *                    cycles of the package
+ */
+static u64 attribute_energy(u64 energy_nj, u64 cycles, u64 interval_ns, u64 time)
+{
+	struct feedback_package *package =
+		container_of(memutil_package_own(&feedback_set), struct feedback_package, base);
+	struct memutil_package_summary summary;
+	u64 rate, package_rate;
+
+	rate = interval_ns ? min_t(u64, div64_u64(cycles * NSEC_PER_USEC, interval_ns), U32_MAX) : 0;
+	if (rate > 0) {
+		memutil_package_report(&feedback_set, rate, 0, time);
+	}
+	if (memutil_package_try_begin(&feedback_set, &package->base, time)) {
+		memutil_package_summarize(&feedback_set, time, &summary);
+		WRITE_ONCE(package->cycles_rate, summary.sum[0]);
+		memutil_package_end(&package->base);
+	}
+	//the sum may be older than this interval, the cpu never gets more than the whole package
+	package_rate = max(READ_ONCE(package->cycles_rate), rate);
+	if (package_rate == 0) {
+		return 0;
+	}
+	return div64_u64(energy_nj * rate, package_rate);
+}
+
+/**
+ * epoch_metric - The objective of the current epoch, lower is better.
+ *                Both energy and delay are normalized by the work, so that
+ *                epochs with different load are comparable.
+ */
+static u64 epoch_metric(struct memutil_feedback *feedback)
+{
+	u64 energy_per_work = div64_u64(feedback->epoch_energy_nj << PER_WORK_SHIFT, feedback->epoch_work);
+	u64 time_per_work;
+
+	if (feedback->objective == MEMUTIL_FEEDBACK_EPI) {
+		return energy_per_work;
+	}
+	time_per_work = div64_u64(feedback->epoch_busy_ns << PER_WORK_SHIFT, feedback->epoch_work);
+	return energy_per_work * time_per_work;
+}
+
+/**
+ * finish_epoch - Compare the epoch to the last one and move the offset
+ */
+static void finish_epoch(struct memutil_feedback *feedback)
+{
+	u64 metric = max_t(u64, epoch_metric(feedback), 1);
+
+	if (feedback->last_metric && metric > feedback->last_metric + (feedback->last_metric >> NOISE_SHIFT)) {
+		feedback->direction = -feedback->direction;
+	}
+	feedback->last_metric = metric;
+
+	feedback->offset += feedback->direction * MEMUTIL_FEEDBACK_STEP;
+	if (abs(feedback->offset) >= MEMUTIL_FEEDBACK_MAX_OFFSET) {
+		feedback->offset = clamp(feedback->offset, -MEMUTIL_FEEDBACK_MAX_OFFSET, MEMUTIL_FEEDBACK_MAX_OFFSET);
+		feedback->direction = -feedback->direction;
+	}
+}
+
+void memutil_feedback_update(struct memutil_feedback *feedback, u64 time, u64 energy_nj, u64 work,
+			     u64 cycles, unsigned int freq)
+{
+	u64 interval_ns = feedback->last_update_ns ? time - feedback->last_update_ns : 0;
+
+	feedback->last_update_ns = time;
+	if (feedback->package_energy) {
+		energy_nj = attribute_energy(energy_nj, cycles, interval_ns, time);
+	}
+	if (!feedback->epoch_start_ns) {
+		feedback->epoch_start_ns = time;
+		return;
+	}
+	feedback->epoch_energy_nj += energy_nj;
+	feedback->epoch_work += work;
+	if (freq) {
+		feedback->epoch_busy_ns += div_u64(cycles * NSEC_PER_MSEC, freq);
+	}
+	if (time - feedback->epoch_start_ns < MEMUTIL_FEEDBACK_EPOCH_NS) {
+		return;
+	}
+
+	if (feedback->epoch_work >= MEMUTIL_FEEDBACK_MIN_WORK) {
+		finish_epoch(feedback);
+	}
+	feedback->epoch_start_ns = time;
+	feedback->epoch_energy_nj = 0;
+	feedback->epoch_work = 0;
+	feedback->epoch_busy_ns = 0;
+}
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_feedback.h
+ *
+ * Header file for the closed-loop energy feedback. Each policy attributes the
+ * energy of its decision intervals to the work its cpu did in them and sums
+ * both up over epochs of about half a second. At the end of every epoch a
+ * perturb-and-observe hill climber shifts the heuristic thresholds by a small
+ * offset into the direction that lowered the energy-delay product (or the
+ * energy per work) and turns around when the objective got worse.
+ *
+ * Work is measured with the events of the heuristic: retired instructions for
+ * HEURISTIC_IPC, non-stalled cycles for HEURISTIC_OFFCORE_STALLS.
+ *
+ * RAPL package energy covers all cpus of the package. Each cpu therefore only
+ * attributes the share of it that matches its share of the package's unhalted
+ * cycles: every cpu reports its cycles per microsecond, and about every
+ * MEMUTIL_FEEDBACK_SHARE_PERIOD_NS one cpu of the package sums up the reports
+ * of the recently busy cpus (see memutil_package.h). Otherwise the hill
+ * climber of each cpu would mostly measure the decisions of the other cpus.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_FEEDBACK_H
+#define _MEMUTIL_FEEDBACK_H
+
+#include <linux/minmax.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+
+#include "memutil_heuristic.h"
+
+/* The objectives the feedback can minimize */
+#define MEMUTIL_FEEDBACK_NONE 0
+#define MEMUTIL_FEEDBACK_EDP 1
+#define MEMUTIL_FEEDBACK_EPI 2
+
+/* Length of an epoch, i.e. how often the offset is adapted */
+#define MEMUTIL_FEEDBACK_EPOCH_NS (500 * NSEC_PER_MSEC)
+/* Epochs with less work are idle and skipped, their metric is mostly noise */
+#define MEMUTIL_FEEDBACK_MIN_WORK 10000000ULL
+/* Change of the offset (in percent) per epoch */
+#define MEMUTIL_FEEDBACK_STEP 2
+/* Guard rail: the offset stays within +-MEMUTIL_FEEDBACK_MAX_OFFSET percent */
+#define MEMUTIL_FEEDBACK_MAX_OFFSET 20
+/* How often the cycles of a package are summed up for the energy attribution */
+#define MEMUTIL_FEEDBACK_SHARE_PERIOD_NS (20 * NSEC_PER_MSEC)
+
+/**
+ * struct memutil_feedback - Energy feedback state of one policy. Only accessed
+ *                           by the policy's cpu.
+ *
+ * @objective: MEMUTIL_FEEDBACK_EDP or MEMUTIL_FEEDBACK_EPI
+ * @package_energy: Whether the energy covers the whole package and is
+ *                  attributed by the cycles share of the cpu
+ * @last_update_ns: Timestamp of the last decision, 0 before the first
+ * @epoch_start_ns: Timestamp of the start of the current epoch, 0 before the first
+ * @epoch_energy_nj: Energy (in nanojoules) of the current epoch
+ * @epoch_work: Work of the current epoch
+ * @epoch_busy_ns: Non-idle time (in nanoseconds) of the current epoch
+ * @last_metric: Objective of the last completed epoch, 0 if there is none
+ * @offset: Offset (in percent) added to both thresholds
+ * @direction: Sign of the next change of the offset
+ */
+struct memutil_feedback {
+	int objective;
+	bool package_energy;
+	u64 last_update_ns;
+	u64 epoch_start_ns;
+	u64 epoch_energy_nj;
+	u64 epoch_work;
+	u64 epoch_busy_ns;
+	u64 last_metric;
+	int offset;
+	int direction;
+};
+
+/**
+ * memutil_feedback_parse_objective - Returns the objective for the given name
+ *                                    ("none", "edp" or "epi"), or -EINVAL.
+ */
+int memutil_feedback_parse_objective(const char *name);
+/**
+ * memutil_feedback_init - Initialize the feedback state of the given cpu
+ *
+ *                         Returns 0 on success, otherwise an error code.
+ *                         This function may sleep.
+ * @feedback: The state to initialize
+ * @objective: MEMUTIL_FEEDBACK_EDP or MEMUTIL_FEEDBACK_EPI
+ * @cpu: The cpu of the policy
+ * @cpu_scope: Whether the energy source only measures the reading cpu (see
+ *             struct memutil_energy_source), otherwise the package energy is
+ *             attributed by the cycles share
+ */
+int memutil_feedback_init(struct memutil_feedback *feedback, int objective, unsigned int cpu, bool cpu_scope);
+/**
+ * memutil_feedback_exit - Stop the energy attribution of the given cpu. The
+ *                         update hook of the cpu must not run anymore.
+ *
+ *                         This function may sleep.
+ * @feedback: The state of the policy
+ * @cpu: The cpu of the policy
+ */
+void memutil_feedback_exit(struct memutil_feedback *feedback, unsigned int cpu);
+/**
+ * memutil_feedback_update - Attribute one decision interval to the current
+ *                           epoch and adapt the offset if the epoch is over.
+ *
+ *                           This function does not sleep.
+ * @feedback: The state of the policy
+ * @time: Timestamp (nanoseconds) of the decision
+ * @energy_nj: Energy (in nanojoules) consumed during the interval, of the
+ *             whole package unless the energy source has cpu scope
+ * @work: Work done during the interval
+ * @cycles: Unhalted cycles of the interval
+ * @freq: Frequency (in KHz) the interval ran at
+ */
+void memutil_feedback_update(struct memutil_feedback *feedback, u64 time, u64 energy_nj, u64 work,
+			     u64 cycles, unsigned int freq);
+
+/**
+ * memutil_feedback_apply - Shift the thresholds by the offset of the feedback
+ * @feedback: The feedback state
+ * @params: The configured (or auto-ranged) parameters
+ * @shifted: Set to the parameters the heuristic should use
+ */
+static inline void memutil_feedback_apply(const struct memutil_feedback *feedback,
+					  const struct memutil_heuristic_params *params,
+					  struct memutil_heuristic_params *shifted)
+{
+	*shifted = *params;
+	shifted->min_ratio = max(params->min_ratio + feedback->offset, 0);
+	shifted->max_ratio = max(params->max_ratio + feedback->offset, 0);
+}
+
+#endif //_MEMUTIL_FEEDBACK_H
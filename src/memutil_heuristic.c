@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_heuristic.c
+ *
+ * Implementation file for the memutil heuristics.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifdef __KERNEL__
+#include <linux/minmax.h>
+#endif
+
+#include "memutil_heuristic.h"
+
+/**
+ * interpolation_factor - Linearly map the ratio from the range given by params
+ *                        onto 0..100 (clamped). The range must not be empty.
+ * @ratio: The ratio in percent
+ * @params: The interpolation range
+ */
+static s64 interpolation_factor(s64 ratio, const struct memutil_heuristic_params *params)
+{
+	s64 interpolation_range = params->max_ratio - params->min_ratio;
+
+	return clamp(((ratio - params->min_ratio) * 100) / interpolation_range, 0LL, 100LL);
+}
+
+/**
+ * is_valid_range - Check whether the interpolation range is usable. An empty or
+ *                  inverted range (e.g. misconfigured parameters) would divide
+ *                  by zero, the heuristics fall back to the maximum frequency.
+ * @params: The interpolation range
+ */
+static bool is_valid_range(const struct memutil_heuristic_params *params)
+{
+	return params->max_ratio > params->min_ratio;
+}
+
+unsigned int calculate_frequency_heuristic_ipc(s64 instructions, s64 cycles, int max_freq, int min_freq,
+					       const struct memutil_heuristic_params *params)
+{
+	s64 frequency_factor;
+
+	if (unlikely(!is_valid_range(params))) {
+		return max_freq;
+	}
+	// Do a linear interpolation:
+	frequency_factor = interpolation_factor(memutil_ratio_percent(instructions, cycles), params);
+	return frequency_factor * (max_freq - min_freq) / 100 + min_freq;
+}
+
+unsigned int calculate_frequency_heuristic_stalls(s64 stalls, s64 cycles, int max_freq, int min_freq,
+						  const struct memutil_heuristic_params *params)
+{
+	s64 frequency_factor;
+
+	if (unlikely(!is_valid_range(params))) {
+		return max_freq;
+	}
+	// Do a linear interpolation:
+	frequency_factor = 100LL - interpolation_factor(memutil_ratio_percent(stalls, cycles), params);
+	return frequency_factor * (max_freq - min_freq) / 100 + min_freq;
+}
+
+/*
+ * The model works in MHz, so that the products of three frequencies and the
+ * permille factors cannot overflow.
+ */
+unsigned int memutil_budget_frequency(s64 share, unsigned int cur_freq, int max_freq, int min_freq, int budget)
+{
+	s64 scaled_busy, denominator, frequency;
+	s64 cur_mhz = cur_freq / 1000;
+	s64 max_mhz = max_freq / 1000;
+
+	if (unlikely(budget <= 0 || cur_mhz <= 0 || max_mhz <= 0)) {
+		return max_freq;
+	}
+	/*
+	 * With the share s and the budget b (both as fractions), the time at
+	 * frequency f is (1 - s) / f + s / cur (relative to the interval's cycles).
+	 * Solving time(f) <= (1 + b) * time(max) for f gives
+	 *   f >= (1 - s) * max * cur / ((1 + b) * (1 - s) * cur + b * s * max)
+	 */
+	scaled_busy = (1000 - share) * cur_mhz;
+	denominator = (1000 + (s64)budget) * scaled_busy + budget * share * max_mhz;
+	//round up, so that the budget holds
+	frequency = (scaled_busy * max_mhz * 1000 + denominator - 1) / denominator * 1000;
+	return clamp(frequency, (s64)min_freq, (s64)max_freq);
+}
+
+unsigned int calculate_frequency_heuristic_budget(s64 stalls, s64 cycles, unsigned int cur_freq,
+						  int max_freq, int min_freq,
+						  const struct memutil_heuristic_params *params)
+{
+	return memutil_budget_frequency(memutil_stall_share(stalls, cycles), cur_freq, max_freq, min_freq,
+					params->slowdown_budget);
+}
+
+unsigned int memutil_predict_slowdown(s64 share, unsigned int cur_freq, unsigned int freq, int max_freq)
+{
+	s64 cur_mhz = cur_freq / 1000;
+	s64 mhz = freq / 1000;
+	s64 max_mhz = max_freq / 1000;
+
+	if (cur_mhz <= 0 || mhz <= 0 || mhz >= max_mhz) {
+		return 0;
+	}
+	// (time(freq) - time(max)) / time(max) with the model above
+	return (1000 * (1000 - share) * cur_mhz * (max_mhz - mhz)) /
+	       (mhz * ((1000 - share) * cur_mhz + share * max_mhz));
+}
@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_heuristic.h
+ *
+ * Header file for the memutil heuristics that calculate the frequency to use
+ * from perf event values. The heuristics are kept free of any governor state
+ * so that they can be used by the governor as well as by the self-benchmark.
+ * Without __KERNEL__ (i.e. when built into the userspace simulator in tools/)
+ * the kernel types and helpers are taken from memutil_userspace_compat.h.
+ * See the wiki page for Memutil Heuristics and Porting for more information.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_HEURISTIC_H
+#define _MEMUTIL_HEURISTIC_H
+
+#ifdef __KERNEL__
+#include <linux/compiler.h>
+#include <linux/minmax.h>
+#include <linux/types.h>
+#else
+#include "memutil_userspace_compat.h"
+#endif
+
+/* Heuristics that can be chosen with HEURISTIC in memutil_main.c */
+#define HEURISTIC_IPC 1
+#define HEURISTIC_OFFCORE_STALLS 2
+/*
+ * Uses the events of HEURISTIC_OFFCORE_STALLS, chosen at runtime instead of it
+ * when a slowdown budget is set (see calculate_frequency_heuristic_budget())
+ */
+#define HEURISTIC_SLOWDOWN_BUDGET 3
+/*
+ * Learns the frequency per state with tabular Q-learning. It keeps state per
+ * cpu and decides with memutil_qlearning_decide() instead of
+ * memutil_decide_frequency() (see memutil_qlearning.h).
+ */
+#define HEURISTIC_QLEARNING 4
+
+/*
+ * Indices of the counter values that are passed to memutil_decide_frequency(),
+ * i.e. the order of the perf events (event_name1, ...) and of the log columns.
+ * With the IPC heuristic the first event counts instructions, with the offcore
+ * stalls heuristic the third event counts stalls. The Q-learning heuristic
+ * uses all three.
+ */
+#define MEMUTIL_VALUE_INSTRUCTIONS 0
+#define MEMUTIL_VALUE_CYCLES 1
+#define MEMUTIL_VALUE_STALLS 2
+
+/**
+ * struct memutil_heuristic_params - Parameters of the heuristics. The ratios
+ *                                   are in percent (i.e. the ratio * 100).
+ *
+ * @min_ratio: Ratio (IPC or stalls per cycle) at which the interpolation starts
+ *             (min_ipc / min_stalls_per_cycle)
+ * @max_ratio: Ratio at which the interpolation ends
+ *             (max_ipc / max_stalls_per_cycle)
+ * @slowdown_budget: Performance loss (in permille) compared to the maximum
+ *                   frequency that HEURISTIC_SLOWDOWN_BUDGET may cause
+ * @base_freq: Highest frequency (in KHz) below the turbo / boost range, 0 if
+ *             the range is unknown (see memutil_limit_turbo())
+ * @turbo_ratio: Ratio an interval needs to enter the turbo range, i.e. the
+ *               minimum IPC or the maximum stalls per cycle
+ */
+struct memutil_heuristic_params {
+	int min_ratio;
+	int max_ratio;
+	int slowdown_budget;
+	int base_freq;
+	int turbo_ratio;
+};
+
+/**
+ * memutil_ratio_percent - Calculate value / cycles in percent, e.g. the IPC or
+ *                         the stalls per cycle.
+ * @value: Event value (e.g. instructions or stalls)
+ * @cycles: Cycles event value, has to be non-zero
+ */
+static inline s64 memutil_ratio_percent(s64 value, s64 cycles)
+{
+	/*
+	 * We cannot use floating point arithmetic, so instead we use fixed point arithmetic,
+	 * treating values as per-cent by multiplying with 100
+	 */
+	return (value * 100) / cycles;
+}
+
+/**
+ * memutil_stall_share - Calculate the stalls per cycle in permille, clamped to
+ *                       0..1000. This is the share of the time that does not
+ *                       scale with the frequency in the slowdown budget model.
+ * @stalls: L2 Stalls perf event value
+ * @cycles: Cycles perf event value, has to be non-zero
+ */
+static inline s64 memutil_stall_share(s64 stalls, s64 cycles)
+{
+	return clamp((stalls * 1000) / cycles, 0LL, 1000LL);
+}
+
+/**
+ * memutil_stall_share_at_max - Convert the stall share of an interval to the
+ *                              share it would have had at the maximum
+ *                              frequency. In the slowdown budget model the
+ *                              stall time does not depend on the frequency,
+ *                              while the time of the other cycles scales with it.
+ * @share: Stall share (in permille) of the interval, e.g. memutil_stall_share()
+ * @cur_freq: Frequency (in KHz) the interval ran at
+ * @max_freq: Maximum frequency (in KHz)
+ */
+static inline s64 memutil_stall_share_at_max(s64 share, unsigned int cur_freq, int max_freq)
+{
+	s64 cur_mhz = cur_freq / 1000;
+	s64 max_mhz = max_freq / 1000;
+	s64 stall_time = share * max_mhz;
+
+	if (unlikely(cur_mhz <= 0 || max_mhz <= 0 || stall_time == 0)) {
+		return share;
+	}
+	return (stall_time * 1000) / (stall_time + (1000 - share) * cur_mhz);
+}
+
+/**
+ * calculate_frequency_heuristic_ipc - Calculate the frequency to use based on the
+ *                                     IPC heuristic (see the wiki page on heuristics)
+ * @instructions: Instructions perf event value
+ * @cycles: Cycles perf event value, has to be non-zero
+ * @max_freq: Maximum choosable frequency (in KHz)
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @params: min_ipc and max_ipc to interpolate between
+ */
+unsigned int calculate_frequency_heuristic_ipc(s64 instructions, s64 cycles, int max_freq, int min_freq,
+					       const struct memutil_heuristic_params *params);
+/**
+ * calculate_frequency_heuristic_stalls - Calculate the frequency to use based on the
+ *                                        offcore stalls heuristic
+ *                                        (see the wiki page on heuristics)
+ * @stalls: L2 Stalls perf event value
+ * @cycles: Cycles perf event value, has to be non-zero
+ * @max_freq: Maximum choosable frequency (in KHz)
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @params: min_stalls_per_cycle and max_stalls_per_cycle to interpolate between
+ */
+unsigned int calculate_frequency_heuristic_stalls(s64 stalls, s64 cycles, int max_freq, int min_freq,
+						  const struct memutil_heuristic_params *params);
+
+/**
+ * calculate_frequency_heuristic_budget - Calculate the lowest frequency whose
+ *                                        predicted performance loss stays
+ *                                        within the slowdown budget.
+ *
+ *                                        The interval is modelled like
+ *                                        leading-loads / CRIT: the non-stalled
+ *                                        cycles scale with the frequency, the
+ *                                        stall time does not. The stall time
+ *                                        is taken from the stall cycles at the
+ *                                        frequency the interval ran at.
+ * @stalls: L2 Stalls perf event value
+ * @cycles: Cycles perf event value, has to be non-zero
+ * @cur_freq: Frequency (in KHz) the interval ran at
+ * @max_freq: Maximum choosable frequency (in KHz), the reference of the loss
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @params: slowdown_budget is used
+ */
+unsigned int calculate_frequency_heuristic_budget(s64 stalls, s64 cycles, unsigned int cur_freq,
+						  int max_freq, int min_freq,
+						  const struct memutil_heuristic_params *params);
+/**
+ * memutil_budget_frequency - Calculate the lowest frequency within the slowdown
+ *                            budget for the given share of frequency insensitive
+ *                            time (see calculate_frequency_heuristic_budget()).
+ * @share: Share (in permille) of the time at cur_freq that does not scale with
+ *         the frequency, e.g. memutil_stall_share()
+ * @cur_freq: Frequency (in KHz) the interval ran at
+ * @max_freq: Maximum choosable frequency (in KHz), the reference of the loss
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @budget: The slowdown budget (in permille)
+ */
+unsigned int memutil_budget_frequency(s64 share, unsigned int cur_freq, int max_freq, int min_freq, int budget);
+/**
+ * memutil_predict_slowdown - Predict the performance loss (in permille) of
+ *                            running an interval at freq instead of max_freq,
+ *                            with the model of calculate_frequency_heuristic_budget().
+ *
+ *                            With freq == cur_freq this is the loss the interval
+ *                            actually had according to its counters.
+ * @share: Share (in permille) of the time at cur_freq that does not scale with
+ *         the frequency, e.g. memutil_stall_share()
+ * @cur_freq: Frequency (in KHz) the interval ran at
+ * @freq: Frequency (in KHz) whose loss is predicted
+ * @max_freq: Reference frequency (in KHz)
+ */
+unsigned int memutil_predict_slowdown(s64 share, unsigned int cur_freq, unsigned int freq, int max_freq);
+
+/**
+ * memutil_limit_turbo - Keep the frequency at the base frequency unless the
+ *                       interval was compute bound enough for the turbo
+ *                       range. Turbo is the least efficient range and does not
+ *                       help a cpu that stalls on memory, so the threshold is
+ *                       stricter than the one of the interpolation.
+ * @heuristic: The heuristic whose ratio is passed
+ * @ratio: Ratio (in percent) of the interval, has to be >= 0
+ * @freq: Frequency (in KHz) chosen by the heuristic
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @params: Parameters of the heuristic
+ */
+static inline unsigned int memutil_limit_turbo(int heuristic, s64 ratio, unsigned int freq, int min_freq,
+					       const struct memutil_heuristic_params *params)
+{
+	if (params->base_freq <= 0 || freq <= (unsigned int)params->base_freq) {
+		return freq;
+	}
+	if (heuristic == HEURISTIC_IPC ? ratio >= params->turbo_ratio : ratio <= params->turbo_ratio) {
+		return freq;
+	}
+	return max(params->base_freq, min_freq);
+}
+
+/**
+ * memutil_decide_frequency - Calculate the frequency to request from the counter
+ *                            values of the last interval, like it is done with
+ *                            every update of the governor.
+ *
+ *                            Inlined so that the heuristic switch is resolved
+ *                            at compile time in the governor.
+ *                            The turbo range is limited with
+ *                            memutil_limit_turbo().
+ * @heuristic: HEURISTIC_IPC, HEURISTIC_OFFCORE_STALLS or HEURISTIC_SLOWDOWN_BUDGET
+ * @values: Counter values of the last interval (see MEMUTIL_VALUE_*)
+ * @max_freq: Maximum choosable frequency (in KHz)
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @last_freq: Frequency (in KHz) that was requested last
+ * @params: Parameters of the heuristic
+ * @ratio: Set to the ratio (in percent) the decision was based on, -1 if no
+ *         cycles were counted
+ */
+static inline unsigned int memutil_decide_frequency(int heuristic, const u64 *values,
+						    int max_freq, int min_freq, unsigned int last_freq,
+						    const struct memutil_heuristic_params *params,
+						    s64 *ratio)
+{
+	// this will cast the values into signed types which are easier to work with
+	s64 cycles = values[MEMUTIL_VALUE_CYCLES];
+	s64 value;
+	unsigned int freq;
+
+	if (unlikely(cycles == 0)) {
+		*ratio = -1;
+		//we could assume that a cycles == 0 value means we have a lot of idling
+		//in which case reducing the frequency would be good. However we did
+		//not test this assumption so we are conservative. Otherwise a line
+		//like the following could be used to decrease the frequency step
+		//by step
+		//return max(min_freq, last_freq - (max_freq - min_freq) / 10);
+		return last_freq;
+	}
+	if (heuristic == HEURISTIC_IPC) {
+		value = values[MEMUTIL_VALUE_INSTRUCTIONS];
+		*ratio = memutil_ratio_percent(value, cycles);
+		freq = calculate_frequency_heuristic_ipc(value, cycles, max_freq, min_freq, params);
+	} else {
+		value = values[MEMUTIL_VALUE_STALLS];
+		*ratio = memutil_ratio_percent(value, cycles);
+		if (heuristic == HEURISTIC_SLOWDOWN_BUDGET) {
+			freq = calculate_frequency_heuristic_budget(value, cycles, last_freq, max_freq, min_freq,
+								    params);
+		} else {
+			freq = calculate_frequency_heuristic_stalls(value, cycles, max_freq, min_freq, params);
+		}
+	}
+	return memutil_limit_turbo(heuristic, *ratio, freq, min_freq, params);
+}
+
+#endif //_MEMUTIL_HEURISTIC_H
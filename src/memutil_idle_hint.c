@@ -0,0 +1,239 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_idle_hint.c
+ *
+ * Implementation file for the memory boundness signal and the cpuidle hints.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/cpu.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/pm_qos.h>
+#include <linux/printk.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
+#include <linux/version.h>
+
+#include "memutil_idle_hint.h"
+
+/* The boundness moves 1 / 2^BOUNDNESS_SHIFT of the way to the stall share of every busy interval */
+#define BOUNDNESS_SHIFT 2
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,5,0)
+#define memutil_read_seqcount_latch_retry raw_read_seqcount_latch_retry
+#else
+#define memutil_read_seqcount_latch_retry(latch, seq) read_seqcount_retry(&(latch)->seqcount, seq)
+#endif
+
+/**
+ * struct published_signal - Signal of one cpu as seen by the readers
+ *
+ * The signal is kept twice behind a latch: while the writer updates one copy,
+ * the readers use the other one. A reader never waits for the writer, so it
+ * may interrupt it on the same cpu, even from NMI context (e.g. a tracing
+ * BPF program).
+ *
+ * @seq: Selects the copy the readers use, only ever written by the update
+ *       hook of the cpu's policy (on any cpu of the policy) or by the exit path
+ *       after the hook stopped, so there is one writer
+ * @copies: The two copies of the signal
+ * @active: Whether memutil publishes the signal of the cpu
+ */
+struct published_signal {
+	seqcount_latch_t seq;
+	struct memutil_signal copies[2];
+	bool active;
+};
+
+static DEFINE_PER_CPU(struct published_signal, memutil_signals);
+static DEFINE_PER_CPU(struct dev_pm_qos_request, idle_hint_requests);
+
+void memutil_cpu_signal(unsigned int cpu, struct memutil_signal *signal)
+{
+	struct published_signal *published = per_cpu_ptr(&memutil_signals, cpu);
+	const struct memutil_signal *copy;
+	unsigned int seq;
+
+	//the raw variants, as the per-cpu seqcounts have no lockdep map
+	do {
+		seq = raw_read_seqcount_latch(&published->seq);
+		copy = &published->copies[seq & 1];
+		signal->boundness = READ_ONCE(copy->boundness);
+		signal->stall_share = READ_ONCE(copy->stall_share);
+		signal->time_ns = READ_ONCE(copy->time_ns);
+	} while (memutil_read_seqcount_latch_retry(&published->seq, seq));
+}
+EXPORT_SYMBOL_GPL(memutil_cpu_signal);
+
+unsigned int memutil_memory_boundness(unsigned int cpu)
+{
+	struct memutil_signal signal;
+
+	memutil_cpu_signal(cpu, &signal);
+	return signal.boundness;
+}
+EXPORT_SYMBOL_GPL(memutil_memory_boundness);
+
+static void write_copy(struct memutil_signal *copy, u32 boundness, u32 stall_share, u64 time)
+{
+	WRITE_ONCE(copy->boundness, boundness);
+	WRITE_ONCE(copy->stall_share, stall_share);
+	WRITE_ONCE(copy->time_ns, time);
+}
+
+/**
+ * publish_signal - Publish the signal of the given cpu, which does not have to
+ *                  be the current one. Has to be called by the only writer of
+ *                  the signal, see struct published_signal.
+ */
+static void publish_signal(unsigned int cpu, u32 boundness, u32 stall_share, u64 time)
+{
+	struct published_signal *published = per_cpu_ptr(&memutil_signals, cpu);
+
+	raw_write_seqcount_latch(&published->seq);
+	write_copy(&published->copies[0], boundness, stall_share, time);
+	raw_write_seqcount_latch(&published->seq);
+	write_copy(&published->copies[1], boundness, stall_share, time);
+}
+
+static s32 hint_latency(const struct memutil_idle_hint *hint, int value)
+{
+	return value == MEMUTIL_IDLE_HINT_SHALLOW ? hint->latency_us : PM_QOS_RESUME_LATENCY_NO_CONSTRAINT;
+}
+
+static void update_work_fn(struct work_struct *work)
+{
+	struct memutil_idle_hint *hint = container_of(work, struct memutil_idle_hint, update_work);
+	int value = READ_ONCE(hint->hint);
+	unsigned int cpu;
+	int return_value;
+
+	if (READ_ONCE(hint->stopping) || value == hint->applied_hint) {
+		return;
+	}
+	for_each_cpu(cpu, hint->policy->cpus) {
+		return_value = dev_pm_qos_update_request(per_cpu_ptr(&idle_hint_requests, cpu),
+							 hint_latency(hint, value));
+		if (return_value < 0) {
+			pr_warn_ratelimited("Memutil: Failed to update the resume latency (core=%u): %d", cpu,
+					    return_value);
+		}
+	}
+	hint->applied_hint = value;
+}
+
+static void irq_work_fn(struct irq_work *irq_work)
+{
+	struct memutil_idle_hint *hint = container_of(irq_work, struct memutil_idle_hint, irq_work);
+
+	schedule_work(&hint->update_work);
+}
+
+int memutil_idle_hint_init(struct memutil_idle_hint *hint, struct cpufreq_policy *policy, s32 latency_us)
+{
+	unsigned int cpu, added;
+	int return_value = 0;
+
+	hint->policy = policy;
+	hint->boundness = 0;
+	hint->hint = MEMUTIL_IDLE_HINT_DEEP;
+	hint->applied_hint = MEMUTIL_IDLE_HINT_DEEP;
+	hint->latency_us = 0;
+	hint->stopping = false;
+	init_irq_work(&hint->irq_work, irq_work_fn);
+	INIT_WORK(&hint->update_work, update_work_fn);
+	for_each_cpu(cpu, policy->cpus) {
+		WRITE_ONCE(per_cpu_ptr(&memutil_signals, cpu)->active, true);
+	}
+	if (latency_us <= 0) {
+		return 0;
+	}
+
+	for_each_cpu(cpu, policy->cpus) {
+		return_value = dev_pm_qos_add_request(get_cpu_device(cpu), per_cpu_ptr(&idle_hint_requests, cpu),
+						      DEV_PM_QOS_RESUME_LATENCY, PM_QOS_RESUME_LATENCY_NO_CONSTRAINT);
+		if (return_value < 0) {
+			goto fail_add_request;
+		}
+	}
+	hint->latency_us = latency_us;
+	return 0;
+
+fail_add_request:
+	for_each_cpu(added, policy->cpus) {
+		if (added == cpu) {
+			break;
+		}
+		dev_pm_qos_remove_request(per_cpu_ptr(&idle_hint_requests, added));
+	}
+	for_each_cpu(cpu, policy->cpus) {
+		WRITE_ONCE(per_cpu_ptr(&memutil_signals, cpu)->active, false);
+	}
+	return return_value;
+}
+
+void memutil_idle_hint_exit(struct memutil_idle_hint *hint)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, hint->policy->cpus) {
+		WRITE_ONCE(per_cpu_ptr(&memutil_signals, cpu)->active, false);
+		publish_signal(cpu, 0, 0, 0);
+	}
+	if (!hint->latency_us) {
+		return;
+	}
+	WRITE_ONCE(hint->stopping, true);
+	irq_work_sync(&hint->irq_work);
+	cancel_work_sync(&hint->update_work);
+	for_each_cpu(cpu, hint->policy->cpus) {
+		dev_pm_qos_remove_request(per_cpu_ptr(&idle_hint_requests, cpu));
+	}
+}
+
+unsigned int memutil_idle_hint_update(struct memutil_idle_hint *hint, s64 share, unsigned int util, u64 time)
+{
+	unsigned int cpu;
+	int value = hint->hint;
+
+	if (share >= 0) {
+		hint->boundness += (share - (s64)hint->boundness) / (1 << BOUNDNESS_SHIFT);
+		for_each_cpu(cpu, hint->policy->cpus) {
+			publish_signal(cpu, hint->boundness, share, time);
+		}
+	}
+	if (!hint->latency_us) {
+		return hint->boundness;
+	}
+
+	if (hint->boundness < MEMUTIL_IDLE_HINT_COMPUTE_SHARE) {
+		value = MEMUTIL_IDLE_HINT_SHALLOW;
+	} else if (hint->boundness >= MEMUTIL_IDLE_HINT_MEMORY_SHARE && util < MEMUTIL_IDLE_HINT_LOW_UTIL) {
+		value = MEMUTIL_IDLE_HINT_DEEP;
+	}
+	if (value != hint->hint) {
+		WRITE_ONCE(hint->hint, value);
+		irq_work_queue(&hint->irq_work);
+	}
+	return hint->boundness;
+}
+
+void memutil_idle_hint_show(struct seq_file *seq)
+{
+	struct memutil_signal signal;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (!READ_ONCE(per_cpu_ptr(&memutil_signals, cpu)->active)) {
+			continue;
+		}
+		memutil_cpu_signal(cpu, &signal);
+		seq_printf(seq, "%u,%u,%u\n", cpu, signal.boundness, signal.stall_share);
+	}
+}
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_idle_hint.h
+ *
+ * Header file for the memory boundness signal and the cpuidle hints derived
+ * from it. The cpuidle governor picks the idle state of a cpu without knowing
+ * whether the cpu is in a stall dominated phase. Every policy therefore
+ * publishes its memory boundness (the stall share of its busy intervals,
+ * smoothed) per cpu, see memutil_memory_boundness(). Together with the stall
+ * share of the last busy interval and its timestamp it is also published as a
+ * consistent sample, see memutil_cpu_signal(), which other modules, BPF
+ * programs (see memutil_bpf.h) and the debugfs boundness file read
+ * without a lock and without opening perf counters of their own.
+ *
+ * Optionally the boundness is turned into a per-cpu resume latency PM QoS
+ * request, which the cpuidle governors honour:
+ *
+ *   shallow: The boundness is below MEMUTIL_IDLE_HINT_COMPUTE_SHARE, i.e. the
+ *            cpu runs bursty compute, where a deep idle state between the
+ *            bursts costs more latency than it saves. The resume latency is
+ *            limited to the configured value.
+ *   deep:    The boundness is at least MEMUTIL_IDLE_HINT_MEMORY_SHARE and the
+ *            cpu is busy less than MEMUTIL_IDLE_HINT_LOW_UTIL of the time, i.e.
+ *            its short bursts only wait for the memory anyway. The request does
+ *            not constrain the idle state.
+ *
+ * In between, the previous hint is kept. PM QoS requests can sleep, so the
+ * update hook queues an irq_work (which queues a work item) when the hint
+ * changes.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_IDLE_HINT_H
+#define _MEMUTIL_IDLE_HINT_H
+
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+/**
+ * struct memutil_signal - Memory stall signal of one cpu
+ *
+ * @boundness: Smoothed stall share (in permille) of the cpu's busy intervals
+ * @stall_share: Stall share (in permille) of the last busy interval
+ * @time_ns: Timestamp (scheduler clock) of the last busy interval, 0 if there
+ *           was none or memutil does not run on the cpu
+ */
+struct memutil_signal {
+	u32 boundness;
+	u32 stall_share;
+	u64 time_ns;
+};
+
+/* Boundness (in permille) below which the resume latency is limited */
+#define MEMUTIL_IDLE_HINT_COMPUTE_SHARE 300
+/* Boundness (in permille) from which the resume latency is not constrained at low utilization */
+#define MEMUTIL_IDLE_HINT_MEMORY_SHARE 500
+/* Utilization (in permille) below which a memory bound cpu counts as mostly idle */
+#define MEMUTIL_IDLE_HINT_LOW_UTIL 500
+
+/* Hints, also the buckets of the idle_hint_time_ns statistics (see MEMUTIL_STATS_IDLE_HINTS) */
+#define MEMUTIL_IDLE_HINT_DEEP 0
+#define MEMUTIL_IDLE_HINT_SHALLOW 1
+
+/**
+ * struct memutil_idle_hint - Memory boundness and cpuidle hint of one policy
+ *
+ * @policy: The policy whose cpus get the hints
+ * @boundness: Smoothed stall share (in permille) of the busy intervals, only
+ *             accessed by the update hook
+ * @hint: Hint the update hook asks for
+ * @latency_us: Resume latency (in microseconds) of the shallow hint, 0 if no
+ *              PM QoS requests are made
+ * @applied_hint: Hint of the PM QoS requests, only accessed by update_work
+ * @stopping: Set when the policy stops, so that the requests are not updated
+ * @irq_work: Queues update_work from the update hook
+ * @update_work: Updates the PM QoS requests to match hint
+ */
+struct memutil_idle_hint {
+	struct cpufreq_policy *policy;
+	u32 boundness;
+	int hint;
+	s32 latency_us;
+	int applied_hint;
+	bool stopping;
+	struct irq_work irq_work;
+	struct work_struct update_work;
+};
+
+/**
+ * memutil_memory_boundness - Get the memory boundness of the given cpu.
+ *
+ *                            Returns the smoothed stall share (in permille)
+ *                            of the cpu's busy intervals, 0 if memutil does
+ *                            not run on the cpu.
+ *                            This function does not sleep.
+ * @cpu: The cpu
+ */
+unsigned int memutil_memory_boundness(unsigned int cpu);
+/**
+ * memutil_cpu_signal - Read the memory stall signal of the given cpu. The
+ *                      fields belong to the same interval. The writer is
+ *                      never waited for, the read is only retried if the
+ *                      writer published a new signal in the meantime.
+ *
+ *                      This function does not sleep and may be called from
+ *                      any context, including NMI.
+ * @cpu: The cpu
+ * @signal: Filled with the signal, all zero if memutil does not run on the cpu
+ */
+void memutil_cpu_signal(unsigned int cpu, struct memutil_signal *signal);
+/**
+ * memutil_idle_hint_init - Initialize the idle hint state of the given policy
+ *                          and add the PM QoS requests of its cpus if a
+ *                          latency is given.
+ *
+ *                          Returns 0 on success, otherwise an error code, in
+ *                          which case no requests were added.
+ *                          This function may sleep.
+ * @hint: The state to initialize
+ * @policy: The policy whose cpus get the hints
+ * @latency_us: Resume latency (in microseconds) of the shallow hint, 0 to only
+ *              publish the boundness
+ */
+int memutil_idle_hint_init(struct memutil_idle_hint *hint, struct cpufreq_policy *policy, s32 latency_us);
+/**
+ * memutil_idle_hint_exit - Remove the PM QoS requests and clear the published
+ *                          boundness. The update hook of the policy must not
+ *                          run anymore.
+ *
+ *                          This function may sleep.
+ * @hint: The state of the policy
+ */
+void memutil_idle_hint_exit(struct memutil_idle_hint *hint);
+/**
+ * memutil_idle_hint_update - Publish the boundness after the interval that just
+ *                            ended and adapt the hint to it.
+ *
+ *                            Returns the published boundness (in permille).
+ *                            This function does not sleep.
+ * @hint: The state of the policy
+ * @share: Stall share (in permille) of the interval, negative if the interval
+ *         was idle
+ * @util: Share (in permille) of the interval the cpu was busy
+ * @time: Timestamp (nanosecond resolution) of the update
+ */
+unsigned int memutil_idle_hint_update(struct memutil_idle_hint *hint, s64 share, unsigned int util, u64 time);
+
+/**
+ * memutil_idle_hint_show - Print the signal of every cpu memutil publishes it
+ *                          for as the lines "cpu,boundness,stall_share" of the
+ *                          debugfs boundness file.
+ */
+void memutil_idle_hint_show(struct seq_file *seq);
+
+#endif //_MEMUTIL_IDLE_HINT_H
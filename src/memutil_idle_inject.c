@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_idle_inject.c
+ *
+ * Implementation file for the idle injection companion.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/module.h>
+#include <linux/printk.h>
+#include <linux/version.h>
+
+#include "memutil_idle_inject.h"
+
+#define WITH_IDLE_INJECT (IS_ENABLED(CONFIG_IDLE_INJECT) && LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0))
+
+#if WITH_IDLE_INJECT
+#include <linux/idle_inject.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+MODULE_IMPORT_NS("IDLE_INJECT");
+#else
+MODULE_IMPORT_NS(IDLE_INJECT);
+#endif
+
+/**
+ * set_durations - Split the injection period into run and idle time for the
+ *                 given idle share (in permille).
+ */
+static void set_durations(struct idle_inject_device *device, unsigned int share)
+{
+	unsigned int idle_us = MEMUTIL_IDLE_INJECT_PERIOD_US / 1000 * share;
+
+	idle_inject_set_duration(device, MEMUTIL_IDLE_INJECT_PERIOD_US - idle_us, idle_us);
+}
+
+static void start_work_fn(struct work_struct *work)
+{
+	struct memutil_idle_inject *state = container_of(work, struct memutil_idle_inject, start_work);
+	bool inject = READ_ONCE(state->target) > 0 && !READ_ONCE(state->stopping);
+	int return_value;
+
+	if (inject && !state->running) {
+		return_value = idle_inject_start(state->device);
+		if (return_value) {
+			pr_warn_ratelimited("Memutil: Failed to start the idle injection: %d", return_value);
+			return;
+		}
+		state->running = true;
+	} else if (!inject && state->running) {
+		idle_inject_stop(state->device);
+		state->running = false;
+	}
+}
+
+static void irq_work_fn(struct irq_work *irq_work)
+{
+	struct memutil_idle_inject *state = container_of(irq_work, struct memutil_idle_inject, irq_work);
+
+	schedule_work(&state->start_work);
+}
+
+int memutil_idle_inject_init(struct memutil_idle_inject *state, struct cpufreq_policy *policy)
+{
+	state->device = idle_inject_register(policy->cpus);
+	if (!state->device) {
+		//e.g. the cpus are already used by another idle injection (powerclamp, cpuidle cooling)
+		return -EBUSY;
+	}
+	state->target = 0;
+	state->running = false;
+	state->stopping = false;
+	init_irq_work(&state->irq_work, irq_work_fn);
+	INIT_WORK(&state->start_work, start_work_fn);
+	return 0;
+}
+
+void memutil_idle_inject_exit(struct memutil_idle_inject *state)
+{
+	WRITE_ONCE(state->stopping, true);
+	irq_work_sync(&state->irq_work);
+	cancel_work_sync(&state->start_work);
+	if (state->running) {
+		idle_inject_stop(state->device);
+		state->running = false;
+	}
+	idle_inject_unregister(state->device);
+	state->device = NULL;
+}
+
+unsigned int memutil_idle_inject_update(struct memutil_idle_inject *state, s64 share, bool at_min,
+					int threshold, int max_loss)
+{
+	unsigned int target = 0;
+	unsigned int last_target = state->target;
+
+	if (at_min && share > threshold && threshold < 1000) {
+		//proportional to the stall share above the threshold, i.e. the estimated memory wait
+		target = (share - threshold) * clamp(max_loss, 0, 1000) / (1000 - threshold);
+		if (target < MEMUTIL_IDLE_INJECT_MIN_SHARE) {
+			target = 0;
+		}
+	} else if (share < 0) {
+		//an idle interval does not change the injection
+		target = last_target;
+	}
+	if (target == last_target) {
+		return target;
+	}
+	if (target > 0) {
+		set_durations(state->device, target);
+	}
+	WRITE_ONCE(state->target, target);
+	if (!last_target != !target) {
+		irq_work_queue(&state->irq_work);
+	}
+	return target;
+}
+
+#else //WITH_IDLE_INJECT
+
+int memutil_idle_inject_init(struct memutil_idle_inject *state, struct cpufreq_policy *policy)
+{
+	return -EOPNOTSUPP;
+}
+
+void memutil_idle_inject_exit(struct memutil_idle_inject *state)
+{
+}
+
+unsigned int memutil_idle_inject_update(struct memutil_idle_inject *state, s64 share, bool at_min,
+					int threshold, int max_loss)
+{
+	return 0;
+}
+
+#endif //WITH_IDLE_INJECT
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_idle_inject.h
+ *
+ * Header file for the idle injection companion. When the stall share of an
+ * interval is close to 100%, the lowest OPP still burns power while the core
+ * waits for the memory. Once a policy already runs at policy->min and its
+ * stall share exceeds the configured threshold, the idle_inject framework
+ * forces its cpus into idle for a share of every MEMUTIL_IDLE_INJECT_PERIOD_US
+ * that grows linearly with the stall share above the threshold, up to the
+ * maximum throughput loss. Every injected idle period is counted as lost
+ * throughput, so the loss stays within the maximum even if the core was not
+ * waiting for the memory at that moment.
+ *
+ * The idle_inject threads have to be started and stopped from process
+ * context, so the update hook only sets the durations and queues an irq_work
+ * (which queues a work item) when the injection has to be started or stopped.
+ *
+ * Needs a kernel with CONFIG_IDLE_INJECT (Linux 6.3 or newer, where the
+ * framework is exported to modules), otherwise the initialization fails.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_IDLE_INJECT_H
+#define _MEMUTIL_IDLE_INJECT_H
+
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+/* Length (in microseconds) of one run + idle cycle of the injection */
+#define MEMUTIL_IDLE_INJECT_PERIOD_US 10000
+/* Smallest idle share (in permille) that is injected, shorter idle periods cost more than they save */
+#define MEMUTIL_IDLE_INJECT_MIN_SHARE 20
+
+struct idle_inject_device;
+
+/**
+ * struct memutil_idle_inject - Idle injection state of one policy
+ *
+ * @device: The idle_inject device of the policy's cpus
+ * @irq_work: Queues start_work from the update hook
+ * @start_work: Starts or stops the injection to match target
+ * @target: Idle share (in permille) the update hook asks for, 0 to stop
+ * @running: Whether the injection is running, only accessed by start_work
+ * @stopping: Set when the policy stops, so that the injection is not restarted
+ */
+struct memutil_idle_inject {
+	struct idle_inject_device *device;
+	struct irq_work irq_work;
+	struct work_struct start_work;
+	unsigned int target;
+	bool running;
+	bool stopping;
+};
+
+/**
+ * memutil_idle_inject_init - Register the idle_inject device of the given
+ *                            policy's cpus.
+ *
+ *                            Returns 0 on success, otherwise an error code.
+ *                            This function may sleep.
+ * @state: The state to initialize
+ * @policy: The policy whose cpus get idle injected
+ */
+int memutil_idle_inject_init(struct memutil_idle_inject *state, struct cpufreq_policy *policy);
+/**
+ * memutil_idle_inject_exit - Stop the injection and unregister the device. The
+ *                            update hook of the policy must not run anymore.
+ *
+ *                            This function may sleep.
+ * @state: The state of the policy
+ */
+void memutil_idle_inject_exit(struct memutil_idle_inject *state);
+/**
+ * memutil_idle_inject_update - Calculate the idle share for the next interval
+ *                              and adapt the injection to it.
+ *
+ *                              Returns the idle share (in permille) that is
+ *                              injected from now on, 0 if none.
+ *                              This function does not sleep.
+ * @state: The state of the policy
+ * @share: Stall share (in permille) of the interval, negative if the interval
+ *         was idle
+ * @at_min: Whether the interval and the next one run at policy->min
+ * @threshold: Stall share (in permille) above which idle is injected
+ * @max_loss: Maximum throughput loss (in permille), i.e. the largest idle share
+ */
+unsigned int memutil_idle_inject_update(struct memutil_idle_inject *state, s64 share, bool at_min,
+					int threshold, int max_loss);
+
+#endif //_MEMUTIL_IDLE_INJECT_H
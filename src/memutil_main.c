@@ -18,15 +18,24 @@
 #include <linux/init.h> // included for __init and __exit macros
 #include <linux/err.h>
 #include <linux/module.h> // included for all kernel modules
+#include <linux/mutex.h>
 #include <linux/percpu-defs.h>
 #include <linux/perf_event.h>
 #include <linux/printk.h>
 #include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/topology.h>
 #include <linux/smp.h>
 #include <linux/types.h>
 #include <linux/sched/cpufreq.h>
+#include <linux/sched/topology.h>
 #include <uapi/linux/sched/types.h>
 #include <trace/events/power.h>
+#ifdef CONFIG_X86
+#include <asm/processor.h>
+#endif
 
 #include "memutil_ringbuffer_log.h"
 #include "memutil_printk_helper.h"
@@ -35,9 +44,23 @@
 #include "memutil_debugfs_infofile.h"
 #include "memutil_perf_read_local.h"
 #include "memutil_perf_counter.h"
-
-#define HEURISTIC_IPC 1
-#define HEURISTIC_OFFCORE_STALLS 2
+#include "memutil_stats.h"
+#include "memutil_timing.h"
+#include "memutil_heuristic.h"
+#include "memutil_calibration.h"
+#include "memutil_app_hint.h"
+#include "memutil_autorange.h"
+#include "memutil_bpf.h"
+#include "memutil_energy.h"
+#include "memutil_feedback.h"
+#include "memutil_idle_hint.h"
+#include "memutil_idle_inject.h"
+#include "memutil_phase.h"
+#include "memutil_powercap.h"
+#include "memutil_saturation.h"
+#include "memutil_uncore.h"
+#include "memutil_probing.h"
+#include "memutil_qlearning.h"
 
 /*
  * Size for the ringbuffers (one per cpu) into which logging information
@@ -59,13 +82,22 @@
  */
 #define WITH_DEFFERED_FREQ_SWITCH 1
 
+/*
+ * Switch to toggle whether the frequency is passed to drivers that manage the
+ * P-states in hardware (intel_pstate in passive mode with HWP, amd-pstate) as
+ * a performance level via cpufreq_driver_adjust_perf(), like schedutil does.
+ * Only enable if your kernel exports cpufreq_driver_adjust_perf() and
+ * cpufreq_driver_has_adjust_perf() (see KERNEL_HACKING.md).
+ */
+#define WITH_ADJUST_PERF 0
+
 /*
  * Heuristic to use. See the wiki page for Memutil Heuristics and Porting
  * for more information.
  */
 #define HEURISTIC HEURISTIC_OFFCORE_STALLS
 
-#if HEURISTIC != HEURISTIC_IPC && HEURISTIC != HEURISTIC_OFFCORE_STALLS
+#if HEURISTIC != HEURISTIC_IPC && HEURISTIC != HEURISTIC_OFFCORE_STALLS && HEURISTIC != HEURISTIC_QLEARNING
 #error "Unknown heuristic choosen"
 #endif
 
@@ -89,13 +121,41 @@
  * struct memutil_policy - The memutil data for a cpufreq policy that uses the
  *                         memutil governor
  *
+ *                         The structure is allocated on the node of the policy's
+ *                         cpu and split into three cachelines: configuration
+ *                         that is only written during init / start, state that
+ *                         the policy's cpu changes with every update (the
+ *                         thresholds are changed by auto-ranging there, and
+ *                         only rarely by the parameter setters) and the
+ *                         shared state that other cpus write as well, i.e.
+ *                         limits_changed (memutil_limits() runs on any cpu)
+ *                         and the fields used for deferred frequency
+ *                         switching that are also touched from the irq_work
+ *                         and the kthread.
+ *
  * @policy: The cpufreq policy that is the parent of this data
- * @last_freq_update_time_ns: Timestamp (nanoseconds) of when the last frequency update was made
  * @freq_update_delay_ns: How much time (in nanoseconds) should occur between consecutive frequency updates
  * @events: The perf events that are measured
+ * @logbuffer: The log - ringbuffer that logs the frequency update data
+ * @autorange: Auto-ranging state that adapts heuristic_params, NULL if disabled
+ * @energy_source: The energy source that is read with every update, NULL if disabled
+ * @feedback: Energy feedback state that shifts heuristic_params, NULL if disabled
+ * @adjust_perf: Whether frequencies are requested with cpufreq_driver_adjust_perf()
+ * @probing: Whether the frequency sensitivity is probed (see memutil_probing.h)
+ * @phase: Phase detection state that switches ahead of phase changes, NULL if disabled
+ * @uncore: Whether the cpu takes part in the uncore coordination of its package
+ * @saturation: Whether the cpu takes part in the saturation detection of its package
+ * @powercap: Whether the cpu takes part in the power cap of its package
+ * @idle_inject: Idle injection state for heavily memory bound intervals, NULL if disabled
+ * @idle_hint: Memory boundness signal and cpuidle hints, NULL without the stall events
+ * @app_hint: Whether the phase hints of the applications are applied (see memutil_app_hint.h)
+ * @last_freq_update_time_ns: Timestamp (nanoseconds) of when the last frequency update was made
  * @last_event_value: The last value each event had the last time they were read
  * @last_requested_freq: The frequency (in kHz) that was last requested during a frequency update
- * @logbuffer: The log - ringbuffer that logs the frequency update data
+ * @last_energy: The energy counters the last time they were read
+ * @heuristic_params: Interpolation range used by the heuristic
+ * @limits_changed: Set by memutil_limits() so that the next update hook call
+ *                  makes a frequency update right away
  * @update_lock: Lock to synchronize updates to this structure. Only needed when
  *               we use an extra thread for frequency updates.
  * @irq_work: Used to issue a frequency update via an interrupt
@@ -105,19 +165,36 @@
  * @kthread: The thread itself that is used to process frequency updates
  * @freq_update_in_progress: Boolean that stores whether a deferred frequency
  *                           update is currently being carried out
+ * @work_lock: Serializes the frequency changes of the kthread and memutil_limits()
  */
 struct memutil_policy {
+	/* Read-mostly configuration: */
 	struct cpufreq_policy	*policy;
-
-	u64			last_freq_update_time_ns;
 	s64			freq_update_delay_ns;
-
 	struct perf_event	*events[PERF_EVENT_COUNT];
+	struct memutil_ringbuffer *logbuffer;
+	struct memutil_autorange *autorange;
+	const struct memutil_energy_source *energy_source;
+	struct memutil_feedback *feedback;
+	bool			adjust_perf;
+	bool			probing;
+	struct memutil_phase	*phase;
+	bool			uncore;
+	bool			saturation;
+	bool			powercap;
+	struct memutil_idle_inject *idle_inject;
+	struct memutil_idle_hint *idle_hint;
+	bool			app_hint;
+
+	/* Hot state that is only accessed by the policy's cpu in the update hook: */
+	u64			last_freq_update_time_ns ____cacheline_aligned_in_smp;
 	u64			last_event_value[PERF_EVENT_COUNT];
-
 	unsigned int		last_requested_freq;
+	struct memutil_energy_sample last_energy;
+	struct memutil_heuristic_params heuristic_params;
 
-	struct memutil_ringbuffer *logbuffer;
+	/* Shared state that is also written from other cpus, the irq_work or the kthread: */
+	bool			limits_changed ____cacheline_aligned_in_smp;
 
 	/* The next fields are only needed if fast switch cannot be used: */
 #if WITH_DEFFERED_FREQ_SWITCH
@@ -131,6 +208,7 @@ struct memutil_policy {
 	struct			kthread_worker kthread_worker;
 	struct task_struct	*kthread;
 	bool			freq_update_in_progress;
+	struct mutex		work_lock;
 #endif
 };
 
@@ -168,14 +246,11 @@ static char *event_name2 = "cycles"; //use same event twice to hopefully not use
 static char *event_name3 = "cycles";
 
 /* Max ipc value (in percent) (see wiki heursitics and porting page) */
-static int max_ipc = 45;
+static int max_ratio = 45;
 /* Min ipc value (in percent) (see wiki heursitics and porting page) */
-static int min_ipc = 10;
-
-module_param(max_ipc, int, S_IRUSR | S_IRGRP | S_IROTH);
-MODULE_PARM_DESC(max_ipc, "max (IPC*100) value");
-module_param(min_ipc, int, S_IRUSR | S_IRGRP | S_IROTH);
-MODULE_PARM_DESC(min_ipc, "min (IPC*100) value");
+static int min_ratio = 10;
+/* Min ipc value (in percent) to enter the turbo range */
+static int turbo_ratio = 60;
 
 #elif HEURISTIC == HEURISTIC_OFFCORE_STALLS
 
@@ -185,15 +260,261 @@ static char *event_name2 = "cpu_clk_unhalted.thread";
 static char *event_name3 = "cycle_activity.stalls_l2_miss";
 
 /* Max stalls per cycle value (in percent) (see wiki heursitics and porting page) */
-static int max_stalls_per_cycle = 65;
+static int max_ratio = 65;
 /* Min stalls per cycle value (in percent) (see wiki heursitics and porting page) */
-static int min_stalls_per_cycle = 10;
+static int min_ratio = 10;
+/* Max stalls per cycle value (in percent) to enter the turbo range */
+static int turbo_ratio = 5;
+
+#elif HEURISTIC == HEURISTIC_QLEARNING
+
+/* names of the perf counter events we measure */
+static char *event_name1 = "inst_retired.any";
+static char *event_name2 = "cpu_clk_unhalted.thread";
+static char *event_name3 = "cycle_activity.stalls_l2_miss";
+
+/*
+ * Stalls per cycle thresholds (in percent). Not used by the decision, only by
+ * the calibration, auto-ranging and energy feedback that adapt them.
+ */
+static int max_ratio = 65;
+static int min_ratio = 10;
+/* Max stalls per cycle value (in percent) to enter the turbo range */
+static int turbo_ratio = 5;
+
+/* Tunables of the Q-learning heuristic (see memutil_qlearning.h) */
+static struct memutil_qlearning_config ql_config = {
+	.explore = 50,
+	.learn = true,
+	.reward = MEMUTIL_QL_REWARD_IPJ,
+	.static_power = 300,
+};
+
+module_param_named(ql_explore, ql_config.explore, int, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ql_explore, "Probability (permille) of a random Q-learning action");
+module_param_named(ql_learn, ql_config.learn, bool, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ql_learn, "Update the Q-learning tables, disable to use an imported policy as it is");
+module_param_named(ql_static_power, ql_config.static_power, int, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ql_static_power, "Share (permille) of the power at max frequency that does not depend on the frequency");
+
+/* Name of the Q-learning reward ("ipj" or "edp") */
+static char *ql_reward = "ipj";
+
+module_param(ql_reward, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(ql_reward, "Q-learning reward: ipj (work per energy) or edp (inverse energy-delay product)");
+
+#endif
+
+/*
+ * Performance loss (in permille) the slowdown budget heuristic may cause compared
+ * to the maximum frequency. 0 keeps the linear interpolation of the offcore
+ * stalls heuristic.
+ */
+static int slowdown_budget = 0;
+
+#if HEURISTIC == HEURISTIC_IPC
+module_param_named(turbo_ipc, turbo_ratio, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(turbo_ipc, "min (IPC*100) value to enter the turbo range");
+#else
+module_param_named(turbo_stalls_per_cycle, turbo_ratio, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(turbo_stalls_per_cycle, "max (stalls_per_cycle*100) value to enter the turbo range");
+#endif
+
+/* Highest frequency (in KHz) below the turbo range, 0 to detect it */
+static unsigned int base_freq = 0;
+
+module_param(base_freq, uint, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(base_freq, "Highest non-turbo frequency in KHz, 0 to detect it");
+
+/* Average amount of decisions between two frequency sensitivity probes, 0 disables probing */
+static unsigned int probe_period = 0;
+
+module_param(probe_period, uint, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(probe_period, "Probe the frequency sensitivity every ~N decisions (>= 20), 0 to disable");
+
+/* Whether the thresholds are calibrated when the governor starts */
+static bool calibrate = false;
+
+module_param(calibrate, bool, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(calibrate, "Calibrate the heuristic thresholds per core type at start");
+
+/* Whether the thresholds are adapted to the observed ratios while running */
+static bool autorange = false;
+
+module_param(autorange, bool, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(autorange, "Adapt the heuristic thresholds to the P5 / P95 of the observed ratios");
+
+/* Whether recurring workload phases are detected to switch the frequency ahead of them */
+static bool phase_detection = false;
+
+module_param(phase_detection, bool, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(phase_detection, "Detect recurring workload phases and switch the frequency up ahead of predicted ones");
+
+/* Name of the energy source that is read with every update ("none", "msr" or "mock") */
+static char *energy_source = "none";
+
+module_param(energy_source, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(energy_source, "Energy source to log and feed back: none, msr (RAPL) or mock");
+
+/* Objective of the energy feedback ("none", "edp" or "epi"), needs an energy source */
+static char *energy_feedback = "none";
+
+module_param(energy_feedback, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(energy_feedback, "Shift the thresholds to minimize: none, edp (energy-delay product) or epi (energy per work)");
+
+/* Whether the frequency of all cpus of a package is capped while the package saturates its memory bandwidth */
+static bool saturation = false;
+
+module_param(saturation, bool, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(saturation, "Cap the frequency of all cores of a package that saturates its memory bandwidth");
+
+/* Power budget (in milliwatts) of each package, 0 to disable the power cap mode. Needs an energy source. */
+static int power_cap_mw = 0;
 
-module_param(max_stalls_per_cycle, int, S_IRUSR | S_IRGRP | S_IROTH);
+module_param(power_cap_mw, int, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(power_cap_mw, "Package power budget (mW) that is kept by lowering memory bound cores first, 0 to disable");
+
+/* Stall share (permille) above which idle is injected at the minimum frequency, 0 to disable the idle injection */
+static int idle_stall_threshold = 0;
+
+module_param(idle_stall_threshold, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(idle_stall_threshold, "Inject idle at the minimum frequency above this stall share (permille), 0 to disable");
+
+/* Maximum throughput loss (permille) of the idle injection */
+static int idle_max_loss = 100;
+
+module_param(idle_max_loss, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(idle_max_loss, "Maximum throughput loss (permille) of the idle injection");
+
+/* Resume latency (us) requested while a cpu runs bursty compute, 0 to only publish the memory boundness */
+static int idle_hint_latency_us = 0;
+
+module_param(idle_hint_latency_us, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(idle_hint_latency_us, "Resume latency PM QoS limit (us) for compute bound cpus, 0 to disable the cpuidle hints");
+
+/* Whether applications can announce their phases through /dev/memutil */
+static bool app_hints = false;
+
+module_param(app_hints, bool, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(app_hints, "Apply the memory / compute / latency phase hints that threads announce through /dev/memutil");
+
+/* Name of the uncore backend that coordinates the uncore frequency ("none", "msr" or "mock") */
+static char *uncore = "none";
+
+module_param(uncore, charp, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(uncore, "Uncore backend that scales the uncore with the stalls of its package: none, msr or mock");
+
+/* The energy source selected by the first start, the parameter is read-only */
+static const struct memutil_energy_source *selected_energy_source;
+static bool is_energy_source_selected = false;
+/* Whether the first start attempted to register the BPF kfuncs, they stay registered until the module is unloaded */
+static bool is_bpf_registered = false;
+/* The uncore backend selected by the first start, the parameter is read-only */
+static const struct memutil_uncore_backend *selected_uncore_backend;
+static bool is_uncore_backend_selected = false;
+
+/* Whether the min / max threshold was set by the user, which takes precedence over the calibration */
+static bool min_ratio_overridden = false;
+static bool max_ratio_overridden = false;
+
+#if HEURISTIC != HEURISTIC_QLEARNING
+/**
+ * set_threshold_param - Setter of the threshold module parameters. Besides
+ *                       updating the parameter, the value is applied to all
+ *                       policies that currently use memutil and marked as set
+ *                       by the user, so that it overrides the calibration.
+ */
+static int set_threshold_param(const char *value, const struct kernel_param *kp)
+{
+	struct memutil_policy *memutil_policy;
+	unsigned int cpu;
+	int return_value;
+	bool is_min;
+
+	return_value = param_set_int(value, kp);
+	if (return_value) {
+		return return_value;
+	}
+	is_min = kp->arg == &min_ratio;
+
+	mutex_lock(&memutil_init_mutex);
+	if (is_min) {
+		min_ratio_overridden = true;
+	} else {
+		max_ratio_overridden = true;
+	}
+	for_each_possible_cpu(cpu) {
+		memutil_policy = per_cpu(memutil_cpu_list, cpu).memutil_policy;
+		if (!memutil_policy) {
+			continue;
+		}
+		if (is_min) {
+			WRITE_ONCE(memutil_policy->heuristic_params.min_ratio, min_ratio);
+		} else {
+			WRITE_ONCE(memutil_policy->heuristic_params.max_ratio, max_ratio);
+		}
+	}
+	mutex_unlock(&memutil_init_mutex);
+	return 0;
+}
+
+static const struct kernel_param_ops threshold_param_ops = {
+	.set = set_threshold_param,
+	.get = param_get_int,
+};
+#endif
+
+#if HEURISTIC == HEURISTIC_IPC
+module_param_cb(max_ipc, &threshold_param_ops, &max_ratio, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(max_ipc, "max (IPC*100) value");
+module_param_cb(min_ipc, &threshold_param_ops, &min_ratio, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(min_ipc, "min (IPC*100) value");
+#elif HEURISTIC == HEURISTIC_OFFCORE_STALLS
+module_param_cb(max_stalls_per_cycle, &threshold_param_ops, &max_ratio, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 MODULE_PARM_DESC(max_stalls_per_cycle, "max (stalls_per_cycle*100) value");
-module_param(min_stalls_per_cycle, int, S_IRUSR | S_IRGRP | S_IROTH);
+module_param_cb(min_stalls_per_cycle, &threshold_param_ops, &min_ratio, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 MODULE_PARM_DESC(min_stalls_per_cycle, "min (stalls_per_cycle*100) value");
+#endif
 
+#if HEURISTIC == HEURISTIC_OFFCORE_STALLS
+/**
+ * set_slowdown_budget_param - Setter of the slowdown_budget module parameter.
+ *                             The budget is applied to all policies that
+ *                             currently use memutil.
+ */
+static int set_slowdown_budget_param(const char *value, const struct kernel_param *kp)
+{
+	struct memutil_policy *memutil_policy;
+	unsigned int cpu;
+	int budget, return_value;
+
+	return_value = kstrtoint(value, 0, &budget);
+	if (return_value) {
+		return return_value;
+	}
+	if (budget < 0 || budget > 1000) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&memutil_init_mutex);
+	slowdown_budget = budget;
+	for_each_possible_cpu(cpu) {
+		memutil_policy = per_cpu(memutil_cpu_list, cpu).memutil_policy;
+		if (memutil_policy) {
+			WRITE_ONCE(memutil_policy->heuristic_params.slowdown_budget, budget);
+		}
+	}
+	mutex_unlock(&memutil_init_mutex);
+	return 0;
+}
+
+static const struct kernel_param_ops slowdown_budget_param_ops = {
+	.set = set_slowdown_budget_param,
+	.get = param_get_int,
+};
+
+module_param_cb(slowdown_budget, &slowdown_budget_param_ops, &slowdown_budget, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(slowdown_budget, "Choose the lowest frequency within this performance loss (permille), 0 to interpolate");
 #endif
 
 module_param(event_name1, charp, S_IRUSR | S_IRGRP | S_IROTH);
@@ -210,19 +531,32 @@ MODULE_PARM_DESC(event_name3, "Third perf counter name");
  * @values: perf counter values
  * @cpu: The cpu the data (frequency, perf counters) belongs to
  * @requested_freq: The frequency that was requested / set by memutil
+ * @energy: Energy since the last update, NULL if there is no energy source
+ * @predicted_slowdown: Loss (permille) predicted for requested_freq by the slowdown budget heuristic
+ * @phase: Phase detection state, NULL if disabled
+ * @uncore_ratio: Uncore max ratio of the cpu's package, 0 if not coordinated
+ * @idle_share: Idle share (permille) that is injected from now on
+ * @boundness: Published memory boundness (permille) of the cpu
  * @logbuffer: The buffer into which the data should be logged
  */
-static void memutil_log_data(u64 time, u64 values[PERF_EVENT_COUNT], unsigned int cpu, unsigned int requested_freq, struct memutil_ringbuffer *logbuffer)
+static void memutil_log_data(u64 time, u64 values[PERF_EVENT_COUNT], unsigned int cpu, unsigned int requested_freq,
+			     const struct memutil_energy_sample *energy, unsigned int predicted_slowdown,
+			     const struct memutil_phase *phase, unsigned int uncore_ratio, unsigned int idle_share,
+			     unsigned int boundness, struct memutil_ringbuffer *logbuffer)
 {
-	struct memutil_log_entry data = {
-		.timestamp = time,
-		.perf_value1 = values[0],
-		.perf_value2 = values[1],
-		.perf_value3 = values[2],
-		.requested_freq = requested_freq,
-		.cpu = cpu
-	};
+	struct memutil_log_entry data;
+
 	BUILD_BUG_ON_MSG(PERF_EVENT_COUNT != 3, "Function has to be adjusted for the PERF_EVENT_COUNT");
+	memutil_init_log_entry(&data, time, values, cpu, requested_freq);
+	if (energy) {
+		data.package_energy_uj = min_t(u64, energy->package_nj / NSEC_PER_USEC, U32_MAX);
+		data.core_energy_uj = min_t(u64, energy->core_nj / NSEC_PER_USEC, U32_MAX);
+	}
+	data.predicted_slowdown = min(predicted_slowdown, (unsigned int)U16_MAX);
+	data.phase = phase ? phase->current + 1 : 0;
+	data.uncore_ratio = uncore_ratio;
+	data.idle_share = idle_share;
+	data.boundness = boundness;
 
 	if (logbuffer) { //if initializing logging failed, this is null
 		memutil_write_ringbuffer(logbuffer, &data, 1);
@@ -264,6 +598,131 @@ static int memutil_read_perf_event(struct memutil_policy *policy, int event_inde
 	return 0;
 }
 
+/**
+ * memutil_read_energy - Read the energy consumed since the last update.
+ *
+ * @policy: The policy whose energy source is read. The counters are written to
+ *          the member last_energy
+ * @freq: The frequency (in KHz) the cpu ran at since the last update
+ * @first: Whether this is the first update since the governor started, in which
+ *         case only the counters are stored
+ * @energy: Set to the energy since the last update (0 if the read failed)
+ */
+static void memutil_read_energy(struct memutil_policy *policy, unsigned int freq, bool first,
+				struct memutil_energy_sample *energy)
+{
+	struct memutil_energy_sample sample;
+	int return_value;
+
+	memset(energy, 0, sizeof(*energy));
+	return_value = policy->energy_source->read(&sample, freq);
+	if (unlikely(return_value != 0)) {
+		pr_warn_ratelimited("Memutil: Energy read failed: %d", return_value);
+		return;
+	}
+	if (!first) {
+		energy->package_nj = sample.package_nj - policy->last_energy.package_nj;
+		energy->core_nj = sample.core_nj - policy->last_energy.core_nj;
+	}
+	policy->last_energy = sample;
+}
+
+/**
+ * memutil_interval_work - The work of an update interval for the energy feedback
+ *                         and the probing, measured with the events of the heuristic
+ * @values: perf counter values of the interval
+ */
+static u64 memutil_interval_work(u64 values[PERF_EVENT_COUNT])
+{
+#if HEURISTIC == HEURISTIC_IPC || HEURISTIC == HEURISTIC_QLEARNING
+	return values[MEMUTIL_VALUE_INSTRUCTIONS];
+#else
+	//non-stalled cycles
+	return values[MEMUTIL_VALUE_CYCLES] - min(values[MEMUTIL_VALUE_STALLS], values[MEMUTIL_VALUE_CYCLES]);
+#endif
+}
+
+#ifdef CONFIG_UCLAMP_TASK
+/**
+ * memutil_uclamp_limits - Map the utilization clamps (uclamp_min / uclamp_max)
+ *                         of the task that runs on the current cpu onto the
+ *                         frequency range like schedutil does
+ *                         (clamp * max_freq / capacity).
+ *                         The aggregated clamps of the runqueue are private to
+ *                         the scheduler, but the update hook runs in the
+ *                         context of the cpu's current task, whose effective
+ *                         clamps are set while it is enqueued.
+ *
+ *                         Returns false if the task has no effective clamps.
+ * @policy: The policy of the current cpu
+ * @freq_min: Set to the frequency (in KHz) of uclamp_min
+ * @freq_max: Set to the frequency (in KHz) of uclamp_max, policy->max if unclamped
+ */
+static bool memutil_uclamp_limits(struct cpufreq_policy *policy, unsigned int *freq_min, unsigned int *freq_max)
+{
+	struct task_struct *task = current;
+	unsigned long capacity = arch_scale_cpu_capacity(policy->cpu);
+	u64 max_freq = policy->cpuinfo.max_freq;
+	unsigned long clamp_min, clamp_max;
+
+	if (is_idle_task(task) || !task->uclamp[UCLAMP_MIN].active || !capacity) {
+		return false;
+	}
+	//bitfields, so read plainly like the scheduler does; a torn read is not possible for them
+	clamp_min = min_t(unsigned long, task->uclamp[UCLAMP_MIN].value, capacity);
+	clamp_max = min_t(unsigned long, task->uclamp[UCLAMP_MAX].value, capacity);
+	*freq_max = clamp_max < capacity ? DIV_ROUND_UP_ULL(clamp_max * max_freq, capacity) : policy->max;
+	*freq_min = DIV_ROUND_UP_ULL(clamp_min * max_freq, capacity);
+	return true;
+}
+#endif
+
+/**
+ * memutil_uclamp_frequency - Clamp the given frequency to the utilization clamps
+ *                            of the task that runs on the current cpu, see
+ *                            memutil_uclamp_limits(). As in the scheduler,
+ *                            uclamp_min wins if it exceeds uclamp_max. The
+ *                            result stays within the policy limits.
+ * @policy: The policy of the current cpu
+ * @freq: The frequency (in KHz) chosen by memutil
+ */
+static unsigned int memutil_uclamp_frequency(struct cpufreq_policy *policy, unsigned int freq)
+{
+#ifdef CONFIG_UCLAMP_TASK
+	unsigned int freq_min, freq_max;
+
+	if (!memutil_uclamp_limits(policy, &freq_min, &freq_max)) {
+		return freq;
+	}
+	freq = min(freq, freq_max);
+	freq = max(freq, freq_min);
+	return clamp(freq, policy->min, policy->max);
+#else
+	return freq;
+#endif
+}
+
+/**
+ * memutil_uclamp_boost_pending - Whether the task that runs on the current cpu
+ *                                has a uclamp_min boost above the frequency that
+ *                                was requested last, e.g. because it just woke
+ *                                up an idle cpu.
+ * @memutil_policy: Policy of the current cpu
+ */
+static bool memutil_uclamp_boost_pending(struct memutil_policy *memutil_policy)
+{
+#ifdef CONFIG_UCLAMP_TASK
+	unsigned int freq_min, freq_max;
+
+	if (!memutil_uclamp_limits(memutil_policy->policy, &freq_min, &freq_max)) {
+		return false;
+	}
+	return min(freq_min, memutil_policy->policy->max) > memutil_policy->last_requested_freq;
+#else
+	return false;
+#endif
+}
+
 #if WITH_DEFFERED_FREQ_SWITCH
 /**
  * memutil_deferred_set_frequency - Queue up a deferred frequency change.
@@ -284,9 +743,29 @@ static void memutil_deferred_set_frequency(struct memutil_policy* memutil_policy
 }
 #endif
 
+#if WITH_ADJUST_PERF
+/**
+ * memutil_adjust_perf - Request the given frequency as a performance level
+ *                       relative to the capacity of the policy's cpu. The
+ *                       driver maps it to its own scale, e.g. the HWP desired
+ *                       performance, with the policy minimum as floor.
+ * @policy: Policy for which the performance is requested
+ * @freq: The frequency (in KHz) that should be set
+ */
+static void memutil_adjust_perf(struct cpufreq_policy *policy, unsigned int freq)
+{
+	unsigned long capacity = arch_scale_cpu_capacity(policy->cpu);
+	unsigned int max_freq = max(policy->cpuinfo.max_freq, 1U);
+	unsigned long target_perf = DIV_ROUND_UP_ULL((u64)freq * capacity, max_freq);
+	unsigned long min_perf = DIV_ROUND_UP_ULL((u64)policy->min * capacity, max_freq);
+
+	cpufreq_driver_adjust_perf(policy->cpu, min(min_perf, capacity), min(target_perf, capacity), capacity);
+}
+#endif
+
 /**
  * memutil_set_frequency_to - Set the frequency for the given policy to the given
- *                            value. This uses either a fast_switch if possible,
+ *                            value. This uses either adjust_perf or a fast_switch if possible,
  *                            or queues up a deferred update if fast_switch is not
  *                            possible. If the module was build without deferred
  *                            frequency update support, an error is caused if fast_switch
@@ -311,6 +790,12 @@ int memutil_set_frequency_to(struct memutil_policy* memutil_policy, unsigned int
 		return -EINVAL;
 	}
 
+#if WITH_ADJUST_PERF
+	if (memutil_policy->adjust_perf) {
+		memutil_adjust_perf(policy, freq);
+		return 0;
+	}
+#endif
 	if (policy->fast_switch_enabled) {
 		cpufreq_driver_fast_switch(policy, freq);
 	} else {
@@ -324,63 +809,6 @@ int memutil_set_frequency_to(struct memutil_policy* memutil_policy, unsigned int
 	return 0;
 }
 
-#if HEURISTIC == HEURISTIC_IPC
-/**
- * calculate_frequency_heuristic_ipc - Calculate the frequency to use based on the
- *                                     IPC heuristic (see the wiki page on heuristics)
- * @instructions: Instructions perf event value
- * @cycles: Cycles perf event value
- * @max_freq: Maximum choosable frequency (in KHz)
- * @min_freq: Minimum choosable frequency (in KHz)
- */
-unsigned int calculate_frequency_heuristic_ipc(s64 instructions, s64 cycles, int max_freq, int min_freq)
-{
-	/**
-	 * We cannot use floating point arithmetic, so instead we use fixed point arithmetic,
-	 * treating values as per-cent by multiplying with 100
-	 */
-	s64			instructions_per_cycle;
-	s64                     interpolation_range;
-	s64                     frequency_factor;
-
-	instructions_per_cycle = (instructions * 100) / cycles;
-
-	// Do a linear interpolation:
-	interpolation_range = max_ipc - min_ipc;
-	frequency_factor = clamp(((instructions_per_cycle - min_ipc) * 100) / interpolation_range, 0LL, 100LL);
-	return frequency_factor * (max_freq - min_freq) / 100 + min_freq;
-}
-
-#elif HEURISTIC == HEURISTIC_OFFCORE_STALLS
-
-/**
- * calculate_frequency_heuristic_stalls - Calculate the frequency to use based on the
- *                                        offcore stalls heuristic
- *                                        (see the wiki page on heuristics)
- * @stalls: L2 Stalls perf event value
- * @cycles: Cycles perf event value
- * @max_freq: Maximum choosable frequency (in KHz)
- * @min_freq: Minimum choosable frequency (in KHz)
- */
-unsigned int calculate_frequency_heuristic_stalls(s64 stalls, s64 cycles, int max_freq, int min_freq)
-{
-	/**
-	 * We cannot use floating point arithmetic, so instead we use fixed point arithmetic,
-	 * treating values as per-cent by multiplying with 100
-	 */
-	s64			stalls_per_cycle;
-	s64                     interpolation_range;
-	s64                     frequency_factor;
-
-	stalls_per_cycle = (stalls * 100) / cycles;
-
-	// Do a linear interpolation:
-	interpolation_range = max_stalls_per_cycle - min_stalls_per_cycle;
-	frequency_factor = 100LL - clamp(((stalls_per_cycle - min_stalls_per_cycle) * 100) / interpolation_range, 0LL, 100LL);
-	return frequency_factor * (max_freq - min_freq) / 100 + min_freq;
-}
-#endif
-
 /**
  * memutil_update_frequency - Calculate the frequency which should be used and
  *                            set it for the given policy.
@@ -390,12 +818,22 @@ unsigned int calculate_frequency_heuristic_stalls(s64 stalls, s64 cycles, int ma
 void memutil_update_frequency(struct memutil_policy *memutil_policy, u64 time)
 {
 	u64			event_values[PERF_EVENT_COUNT];
-	s64			cycles;
-	s64 __maybe_unused	instructions;
-	s64 __maybe_unused	offcore_stalls;
+	s64			ratio;
+	struct memutil_energy_sample energy = {0};
+	struct memutil_heuristic_params shifted_params;
+	const struct memutil_heuristic_params *params = &memutil_policy->heuristic_params;
+	int			heuristic = HEURISTIC;
+	unsigned int		predicted_slowdown = 0;
+	unsigned int		uncore_ratio = 0, idle_share = 0, boundness = 0, util;
+	unsigned int		frequency_cap;
+	int			app_hint = MEMUTIL_APP_HINT_NONE;
+	s64			share = 0, measured_share;
+	s64			interval_share = -1, saturated_share;
 
 	unsigned int		new_frequency;
 	int                     max_freq, min_freq, last_freq;
+	u64			start_time, last_update_time;
+	u64			timing;
 
 	int			i;
 
@@ -405,6 +843,9 @@ void memutil_update_frequency(struct memutil_policy *memutil_policy, u64 time)
 	max_freq = policy->max;
 	min_freq = policy->min;
 	last_freq = memutil_policy->last_requested_freq;
+	last_update_time = memutil_policy->last_freq_update_time_ns;
+	start_time = local_clock();
+	timing = memutil_timing_now();
 
 	/**************************
 	 * Read perf event values *
@@ -421,42 +862,143 @@ void memutil_update_frequency(struct memutil_policy *memutil_policy, u64 time)
 		}
 	}
 
-	// this will cast the values into signed types which are easier to work with
-#if HEURISTIC == HEURISTIC_IPC
-	instructions = event_values[0];
-#elif HEURISTIC == HEURISTIC_OFFCORE_STALLS
-	offcore_stalls = event_values[2];
-#endif
-	cycles = event_values[1];
+	if (memutil_policy->energy_source) {
+		memutil_read_energy(memutil_policy, last_freq, !last_update_time, &energy);
+	}
 
-	new_frequency = policy->max;
-	if(unlikely(cycles == 0)) {
-		new_frequency = last_freq;
-		//we could assume that a cycles == 0 value means we have a lot of idling
-		//in which case reducing the frequency would be good. However we did
-		//not test this assumption so we are conservative. Otherwise a line
-		//like the following could be used to decrease the frequency step
-		//by step
-		//new_frequency = max(min_freq, last_freq - (max_freq - min_freq) / 10);
+	memutil_timing_lap(MEMUTIL_TIMING_READ_COUNTERS, &timing);
+
+	if (memutil_policy->feedback) {
+		memutil_feedback_update(memutil_policy->feedback, time, energy.package_nj,
+					memutil_interval_work(event_values), event_values[MEMUTIL_VALUE_CYCLES],
+					last_freq);
+		memutil_feedback_apply(memutil_policy->feedback, params, &shifted_params);
+		params = &shifted_params;
 	}
-	else {
-#if HEURISTIC == HEURISTIC_IPC
-		new_frequency = calculate_frequency_heuristic_ipc(instructions, cycles, max_freq, min_freq);
-#elif HEURISTIC == HEURISTIC_OFFCORE_STALLS
-		new_frequency = calculate_frequency_heuristic_stalls(offcore_stalls, cycles, max_freq, min_freq);
+#if HEURISTIC == HEURISTIC_OFFCORE_STALLS
+	if (READ_ONCE(params->slowdown_budget) > 0) {
+		heuristic = HEURISTIC_SLOWDOWN_BUDGET;
+	}
+#endif
+#if HEURISTIC == HEURISTIC_QLEARNING
+	new_frequency = memutil_qlearning_decide(event_values, max_freq, min_freq, last_freq, &ql_config, &ratio);
+	if (ratio >= 0) {
+		//the ratio is the stalls per cycle
+		new_frequency = memutil_limit_turbo(HEURISTIC_OFFCORE_STALLS, ratio, new_frequency, min_freq, params);
+	}
+#else
+	new_frequency = memutil_decide_frequency(heuristic, event_values, max_freq, min_freq, last_freq,
+						 params, &ratio);
 #endif
+	if (heuristic == HEURISTIC_SLOWDOWN_BUDGET && ratio >= 0) {
+		share = memutil_stall_share(event_values[MEMUTIL_VALUE_STALLS], event_values[MEMUTIL_VALUE_CYCLES]);
+		measured_share = memutil_policy->probing ? memutil_probing_stall_share(ratio) : -1;
+		if (measured_share >= 0) {
+			//the probed sensitivity of the phase replaces the stall based model
+			share = measured_share;
+			new_frequency = memutil_budget_frequency(share, last_freq, max_freq, min_freq,
+								 params->slowdown_budget);
+			new_frequency = memutil_limit_turbo(heuristic, ratio, new_frequency, min_freq, params);
+		}
+		//the prediction is only valid for a frequency the cpu can run at, so round up to one
+		new_frequency = cpufreq_driver_resolve_freq(policy, new_frequency);
+	}
+	if (memutil_policy->phase) {
+		new_frequency = memutil_phase_update(memutil_policy->phase, event_values, new_frequency);
+	}
+	if (memutil_policy->app_hint) {
+		app_hint = memutil_app_hint_current(start_time);
+		if (app_hint == MEMUTIL_APP_HINT_MEMORY) {
+			//the announced phase is stall dominated before the counters of an interval show it
+			frequency_cap = memutil_budget_frequency(MEMUTIL_APP_HINT_MEMORY_SHARE, max_freq, max_freq,
+								 min_freq, MEMUTIL_APP_HINT_BUDGET);
+			new_frequency = min(new_frequency, cpufreq_driver_resolve_freq(policy, frequency_cap));
+		} else if (app_hint == MEMUTIL_APP_HINT_COMPUTE) {
+			new_frequency = max_freq;
+		}
+	}
+	if (event_values[MEMUTIL_VALUE_CYCLES] && (memutil_policy->saturation || memutil_policy->powercap ||
+						     memutil_policy->idle_inject || memutil_policy->idle_hint ||
+						     memutil_policy->uncore)) {
+		//idle intervals do not report a share, so they do not count towards the package
+		interval_share = memutil_stall_share(event_values[MEMUTIL_VALUE_STALLS], event_values[MEMUTIL_VALUE_CYCLES]);
+	}
+	if (memutil_policy->saturation) {
+		measured_share = memutil_policy->probing && ratio >= 0 ? memutil_probing_stall_share(ratio) : -1;
+		saturated_share = memutil_saturation_update(interval_share, measured_share, last_freq, max_freq, time);
+		if (saturated_share >= 0) {
+			//above the cap the cores of the saturated package only wait faster for the memory
+			frequency_cap = memutil_budget_frequency(saturated_share, max_freq, max_freq, min_freq,
+								 MEMUTIL_SATURATION_BUDGET);
+			new_frequency = min(new_frequency, cpufreq_driver_resolve_freq(policy, frequency_cap));
+		}
+	}
+	if (memutil_policy->powercap) {
+		frequency_cap = memutil_powercap_update(interval_share, energy.package_nj,
+							last_update_time ? time - last_update_time : 0, last_freq,
+							max_freq, min_freq, READ_ONCE(power_cap_mw), time);
+		new_frequency = min(new_frequency, frequency_cap);
+	}
+	new_frequency = memutil_uclamp_frequency(policy, new_frequency);
+	if (app_hint == MEMUTIL_APP_HINT_LATENCY) {
+		//like a uclamp_min boost, a latency critical thread wins over the package caps
+		new_frequency = max_freq;
+	}
+	if (memutil_policy->probing) {
+		//after all caps and overrides, so that a probe interval really runs at the probe frequency
+		new_frequency = memutil_probing_update(policy, ratio, memutil_interval_work(event_values),
+						       last_update_time ? time - last_update_time : 0,
+						       last_freq, new_frequency, app_hint == MEMUTIL_APP_HINT_NONE);
+	}
+	if (memutil_policy->idle_inject) {
+		//idle is only injected below the bottom of the frequency range
+		idle_share = memutil_idle_inject_update(memutil_policy->idle_inject, interval_share,
+							last_freq <= min_freq && new_frequency <= min_freq,
+							idle_stall_threshold, idle_max_loss);
+	}
+	if (heuristic == HEURISTIC_SLOWDOWN_BUDGET && ratio >= 0) {
+		predicted_slowdown = memutil_predict_slowdown(share, last_freq, new_frequency, max_freq);
+	}
+	if (memutil_policy->autorange && ratio >= 0) {
+		//thresholds set by the user take precedence, like over the calibration
+		memutil_autorange_update(memutil_policy->autorange, ratio, READ_ONCE(min_ratio_overridden),
+					 READ_ONCE(max_ratio_overridden), &memutil_policy->heuristic_params);
 	}
+	if (memutil_policy->uncore) {
+		uncore_ratio = memutil_uncore_update(interval_share, time);
+	}
+	if (memutil_policy->idle_hint) {
+		if (memutil_policy->idle_hint->latency_us && last_update_time) {
+			memutil_stats_record_idle_hint(memutil_policy->idle_hint->hint, time - last_update_time);
+		}
+		util = 1000;
+		if (last_update_time && last_freq > 0) {
+			//busy share of the interval: cycles / (freq * time)
+			util = min_t(u64, event_values[MEMUTIL_VALUE_CYCLES] * NSEC_PER_SEC / last_freq /
+				     (time - last_update_time), 1000);
+		}
+		boundness = memutil_idle_hint_update(memutil_policy->idle_hint, interval_share, util, time);
+	}
+	memutil_timing_lap(MEMUTIL_TIMING_HEURISTIC, &timing);
+
 	// We always set the frequency, see the wiki memutil architecture page
 	memutil_set_frequency_to(memutil_policy, new_frequency, time);
+	memutil_timing_lap(MEMUTIL_TIMING_SET_FREQUENCY, &timing);
+
+	memutil_stats_record(ratio, last_freq, last_update_time ? time - last_update_time : 0,
+			     local_clock() - start_time);
 
-	memutil_log_data(time, event_values, policy->cpu, memutil_policy->last_requested_freq, memutil_policy->logbuffer);
+	memutil_log_data(time, event_values, policy->cpu, memutil_policy->last_requested_freq,
+			 memutil_policy->energy_source ? &energy : NULL, predicted_slowdown, memutil_policy->phase,
+			 uncore_ratio, idle_share, boundness, memutil_policy->logbuffer);
+	memutil_timing_lap(MEMUTIL_TIMING_LOG, &timing);
 }
 
 /********************** cpufreq governor interface *********************/
 
 /**
  * memutil_policy_alloc - allocate and initialize the memutil policy for the given
- *                        cpufreq policy
+ *                        cpufreq policy on the node of the policy's cpu
  * @policy: The cpufreq policy for which a memutil policy should be allocated
  */
 static struct memutil_policy *
@@ -464,7 +1006,7 @@ memutil_policy_alloc(struct cpufreq_policy *policy)
 {
 	struct memutil_policy *memutil_policy;
 
-	memutil_policy = kzalloc(sizeof(*memutil_policy), GFP_KERNEL);
+	memutil_policy = kzalloc_node(sizeof(*memutil_policy), GFP_KERNEL, cpu_to_node(policy->cpu));
 	if (!memutil_policy) {
 		return NULL;
 	}
@@ -516,7 +1058,9 @@ static void memutil_work(struct kthread_work *work)
 	memutil_policy->freq_update_in_progress = false;
 	raw_spin_unlock_irqrestore(&memutil_policy->update_lock, irq_flags);
 
+	mutex_lock(&memutil_policy->work_lock);
 	__cpufreq_driver_target(memutil_policy->policy, frequency, CPUFREQ_RELATION_L);
+	mutex_unlock(&memutil_policy->work_lock);
 }
 
 /**
@@ -564,10 +1108,12 @@ static int memutil_create_worker_thread(struct memutil_policy* memutil_policy)
 	int return_value;
 
 	kthread_init_work(&memutil_policy->kthread_work, memutil_work);
+	mutex_init(&memutil_policy->work_lock);
 	kthread_init_worker(&memutil_policy->kthread_worker);
-	thread = kthread_create(kthread_worker_fn, &memutil_policy->kthread_worker,
-				"memutil:%d",
-				cpumask_first(policy->related_cpus));
+	thread = kthread_create_on_node(kthread_worker_fn, &memutil_policy->kthread_worker,
+					cpu_to_node(policy->cpu),
+					"memutil:%d",
+					cpumask_first(policy->related_cpus));
 	if (IS_ERR(thread)) {
 		pr_err("Memutil: Failed to create kernel thread: %ld\n", PTR_ERR(thread));
 		return PTR_ERR(thread);
@@ -712,6 +1258,26 @@ static bool memutil_should_update_frequency(struct memutil_policy *memutil_polic
 		return false;
 	}
 
+	if (unlikely(READ_ONCE(memutil_policy->limits_changed))) {
+		WRITE_ONCE(memutil_policy->limits_changed, false);
+		/*
+		 * Like in schedutil: the flag has to be cleared before the limits
+		 * are read by the update, so that a concurrent change is not missed.
+		 */
+		smp_mb();
+		return true;
+	}
+
+	if (memutil_policy->app_hint && memutil_app_hint_announced()) {
+		//a thread on this cpu announced a new phase
+		return true;
+	}
+
+	if (unlikely(memutil_uclamp_boost_pending(memutil_policy))) {
+		//a boosted task that just started running must not wait for the update interval
+		return true;
+	}
+
 	delta_ns = time - memutil_policy->last_freq_update_time_ns;
 
 	return delta_ns >= memutil_policy->freq_update_delay_ns;
@@ -731,12 +1297,15 @@ static void memutil_update_frequency_hook(
 {
 	struct memutil_cpu *memutil_cpu = container_of(hook, struct memutil_cpu, update_util);
 	struct memutil_policy *memutil_policy = memutil_cpu->memutil_policy;
+	u64 timing = memutil_timing_now();
 
 	if(!memutil_should_update_frequency(memutil_policy, time)) {
+		memutil_timing_lap(MEMUTIL_TIMING_HOOK_SKIP, &timing);
 		return;
 	}
 
 	memutil_update_frequency(memutil_policy, time);
+	memutil_timing_lap(MEMUTIL_TIMING_DECISION, &timing);
 }
 
 /**
@@ -753,6 +1322,7 @@ static void print_start_info(struct memutil_policy *memutil_policy, struct memut
 		return;
 	}
 	pr_info("Memutil: Fastswitch is %s", memutil_policy->policy->fast_switch_enabled ? "enabled" : "disabled");
+	pr_info("Memutil: Adjust perf is %s", memutil_policy->adjust_perf ? "enabled" : "disabled");
 	pr_info("Memutil: Info\n"
 		"Populatable CPUs=%d\n"
 		"Populated CPUs=%d\n"
@@ -780,7 +1350,7 @@ static void init_logging_once(struct memutil_policy *memutil_policy, struct memu
 	infofile_data->core_count = num_online_cpus(); // cores available to scheduler
 	infofile_data->log_ringbuffer_size = LOG_RINGBUFFER_SIZE;
 
-	is_logfile_initialized = memutil_debugfs_init(infofile_data) == 0;
+	is_logfile_initialized = memutil_debugfs_init(infofile_data, HEURISTIC == HEURISTIC_QLEARNING) == 0;
 	if (!is_logfile_initialized) {
 		pr_warn("Memutil: Failed to initialize memutil debugfs");
 	}
@@ -801,11 +1371,11 @@ static void init_logging(struct memutil_policy *memutil_policy, struct memutil_i
 
 	mutex_lock(&memutil_init_mutex);
 	init_logging_once(memutil_policy, infofile_data);
-	memutil_policy->logbuffer = memutil_open_ringbuffer(LOG_RINGBUFFER_SIZE);
+	memutil_policy->logbuffer = memutil_open_ringbuffer(LOG_RINGBUFFER_SIZE, cpu_to_node(memutil_policy->policy->cpu));
 	if (!memutil_policy->logbuffer) {
 		pr_warn("Memutil: Failed to create memutil logbuffer");
 	} else if (is_logfile_initialized) {
-		memutil_debugfs_register_ringbuffer(memutil_policy->logbuffer);
+		memutil_debugfs_register_ringbuffer(memutil_policy->logbuffer, memutil_policy->policy->cpu);
 	}
 	mutex_unlock(&memutil_init_mutex);
 	debug_info("Memutil: Leaving init logging");
@@ -819,6 +1389,8 @@ static void setup_per_cpu_data(struct memutil_policy *memutil_policy)
 {
 	unsigned int cpu;
 	debug_info("Memutil: Setting up per CPU data");
+	//the threshold parameter setter walks the per cpu data
+	mutex_lock(&memutil_init_mutex);
 	for_each_cpu(cpu, memutil_policy->policy->cpus) {
 		struct memutil_cpu *mu_cpu = &per_cpu(memutil_cpu_list, cpu);
 
@@ -826,6 +1398,7 @@ static void setup_per_cpu_data(struct memutil_policy *memutil_policy)
 		mu_cpu->cpu 		= cpu;
 		mu_cpu->memutil_policy	= memutil_policy;
 	}
+	mutex_unlock(&memutil_init_mutex);
 	debug_info("Memutil: Finished setting up per CPU data");
 }
 
@@ -860,6 +1433,382 @@ static int allocate_perf_counters(struct memutil_policy *policy)
 	return memutil_allocate_perf_counters_for_cpu(policy->policy->cpu, event_names, policy->events, PERF_EVENT_COUNT);
 }
 
+/**
+ * calibrate_thresholds - Replace the thresholds of the given policy by the
+ *                        calibration of its core type, unless they were set
+ *                        by the user.
+ * @memutil_policy: Policy whose thresholds should be calibrated. The perf
+ *                  counters have to be allocated already.
+ */
+static void calibrate_thresholds(struct memutil_policy *memutil_policy)
+{
+	struct memutil_heuristic_params params;
+
+	if (memutil_calibrate(memutil_policy->policy, memutil_policy->events, HEURISTIC, &params) != 0) {
+		pr_warn("Memutil: Calibration failed, using the configured thresholds (core=%d)",
+			memutil_policy->policy->cpu);
+		return;
+	}
+	mutex_lock(&memutil_init_mutex);
+	if (!min_ratio_overridden) {
+		memutil_policy->heuristic_params.min_ratio = params.min_ratio;
+	}
+	if (!max_ratio_overridden) {
+		memutil_policy->heuristic_params.max_ratio = params.max_ratio;
+	}
+	mutex_unlock(&memutil_init_mutex);
+}
+
+/**
+ * init_autorange - Allocate the auto-ranging state of the given policy on the
+ *                  node of its cpu, starting from the current thresholds.
+ *                  Without the state the policy keeps static thresholds.
+ * @memutil_policy: Policy for which auto-ranging should be enabled
+ */
+static void init_autorange(struct memutil_policy *memutil_policy)
+{
+	memutil_policy->autorange = kzalloc_node(sizeof(*memutil_policy->autorange), GFP_KERNEL,
+						 cpu_to_node(memutil_policy->policy->cpu));
+	if (!memutil_policy->autorange) {
+		pr_warn("Memutil: Failed to allocate autorange state, using static thresholds (core=%d)",
+			memutil_policy->policy->cpu);
+		return;
+	}
+	memutil_autorange_init(memutil_policy->autorange, &memutil_policy->heuristic_params);
+}
+
+/**
+ * detect_base_freq - The highest frequency (in KHz) below the turbo / boost
+ *                    range of the given policy, 0 if it is unknown. Boost OPPs
+ *                    are taken from the frequency table (flagged, or the
+ *                    acpi-cpufreq convention of a turbo entry 1 MHz above the
+ *                    base), otherwise the base frequency from CPUID is used.
+ * @policy: The policy whose turbo range should be detected
+ */
+static unsigned int detect_base_freq(struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *pos;
+	unsigned int highest = 0, second = 0, non_boost = 0;
+	bool has_boost = false;
+#ifdef CONFIG_X86
+	unsigned int eax, ebx, ecx, edx;
+#endif
+
+	if (base_freq) {
+		return base_freq;
+	}
+	if (policy->freq_table) {
+		cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+			if (pos->flags & CPUFREQ_BOOST_FREQ) {
+				has_boost = true;
+			} else {
+				non_boost = max(non_boost, pos->frequency);
+			}
+			if (pos->frequency > highest) {
+				second = highest;
+				highest = pos->frequency;
+			} else if (pos->frequency > second && pos->frequency < highest) {
+				second = pos->frequency;
+			}
+		}
+		if (has_boost) {
+			return non_boost;
+		}
+		if (second && highest == second + 1000) {
+			return second;
+		}
+	}
+#ifdef CONFIG_X86
+	if (boot_cpu_data.cpuid_level >= 0x16) {
+		cpuid(0x16, &eax, &ebx, &ecx, &edx);
+		if (eax & 0xffff) {
+			return (eax & 0xffff) * 1000;
+		}
+	}
+#endif
+	return 0;
+}
+
+/**
+ * init_turbo - Set the turbo range of the given policy. Without a range above
+ *              the base frequency the frequency is not limited.
+ * @memutil_policy: Policy whose turbo range should be set
+ */
+static void init_turbo(struct memutil_policy *memutil_policy)
+{
+	struct cpufreq_policy *policy = memutil_policy->policy;
+	unsigned int base = detect_base_freq(policy);
+
+	if (base >= policy->cpuinfo.max_freq) {
+		base = 0;
+	}
+	memutil_policy->heuristic_params.base_freq = base;
+	memutil_policy->heuristic_params.turbo_ratio = turbo_ratio;
+	if (base) {
+		pr_info("Memutil: Turbo range %u-%u KHz, boost %s (core=%d)", base, policy->cpuinfo.max_freq,
+			cpufreq_boost_enabled() ? "enabled" : "disabled", policy->cpu);
+	} else {
+		pr_info("Memutil: No turbo range detected (core=%d)", policy->cpu);
+	}
+}
+
+/**
+ * init_phase - Allocate the phase detection state of the given policy on the
+ *              node of its cpu. Without the state the policy does not switch
+ *              ahead of phases.
+ * @memutil_policy: Policy for which phase detection should be enabled
+ */
+static void init_phase(struct memutil_policy *memutil_policy)
+{
+	memutil_policy->phase = kzalloc_node(sizeof(*memutil_policy->phase), GFP_KERNEL,
+					     cpu_to_node(memutil_policy->policy->cpu));
+	if (!memutil_policy->phase) {
+		pr_warn("Memutil: Failed to allocate phase detection state (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+	memutil_phase_init(memutil_policy->phase);
+}
+
+/**
+ * init_app_hint - Register the device through which the applications announce
+ *                 their phases (once for all policies) and apply the hints on
+ *                 the cpu of the given policy.
+ * @memutil_policy: Policy whose cpu should apply the hints
+ */
+static void init_app_hint(struct memutil_policy *memutil_policy)
+{
+	int return_value = memutil_app_hint_get();
+
+	if (return_value) {
+		pr_warn("Memutil: Failed to register the application hint device (core=%d): %d",
+			memutil_policy->policy->cpu, return_value);
+		return;
+	}
+	memutil_policy->app_hint = true;
+}
+
+/**
+ * init_saturation - Let the cpu of the given policy take part in the
+ *                   saturation detection of its package.
+ * @memutil_policy: Policy whose cpu should report its stalls
+ */
+static void init_saturation(struct memutil_policy *memutil_policy)
+{
+	int return_value;
+
+	if (!probe_period) {
+		pr_warn("Memutil: The saturation detection needs probe_period (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+#if HEURISTIC == HEURISTIC_IPC
+	//the IPC events do not count stalls
+	return_value = -EOPNOTSUPP;
+#else
+	return_value = memutil_saturation_init_cpu(memutil_policy->policy->cpu);
+#endif
+	if (return_value) {
+		pr_warn("Memutil: Failed to detect the memory bandwidth saturation (core=%d): %d",
+			memutil_policy->policy->cpu, return_value);
+		return;
+	}
+	memutil_policy->saturation = true;
+}
+
+/**
+ * init_powercap - Let the cpu of the given policy take part in the power cap of
+ *                 its package. Has to be called after init_energy().
+ * @memutil_policy: Policy whose cpu should report its power and stalls
+ */
+static void init_powercap(struct memutil_policy *memutil_policy)
+{
+	int return_value;
+
+	if (!memutil_policy->energy_source) {
+		pr_warn("Memutil: The power cap needs an energy source (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+#if HEURISTIC == HEURISTIC_IPC
+	//the IPC events do not count stalls
+	return_value = -EOPNOTSUPP;
+#else
+	return_value = memutil_powercap_init_cpu(memutil_policy->policy->cpu,
+						 memutil_policy->energy_source->cpu_scope);
+#endif
+	if (return_value) {
+		pr_warn("Memutil: Failed to apply the power cap (core=%d): %d", memutil_policy->policy->cpu,
+			return_value);
+		return;
+	}
+	memutil_policy->powercap = true;
+}
+
+/**
+ * init_idle_inject - Allocate the idle injection state of the given policy on
+ *                    the node of its cpu and register its cpus for the idle
+ *                    injection.
+ * @memutil_policy: Policy whose cpus should get idle injected
+ */
+static void init_idle_inject(struct memutil_policy *memutil_policy)
+{
+	struct memutil_idle_inject *idle_inject;
+	int return_value;
+
+	idle_inject = kzalloc_node(sizeof(*idle_inject), GFP_KERNEL, cpu_to_node(memutil_policy->policy->cpu));
+	if (!idle_inject) {
+		pr_warn("Memutil: Failed to allocate idle injection state (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+#if HEURISTIC == HEURISTIC_IPC
+	//the IPC events do not count stalls
+	return_value = -EOPNOTSUPP;
+#else
+	return_value = memutil_idle_inject_init(idle_inject, memutil_policy->policy);
+#endif
+	if (return_value) {
+		pr_warn("Memutil: Failed to register the idle injection (core=%d): %d", memutil_policy->policy->cpu,
+			return_value);
+		kfree(idle_inject);
+		return;
+	}
+	memutil_policy->idle_inject = idle_inject;
+}
+
+/**
+ * init_idle_hint - Allocate the idle hint state of the given policy on the node
+ *                  of its cpu, so that it publishes its memory boundness, and
+ *                  add its resume latency requests if enabled. The first call
+ *                  also registers the BPF kfuncs that read the boundness.
+ * @memutil_policy: Policy whose cpus get the hints
+ */
+static void init_idle_hint(struct memutil_policy *memutil_policy)
+{
+	struct memutil_idle_hint *idle_hint;
+	int return_value;
+
+	mutex_lock(&memutil_init_mutex);
+	if (!is_bpf_registered) {
+		return_value = memutil_bpf_register();
+		if (return_value) {
+			pr_warn("Memutil: Failed to register the BPF kfuncs of the memory boundness: %d", return_value);
+		}
+		is_bpf_registered = true;
+	}
+	mutex_unlock(&memutil_init_mutex);
+
+	idle_hint = kzalloc_node(sizeof(*idle_hint), GFP_KERNEL, cpu_to_node(memutil_policy->policy->cpu));
+	if (!idle_hint) {
+		pr_warn("Memutil: Failed to allocate idle hint state (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+	return_value = memutil_idle_hint_init(idle_hint, memutil_policy->policy, idle_hint_latency_us);
+	if (return_value) {
+		pr_warn("Memutil: Failed to add the resume latency requests (core=%d): %d",
+			memutil_policy->policy->cpu, return_value);
+		//the boundness is still published
+		memutil_idle_hint_init(idle_hint, memutil_policy->policy, 0);
+	}
+	memutil_policy->idle_hint = idle_hint;
+}
+
+/**
+ * init_uncore - Select the uncore backend (once for all policies) and let the
+ *               cpu of the given policy take part in the coordination of its
+ *               package.
+ * @memutil_policy: Policy whose cpu should report its stalls
+ */
+static void init_uncore(struct memutil_policy *memutil_policy)
+{
+	int return_value;
+
+	mutex_lock(&memutil_init_mutex);
+	if (!is_uncore_backend_selected) {
+		selected_uncore_backend = memutil_uncore_select(uncore);
+		is_uncore_backend_selected = true;
+	}
+	mutex_unlock(&memutil_init_mutex);
+
+	if (!selected_uncore_backend) {
+		return;
+	}
+#if HEURISTIC == HEURISTIC_IPC
+	//the IPC events do not count stalls
+	return_value = -EOPNOTSUPP;
+#else
+	return_value = memutil_uncore_init_cpu(memutil_policy->policy->cpu, selected_uncore_backend);
+#endif
+	if (return_value) {
+		pr_warn("Memutil: Failed to coordinate the uncore (core=%d): %d", memutil_policy->policy->cpu,
+			return_value);
+		return;
+	}
+	memutil_policy->uncore = true;
+}
+
+/**
+ * init_energy - Select the energy source (once for all policies) and allocate
+ *               the energy feedback state of the given policy on the node of
+ *               its cpu if the feedback is enabled.
+ * @memutil_policy: Policy for which the energy source should be used
+ */
+static void init_energy(struct memutil_policy *memutil_policy)
+{
+	int objective = memutil_feedback_parse_objective(energy_feedback);
+	int return_value;
+
+	mutex_lock(&memutil_init_mutex);
+	if (!is_energy_source_selected) {
+		selected_energy_source = memutil_energy_select(energy_source);
+		is_energy_source_selected = true;
+	}
+	memutil_policy->energy_source = selected_energy_source;
+	mutex_unlock(&memutil_init_mutex);
+
+	if (objective == MEMUTIL_FEEDBACK_NONE) {
+		return;
+	}
+	if (objective < 0) {
+		pr_warn("Memutil: Unknown energy feedback objective %s", energy_feedback);
+		return;
+	}
+	if (!memutil_policy->energy_source) {
+		pr_warn("Memutil: Energy feedback needs an energy source (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+	memutil_policy->feedback = kzalloc_node(sizeof(*memutil_policy->feedback), GFP_KERNEL,
+						cpu_to_node(memutil_policy->policy->cpu));
+	if (!memutil_policy->feedback) {
+		pr_warn("Memutil: Failed to allocate energy feedback state (core=%d)", memutil_policy->policy->cpu);
+		return;
+	}
+	return_value = memutil_feedback_init(memutil_policy->feedback, objective, memutil_policy->policy->cpu,
+					     memutil_policy->energy_source->cpu_scope);
+	if (return_value) {
+		pr_warn("Memutil: Failed to initialize the energy feedback (core=%d): %d", memutil_policy->policy->cpu,
+			return_value);
+		kfree(memutil_policy->feedback);
+		memutil_policy->feedback = NULL;
+	}
+}
+
+#if HEURISTIC == HEURISTIC_QLEARNING
+/**
+ * init_qlearning - Apply the configured reward and allocate the Q-learning
+ *                  table of the given policy's cpu.
+ * @memutil_policy: Policy for which the table should be allocated
+ */
+static int init_qlearning(struct memutil_policy *memutil_policy)
+{
+	int reward = memutil_qlearning_parse_reward(ql_reward);
+
+	if (reward < 0) {
+		pr_warn("Memutil: Unknown Q-learning reward %s, using ipj", ql_reward);
+		reward = MEMUTIL_QL_REWARD_IPJ;
+	}
+	WRITE_ONCE(ql_config.reward, reward);
+	return memutil_qlearning_init_cpu(memutil_policy->policy);
+}
+#endif
+
 /**
  * memutil_start - Governor start method (see memutil wiki architecture page)
  * @policy: Policy for which the start is done
@@ -874,10 +1823,18 @@ static int memutil_start(struct cpufreq_policy *policy)
 	struct memutil_policy *memutil_policy = policy->governor_data;
 
 	memutil_policy->last_freq_update_time_ns	= 0;
+	memutil_policy->limits_changed		= false;
 	memutil_policy->freq_update_delay_ns	= max(NSEC_PER_USEC * cpufreq_policy_transition_delay_us(policy), 5 * NSEC_PER_MSEC);
 #if WITH_DEFFERED_FREQ_SWITCH
 	memutil_policy->freq_update_in_progress        = false;
 #endif
+#if WITH_ADJUST_PERF
+	//adjust_perf is only called from the update hook of the policy's cpu, like a fast switch
+	memutil_policy->adjust_perf = policy->fast_switch_enabled && cpufreq_driver_has_adjust_perf();
+#endif
+	memutil_policy->heuristic_params.min_ratio	= min_ratio;
+	memutil_policy->heuristic_params.max_ratio	= max_ratio;
+	memutil_policy->heuristic_params.slowdown_budget = READ_ONCE(slowdown_budget);
 	infofile_data.update_interval_ms = memutil_policy->freq_update_delay_ns / NSEC_PER_MSEC;
 
 	print_start_info(memutil_policy, &infofile_data);
@@ -894,11 +1851,55 @@ static int memutil_start(struct cpufreq_policy *policy)
 	if (return_value != 0) {
 		goto fail_allocate_perf_counters;
 	}
+#if HEURISTIC == HEURISTIC_QLEARNING
+	return_value = init_qlearning(memutil_policy);
+	if (return_value != 0) {
+		pr_warn("Memutil: Failed to allocate Q-learning table (core=%d)", policy->cpu);
+		goto fail_qlearning;
+	}
+#endif
+	init_turbo(memutil_policy);
+	if (calibrate) {
+		calibrate_thresholds(memutil_policy);
+	}
+	if (autorange) {
+		init_autorange(memutil_policy);
+	}
+	if (phase_detection) {
+		init_phase(memutil_policy);
+	}
+	init_energy(memutil_policy);
+	if (saturation) {
+		init_saturation(memutil_policy);
+	}
+	if (power_cap_mw > 0) {
+		init_powercap(memutil_policy);
+	}
+	if (idle_stall_threshold > 0) {
+		init_idle_inject(memutil_policy);
+	}
+#if HEURISTIC != HEURISTIC_IPC
+	//the IPC events do not count stalls
+	init_idle_hint(memutil_policy);
+#endif
+	init_uncore(memutil_policy);
+	if (app_hints) {
+		init_app_hint(memutil_policy);
+	}
+	if (probe_period) {
+		memutil_probing_init_cpu(policy, probe_period);
+		memutil_policy->probing = true;
+	}
 	setup_per_cpu_data(memutil_policy);
+	memutil_stats_init_cpu(policy, memutil_policy->heuristic_params.base_freq);
 	install_update_hook(policy);
 
 	return 0;
 
+#if HEURISTIC == HEURISTIC_QLEARNING
+fail_qlearning:
+	memutil_release_perf_events(memutil_policy->events, PERF_EVENT_COUNT);
+#endif
 fail_allocate_perf_counters:
 	if (memutil_policy->policy->cpu == cpumask_first(cpu_online_mask)) {
 		memutil_teardown_events_map();
@@ -906,6 +1907,7 @@ fail_allocate_perf_counters:
 fail_events_map:
 	mutex_lock(&memutil_init_mutex);
 	if (is_logfile_initialized) {
+		memutil_debugfs_unregister_ringbuffer(policy->cpu);
 		memutil_debugfs_exit();
 		is_logfile_initialized = false;
 	}
@@ -933,6 +1935,49 @@ static void memutil_stop(struct cpufreq_policy *policy)
 	}
 
 	synchronize_rcu();
+	memutil_stats_exit_cpu(policy->cpu);
+	if (memutil_policy->probing) {
+		memutil_probing_exit_cpu(policy->cpu);
+		memutil_policy->probing = false;
+	}
+#if HEURISTIC == HEURISTIC_QLEARNING
+	memutil_qlearning_exit_cpu(policy->cpu);
+#endif
+	kfree(memutil_policy->autorange);
+	memutil_policy->autorange = NULL;
+	if (memutil_policy->feedback) {
+		memutil_feedback_exit(memutil_policy->feedback, policy->cpu);
+		kfree(memutil_policy->feedback);
+		memutil_policy->feedback = NULL;
+	}
+	kfree(memutil_policy->phase);
+	memutil_policy->phase = NULL;
+	if (memutil_policy->saturation) {
+		memutil_saturation_exit_cpu(policy->cpu);
+		memutil_policy->saturation = false;
+	}
+	if (memutil_policy->idle_hint) {
+		memutil_idle_hint_exit(memutil_policy->idle_hint);
+		kfree(memutil_policy->idle_hint);
+		memutil_policy->idle_hint = NULL;
+	}
+	if (memutil_policy->idle_inject) {
+		memutil_idle_inject_exit(memutil_policy->idle_inject);
+		kfree(memutil_policy->idle_inject);
+		memutil_policy->idle_inject = NULL;
+	}
+	if (memutil_policy->powercap) {
+		memutil_powercap_exit_cpu(policy->cpu);
+		memutil_policy->powercap = false;
+	}
+	if (memutil_policy->uncore) {
+		memutil_uncore_exit_cpu(policy->cpu);
+		memutil_policy->uncore = false;
+	}
+	if (memutil_policy->app_hint) {
+		memutil_app_hint_put();
+		memutil_policy->app_hint = false;
+	}
 
 #if WITH_DEFFERED_FREQ_SWITCH
 	if (!policy->fast_switch_enabled) {
@@ -943,7 +1988,11 @@ static void memutil_stop(struct cpufreq_policy *policy)
 
 	memutil_release_perf_events(memutil_policy->events, PERF_EVENT_COUNT);
 	mutex_lock(&memutil_init_mutex);
+	for_each_cpu(cpu, policy->cpus) {
+		per_cpu(memutil_cpu_list, cpu).memutil_policy = NULL;
+	}
 	if (is_logfile_initialized) {
+		memutil_debugfs_unregister_ringbuffer(policy->cpu);
 		memutil_debugfs_exit();
 		is_logfile_initialized = false;
 	}
@@ -963,7 +2012,26 @@ static void memutil_stop(struct cpufreq_policy *policy)
  */
 static void memutil_limits(struct cpufreq_policy *policy)
 {
-	pr_info("Memutil: Limits changed (core=%d)", policy->cpu);
+	struct memutil_policy *memutil_policy = policy->governor_data;
+
+	pr_info("Memutil: Limits changed to %u-%u KHz, boost %s (core=%d)", policy->min, policy->max,
+		cpufreq_boost_enabled() ? "enabled" : "disabled", policy->cpu);
+
+#if WITH_DEFFERED_FREQ_SWITCH
+	if (!policy->fast_switch_enabled) {
+		//bring the current frequency into the new limits right away
+		mutex_lock(&memutil_policy->work_lock);
+		cpufreq_policy_apply_limits(policy);
+		mutex_unlock(&memutil_policy->work_lock);
+	}
+#endif
+	/*
+	 * The counters can only be read on the policy's cpu, so the frequency
+	 * is recomputed by the next update hook call instead of waiting for the
+	 * update interval to pass.
+	 */
+	smp_wmb();
+	WRITE_ONCE(memutil_policy->limits_changed, true);
 }
 
 /**
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_package.c
+ *
+ * Implementation file for the per-package aggregation.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/cpumask.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/topology.h>
+
+#include "memutil_package.h"
+
+/**
+ * max_packages - Amount of packages the machine can have
+ */
+static unsigned int max_packages(void)
+{
+#ifdef CONFIG_X86
+	return topology_max_packages();
+#else
+	unsigned int cpu, count = 0;
+
+	for_each_possible_cpu(cpu) {
+		count = max(count, (unsigned int)topology_logical_package_id(cpu) + 1);
+	}
+	return count;
+#endif
+}
+
+/**
+ * alloc_set - Allocate the package states and reports of the set. Has to be
+ *             called with the set's mutex held.
+ */
+static int alloc_set(struct memutil_package_set *set)
+{
+	struct memutil_package *package;
+	unsigned int index;
+
+	set->package_count = max_packages();
+	set->packages = kcalloc(set->package_count, set->package_size, GFP_KERNEL);
+	if (!set->packages) {
+		return -ENOMEM;
+	}
+	set->reports = alloc_percpu(struct memutil_package_report);
+	if (!set->reports) {
+		kfree(set->packages);
+		set->packages = NULL;
+		return -ENOMEM;
+	}
+	for (index = 0; index < set->package_count; ++index) {
+		package = memutil_package_get(set, index);
+		raw_spin_lock_init(&package->lock);
+		package->index = index;
+	}
+	return 0;
+}
+
+/**
+ * free_set - Free the package states and reports of the set. Has to be called
+ *            with the set's mutex held.
+ */
+static void free_set(struct memutil_package_set *set)
+{
+	free_percpu(set->reports);
+	set->reports = NULL;
+	kfree(set->packages);
+	set->packages = NULL;
+}
+
+int memutil_package_join(struct memutil_package_set *set, unsigned int cpu, void *arg)
+{
+	struct memutil_package_report *report;
+	struct memutil_package *package;
+	unsigned int index = topology_logical_package_id(cpu);
+	int return_value = 0;
+
+	mutex_lock(&set->mutex);
+	if (set->users == 0) {
+		return_value = alloc_set(set);
+		if (return_value) {
+			goto unlock;
+		}
+	}
+	if (index >= set->package_count) {
+		return_value = -ERANGE;
+		goto free;
+	}
+	package = memutil_package_get(set, index);
+	if (package->users == 0) {
+		package->last_update_ns = 0;
+		if (set->join) {
+			return_value = set->join(package, cpu, arg);
+			if (return_value) {
+				goto free;
+			}
+		}
+	}
+	package->users++;
+	set->users++;
+	report = per_cpu_ptr(set->reports, cpu);
+	*report = (struct memutil_package_report) {
+		.package = index,
+	};
+	WRITE_ONCE(report->in_use, true);
+
+free:
+	if (set->users == 0) {
+		free_set(set);
+	}
+unlock:
+	mutex_unlock(&set->mutex);
+	return return_value;
+}
+
+void memutil_package_leave(struct memutil_package_set *set, unsigned int cpu)
+{
+	struct memutil_package_report *report;
+	struct memutil_package *package;
+
+	mutex_lock(&set->mutex);
+	if (set->users == 0) {
+		goto unlock;
+	}
+	report = per_cpu_ptr(set->reports, cpu);
+	if (!report->in_use) {
+		goto unlock;
+	}
+	WRITE_ONCE(report->in_use, false);
+	package = memutil_package_get(set, report->package);
+	if (--package->users == 0 && set->leave) {
+		set->leave(package, cpu);
+	}
+	//the hooks of all cpus of the set are gone with its last cpu
+	if (--set->users == 0) {
+		free_set(set);
+	}
+unlock:
+	mutex_unlock(&set->mutex);
+}
+
+bool memutil_package_try_begin(struct memutil_package_set *set, struct memutil_package *package, u64 time)
+{
+	if ((s64)(time - READ_ONCE(package->last_update_ns)) < set->period_ns ||
+	    !raw_spin_trylock(&package->lock)) {
+		return false;
+	}
+	//another cpu might have aggregated the package in the meantime
+	if ((s64)(time - package->last_update_ns) < set->period_ns) {
+		raw_spin_unlock(&package->lock);
+		return false;
+	}
+	package->last_update_ns = time;
+	return true;
+}
+
+void memutil_package_summarize(struct memutil_package_set *set, u64 time, struct memutil_package_summary *summary)
+{
+	const struct memutil_package_report *report;
+	unsigned int cpu;
+	int i;
+	u32 value;
+
+	*summary = (struct memutil_package_summary) {0};
+	for_each_cpu(cpu, topology_core_cpumask(smp_processor_id())) {
+		report = per_cpu_ptr(set->reports, cpu);
+		if (!READ_ONCE(report->in_use)) {
+			continue;
+		}
+		summary->users++;
+		//idle cpus do not report, their last report is outdated
+		if ((s64)(time - READ_ONCE(report->time_ns)) >= 2 * set->period_ns) {
+			continue;
+		}
+		summary->busy++;
+		for (i = 0; i < MEMUTIL_PACKAGE_VALUES; ++i) {
+			value = READ_ONCE(report->values[i]);
+			summary->sum[i] += value;
+			summary->max[i] = max(summary->max[i], value);
+		}
+	}
+}
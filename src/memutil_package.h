@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_package.h
+ *
+ * Header file for the per-package aggregation shared by the package level
+ * features (uncore coordination, saturation detection, power cap). Every cpu
+ * that takes part in a feature reports up to MEMUTIL_PACKAGE_VALUES values
+ * from its update hook. About every period one cpu of a package takes the
+ * package's lock (only ever try-locked, the other cpus go on without waiting)
+ * and aggregates the reports of the cpus of the package that were busy
+ * recently, i.e. within two periods.
+ *
+ * Each feature defines a struct memutil_package_set with the size of its
+ * package state, which embeds struct memutil_package as its first member. The
+ * package states and the reports are allocated when the first cpu joins the
+ * set, for as many packages as the machine can have (topology_max_packages()),
+ * and freed when the last cpu leaves it.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_PACKAGE_H
+#define _MEMUTIL_PACKAGE_H
+
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/* Amount of values each cpu reports */
+#define MEMUTIL_PACKAGE_VALUES 2
+
+/**
+ * struct memutil_package - Generic state of one package, the first member of
+ *                          the package state of a feature
+ *
+ * @lock: Serializes the aggregation, only ever try-locked in the update hook
+ * @last_update_ns: Timestamp of the last aggregation
+ * @index: Logical package id
+ * @users: Amount of cpus of the package that take part in the feature
+ */
+struct memutil_package {
+	raw_spinlock_t lock;
+	u64 last_update_ns;
+	unsigned int index;
+	unsigned int users;
+};
+
+/**
+ * struct memutil_package_report - Report of one cpu
+ *
+ * @values: The reported values, their meaning depends on the feature
+ * @time_ns: Timestamp of the last report, 0 if there is none
+ * @package: Logical package id of the cpu
+ * @in_use: Whether the cpu takes part in the feature
+ */
+struct memutil_package_report {
+	u32 values[MEMUTIL_PACKAGE_VALUES];
+	u64 time_ns;
+	unsigned int package;
+	bool in_use;
+};
+
+/**
+ * struct memutil_package_summary - Aggregated reports of the busy cpus of a package
+ *
+ * @users: Amount of cpus of the package that take part in the feature
+ * @busy: Amount of them that reported within the last two periods
+ * @sum: Sum of each value over the busy cpus
+ * @max: Maximum of each value over the busy cpus
+ */
+struct memutil_package_summary {
+	unsigned int users;
+	unsigned int busy;
+	u64 sum[MEMUTIL_PACKAGE_VALUES];
+	u32 max[MEMUTIL_PACKAGE_VALUES];
+};
+
+/**
+ * struct memutil_package_set - Packages and reports of one feature
+ *
+ * @package_size: Size of the feature's package state
+ * @period_ns: How often the reports of a package are aggregated
+ * @join: Called (with the set's mutex held, may sleep) when the given cpu is
+ *        the first of its package to join, to initialize the feature's state
+ *        of the package. An error aborts the join. May be NULL.
+ * @leave: Called (with the set's mutex held, may sleep) when the given cpu is
+ *         the last of its package to leave. May be NULL.
+ * @mutex: Protects the users, the in_use flags and the allocation
+ * @users: Amount of cpus in the set
+ * @package_count: Amount of package states
+ * @packages: The package states, NULL while the set has no users
+ * @reports: The reports of all cpus, NULL while the set has no users
+ */
+struct memutil_package_set {
+	size_t package_size;
+	u64 period_ns;
+	int (*join)(struct memutil_package *package, unsigned int cpu, void *arg);
+	void (*leave)(struct memutil_package *package, unsigned int cpu);
+	struct mutex mutex;
+	unsigned int users;
+	unsigned int package_count;
+	void *packages;
+	struct memutil_package_report __percpu *reports;
+};
+
+/* Static initializer of a set whose package state has the given type */
+#define MEMUTIL_PACKAGE_SET_INIT(name, type, period, join_fn, leave_fn)	\
+	{								\
+		.package_size = sizeof(type),				\
+		.period_ns = (period),					\
+		.join = (join_fn),					\
+		.leave = (leave_fn),					\
+		.mutex = __MUTEX_INITIALIZER(name.mutex),		\
+	}
+
+/**
+ * memutil_package_join - Let the given cpu take part in the set, allocating
+ *                        the set for its first cpu.
+ *
+ *                        Returns 0 on success, otherwise an error code.
+ *                        This function may sleep.
+ * @set: The set of the feature
+ * @cpu: The cpu that starts using the feature
+ * @arg: Passed to the join callback
+ */
+int memutil_package_join(struct memutil_package_set *set, unsigned int cpu, void *arg);
+/**
+ * memutil_package_leave - Stop the given cpu from taking part in the set,
+ *                         freeing the set after its last cpu. The update hook
+ *                         of the cpu must not run anymore.
+ *
+ *                         This function may sleep.
+ * @set: The set of the feature
+ * @cpu: The cpu that stops using the feature
+ */
+void memutil_package_leave(struct memutil_package_set *set, unsigned int cpu);
+
+/**
+ * memutil_package_own_report - Get the report of the current cpu, which has to
+ *                              take part in the set.
+ */
+static inline struct memutil_package_report *memutil_package_own_report(struct memutil_package_set *set)
+{
+	return this_cpu_ptr(set->reports);
+}
+
+/**
+ * memutil_package_get - Get the state of the given package. The set must have
+ *                       users, and the index must be smaller than its
+ *                       package_count.
+ */
+static inline struct memutil_package *memutil_package_get(struct memutil_package_set *set, unsigned int index)
+{
+	return set->packages + index * set->package_size;
+}
+
+/**
+ * memutil_package_own - Get the package state of the current cpu, which has to
+ *                       take part in the set.
+ */
+static inline struct memutil_package *memutil_package_own(struct memutil_package_set *set)
+{
+	return memutil_package_get(set, memutil_package_own_report(set)->package);
+}
+
+/**
+ * memutil_package_report - Report the values of a busy interval of the current
+ *                          cpu. This function does not sleep.
+ * @set: The set of the feature
+ * @value0: First value
+ * @value1: Second value
+ * @time: Timestamp (nanoseconds) of the update
+ */
+static inline void memutil_package_report(struct memutil_package_set *set, u32 value0, u32 value1, u64 time)
+{
+	struct memutil_package_report *report = memutil_package_own_report(set);
+
+	WRITE_ONCE(report->values[0], value0);
+	WRITE_ONCE(report->values[1], value1);
+	WRITE_ONCE(report->time_ns, time);
+}
+
+/**
+ * memutil_package_try_begin - Check whether the period of the given package is
+ *                             over and no other cpu aggregates it right now.
+ *
+ *                             Returns true with the package's lock held if the
+ *                             current cpu should aggregate the package, end it
+ *                             with memutil_package_end().
+ *                             This function does not sleep.
+ * @set: The set of the feature
+ * @package: The package of the current cpu
+ * @time: Timestamp (nanoseconds) of the update
+ */
+bool memutil_package_try_begin(struct memutil_package_set *set, struct memutil_package *package, u64 time);
+/**
+ * memutil_package_end - Release the package after memutil_package_try_begin()
+ * @package: The package
+ */
+static inline void memutil_package_end(struct memutil_package *package)
+{
+	raw_spin_unlock(&package->lock);
+}
+/**
+ * memutil_package_summarize - Aggregate the reports of the current cpu's
+ *                             package. Has to be called between
+ *                             memutil_package_try_begin() and
+ *                             memutil_package_end().
+ * @set: The set of the feature
+ * @time: Timestamp (nanoseconds) of the update
+ * @summary: Filled with the aggregated reports
+ */
+void memutil_package_summarize(struct memutil_package_set *set, u64 time, struct memutil_package_summary *summary);
+
+#endif //_MEMUTIL_PACKAGE_H
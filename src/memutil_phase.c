@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_phase.c
+ *
+ * Implementation file for the workload phase detection.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/string.h>
+#else
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#include "memutil_phase.h"
+
+/* The centroid moves 1 / 2^CENTROID_SHIFT of the way to every signature of its phase */
+#define CENTROID_SHIFT 3
+/* The cached frequency moves 1 / 2^FREQ_SHIFT of the way to every decision in its phase */
+#define FREQ_SHIFT 2
+/* The dwell time moves 1 / 2^DWELL_SHIFT of the way to every completed run */
+#define DWELL_SHIFT 2
+/* The transitions out of a phase are halved when they reach this amount */
+#define MAX_TRANSITIONS 1024
+
+/* No phase */
+#define NO_PHASE -1
+
+void memutil_phase_init(struct memutil_phase *phase)
+{
+	memset(phase, 0, sizeof(*phase));
+	phase->current = NO_PHASE;
+	phase->candidate = NO_PHASE;
+}
+
+static s32 distance(const struct memutil_phase *phase, int id, s32 stalls, s32 ipc)
+{
+	return abs(phase->stalls[id] - stalls) + abs(phase->ipc[id] - ipc);
+}
+
+/**
+ * classify - Find the phase of a signature, open a new phase for it if none is
+ *            close enough
+ */
+static int classify(struct memutil_phase *phase, s32 stalls, s32 ipc)
+{
+	int id, nearest = NO_PHASE, oldest = NO_PHASE;
+	s32 nearest_distance = MEMUTIL_PHASE_RADIUS + 1;
+
+	for (id = 0; id < phase->count; ++id) {
+		s32 d = distance(phase, id, stalls, ipc);
+
+		if (d < nearest_distance) {
+			nearest = id;
+			nearest_distance = d;
+		}
+		if (id != phase->current && (oldest == NO_PHASE || phase->last_seen[id] < phase->last_seen[oldest])) {
+			oldest = id;
+		}
+	}
+	if (nearest != NO_PHASE) {
+		phase->stalls[nearest] += (stalls - phase->stalls[nearest]) / (1 << CENTROID_SHIFT);
+		phase->ipc[nearest] += (ipc - phase->ipc[nearest]) / (1 << CENTROID_SHIFT);
+		return nearest;
+	}
+
+	if (phase->count < MEMUTIL_PHASE_MAX) {
+		id = phase->count++;
+	} else {
+		//forget the phase that was not seen for the longest time
+		id = oldest;
+		for (nearest = 0; nearest < MEMUTIL_PHASE_MAX; ++nearest) {
+			phase->transitions[nearest][id] = 0;
+		}
+		memset(phase->transitions[id], 0, sizeof(phase->transitions[id]));
+		if (phase->candidate == id) {
+			phase->candidate = NO_PHASE;
+		}
+	}
+	phase->stalls[id] = stalls;
+	phase->ipc[id] = ipc;
+	phase->freq[id] = 0;
+	phase->dwell_x16[id] = 0;
+	return id;
+}
+
+static void record_transition(struct memutil_phase *phase, int from, int to)
+{
+	u16 *row = phase->transitions[from];
+	u32 total = 0;
+	int id;
+
+	for (id = 0; id < MEMUTIL_PHASE_MAX; ++id) {
+		total += row[id];
+	}
+	if (total >= MAX_TRANSITIONS) {
+		//halve the row so that the table follows changing patterns
+		for (id = 0; id < MEMUTIL_PHASE_MAX; ++id) {
+			row[id] /= 2;
+		}
+	}
+	row[to]++;
+
+	if (phase->dwell_x16[from] == 0) {
+		phase->dwell_x16[from] = phase->run * 16;
+	} else {
+		phase->dwell_x16[from] += ((s32)phase->run * 16 - (s32)phase->dwell_x16[from]) / (1 << DWELL_SHIFT);
+	}
+}
+
+/**
+ * predict_next - The phase that most likely follows the current one, NO_PHASE
+ *                if the prediction is not confident enough
+ */
+static int predict_next(const struct memutil_phase *phase)
+{
+	const u16 *row = phase->transitions[phase->current];
+	u32 total = 0;
+	int id, next = NO_PHASE;
+
+	for (id = 0; id < MEMUTIL_PHASE_MAX; ++id) {
+		total += row[id];
+		if (row[id] > 0 && (next == NO_PHASE || row[id] > row[next])) {
+			next = id;
+		}
+	}
+	if (next == NO_PHASE || row[next] < MEMUTIL_PHASE_MIN_TRANSITIONS ||
+	    row[next] * 100 < total * MEMUTIL_PHASE_MIN_CONFIDENCE) {
+		return NO_PHASE;
+	}
+	return next;
+}
+
+/**
+ * switch_ahead - The frequency to request ahead of a predicted transition to a
+ *                faster phase, 0 if no transition is due
+ */
+static unsigned int switch_ahead(const struct memutil_phase *phase)
+{
+	u32 dwell = phase->dwell_x16[phase->current] / 16;
+	int next;
+
+	if (dwell == 0 || phase->run < dwell || phase->run >= dwell + MEMUTIL_PHASE_LOOKAHEAD) {
+		return 0;
+	}
+	next = predict_next(phase);
+	return next == NO_PHASE ? 0 : phase->freq[next];
+}
+
+unsigned int memutil_phase_update(struct memutil_phase *phase, const u64 *values, unsigned int freq)
+{
+	s64 cycles = values[MEMUTIL_VALUE_CYCLES];
+	s32 stalls, ipc;
+	int id;
+
+	if (unlikely(cycles == 0)) {
+		return freq;
+	}
+	stalls = memutil_stall_share(values[MEMUTIL_VALUE_STALLS], cycles);
+	ipc = min_t(s64, memutil_ratio_percent(values[MEMUTIL_VALUE_INSTRUCTIONS], cycles) * 2, 1000);
+	phase->intervals++;
+	id = classify(phase, stalls, ipc);
+	phase->last_seen[id] = phase->intervals;
+
+	if (phase->current == NO_PHASE) {
+		phase->current = id;
+	} else if (id != phase->current) {
+		if (id == phase->candidate) {
+			phase->candidate_run++;
+		} else {
+			phase->candidate = id;
+			phase->candidate_run = 1;
+		}
+		if (phase->candidate_run < MEMUTIL_PHASE_CONFIRM) {
+			//a single outlier does not change the phase
+			phase->run++;
+			return max(freq, switch_ahead(phase));
+		}
+		//the unconfirmed intervals belong to the new phase
+		phase->run -= phase->candidate_run - 1;
+		record_transition(phase, phase->current, id);
+		phase->current = id;
+		phase->run = phase->candidate_run - 1;
+	}
+	phase->candidate = NO_PHASE;
+	phase->candidate_run = 0;
+	phase->run++;
+
+	if (phase->freq[id] == 0) {
+		phase->freq[id] = freq;
+	} else {
+		phase->freq[id] += ((s64)freq - phase->freq[id]) / (1 << FREQ_SHIFT);
+	}
+	return max(freq, switch_ahead(phase));
+}
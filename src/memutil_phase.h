@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_phase.h
+ *
+ * Header file for the workload phase detection. Each policy clusters the
+ * signatures of its intervals (stalls per cycle and IPC) online into a small
+ * set of phases: a signature that is close to the centroid of a known phase
+ * belongs to it and pulls the centroid a bit towards itself, any other
+ * signature opens a new phase (or replaces the phase that was not seen for the
+ * longest time). With the events of the offcore stalls heuristic the IPC is
+ * always 1, unless event_name1 is set to an instructions event, and with the
+ * events of the IPC heuristic the stall share is always 1000, so the phases
+ * are told apart by the ratio of the heuristic only.
+ *
+ * For every phase the detector learns
+ *
+ *   - the frequency the heuristic chooses in it (the decision cache),
+ *   - how many intervals it usually lasts (the dwell time) and
+ *   - which phase usually follows it (the transition table).
+ *
+ * When the current phase reaches its usual dwell time and the next phase is
+ * predicted with enough confidence, the cached frequency of the next phase is
+ * requested ahead of the transition. Only switches up are done ahead, so that
+ * a wrong prediction costs energy but no performance; switches down are
+ * followed by the heuristic within one interval anyway.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_PHASE_H
+#define _MEMUTIL_PHASE_H
+
+#include "memutil_heuristic.h"
+
+/* Maximum amount of phases per policy */
+#define MEMUTIL_PHASE_MAX 8
+/*
+ * Maximum distance of a signature to the centroid of its phase. The distance
+ * is the sum of the differences of the stall share (in permille) and of the
+ * IPC (in percent * 2, i.e. IPC 5 is 1000).
+ */
+#define MEMUTIL_PHASE_RADIUS 150
+/* Consecutive intervals of another phase before the phase changes */
+#define MEMUTIL_PHASE_CONFIRM 2
+/* Transitions out of a phase that are needed before its successor is predicted */
+#define MEMUTIL_PHASE_MIN_TRANSITIONS 4
+/* Share (in percent) of the transitions out of a phase the predicted successor needs */
+#define MEMUTIL_PHASE_MIN_CONFIDENCE 50
+/* Intervals after the usual dwell time in which the frequency is still switched ahead */
+#define MEMUTIL_PHASE_LOOKAHEAD 2
+
+/**
+ * struct memutil_phase - Phase detection state of one policy. Only accessed
+ *                        by the policy's cpu.
+ *
+ * @stalls: Centroid stall share (in permille) of each phase
+ * @ipc: Centroid IPC (in percent * 2) of each phase
+ * @freq: Cached frequency (in KHz) of each phase, 0 if unknown
+ * @dwell_x16: Average amount of intervals (* 16) of each phase, 0 if unknown
+ * @last_seen: Interval in which each phase was seen the last time
+ * @transitions: Amount of transitions from one phase (first index) to another
+ * @count: Amount of phases in use
+ * @current: The current phase, -1 before the first interval
+ * @run: Intervals in the current phase so far
+ * @candidate: Phase that the last intervals belonged to, if it is not the current one
+ * @candidate_run: Consecutive intervals of the candidate
+ * @intervals: Amount of intervals so far
+ */
+struct memutil_phase {
+	s32 stalls[MEMUTIL_PHASE_MAX];
+	s32 ipc[MEMUTIL_PHASE_MAX];
+	u32 freq[MEMUTIL_PHASE_MAX];
+	u32 dwell_x16[MEMUTIL_PHASE_MAX];
+	u64 last_seen[MEMUTIL_PHASE_MAX];
+	u16 transitions[MEMUTIL_PHASE_MAX][MEMUTIL_PHASE_MAX];
+	int count;
+	int current;
+	u32 run;
+	int candidate;
+	u32 candidate_run;
+	u64 intervals;
+};
+
+/**
+ * memutil_phase_init - Initialize the phase detection state
+ * @phase: The state to initialize
+ */
+void memutil_phase_init(struct memutil_phase *phase);
+/**
+ * memutil_phase_update - Assign the interval that just ended to a phase, record
+ *                        the frequency the heuristic chose for the next one and
+ *                        switch ahead if a transition to a faster phase is due.
+ *
+ *                        Returns the frequency to request, i.e. freq or the
+ *                        cached frequency of the predicted next phase.
+ *                        Intervals without cycles keep the current phase.
+ *                        This function does not sleep.
+ * @phase: The state of the policy
+ * @values: Counter values of the interval (see MEMUTIL_VALUE_*)
+ * @freq: Frequency (in KHz) the heuristic chose for the next interval
+ */
+unsigned int memutil_phase_update(struct memutil_phase *phase, const u64 *values, unsigned int freq);
+
+#endif //_MEMUTIL_PHASE_H
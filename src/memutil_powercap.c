@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_powercap.c
+ *
+ * Implementation file for the power cap mode.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+
+#include "memutil_heuristic.h"
+#include "memutil_package.h"
+#include "memutil_powercap.h"
+
+/* The power of a cpu moves 1 / 2^POWER_SHIFT of the way to the power of every interval */
+#define POWER_SHIFT 2
+/* Indices of the values the cpus report */
+#define REPORT_POWER 0 /* Smoothed power (in milliwatts) of the cpu's busy intervals */
+#define REPORT_SENSITIVITY 1 /* Frequency sensitivity (in permille) of the last busy interval */
+
+/**
+ * struct powercap_package - Power cap state of one package
+ *
+ * @base: Generic package state
+ * @throttle: Throttle level (0 - MEMUTIL_POWERCAP_MAX_THROTTLE)
+ */
+struct powercap_package {
+	struct memutil_package base;
+	int throttle;
+};
+
+static int powercap_join(struct memutil_package *base, unsigned int cpu, void *arg)
+{
+	struct powercap_package *package = container_of(base, struct powercap_package, base);
+
+	WRITE_ONCE(package->throttle, 0);
+	return 0;
+}
+
+static struct memutil_package_set powercap_set =
+	MEMUTIL_PACKAGE_SET_INIT(powercap_set, struct powercap_package, MEMUTIL_POWERCAP_PERIOD_NS,
+				 powercap_join, NULL);
+/* Whether the power of the package is the sum of the reports instead of their mean */
+static bool energy_cpu_scope;
+
+int memutil_powercap_init_cpu(unsigned int cpu, bool cpu_scope)
+{
+	WRITE_ONCE(energy_cpu_scope, cpu_scope);
+	return memutil_package_join(&powercap_set, cpu, NULL);
+}
+
+void memutil_powercap_exit_cpu(unsigned int cpu)
+{
+	memutil_package_leave(&powercap_set, cpu);
+}
+
+/**
+ * package_power - Estimate the power (in milliwatts) of the current cpu's
+ *                 package from the reports of its recently busy cpus, 0 if
+ *                 there are none.
+ */
+static u64 package_power(u64 time)
+{
+	struct memutil_package_summary summary;
+
+	memutil_package_summarize(&powercap_set, time, &summary);
+	if (summary.busy == 0) {
+		return 0;
+	}
+	//with package energy every report estimates the power of the whole package
+	return READ_ONCE(energy_cpu_scope) ? summary.sum[REPORT_POWER] : summary.sum[REPORT_POWER] / summary.busy;
+}
+
+/**
+ * adapt_throttle - Move the throttle level of the package towards the budget.
+ *                  Has to be called between memutil_package_try_begin()
+ *                  and memutil_package_end().
+ */
+static void adapt_throttle(struct powercap_package *package, int budget_mw, u64 time)
+{
+	u64 power_mw = package_power(time);
+	s64 error;
+	int throttle = package->throttle;
+
+	if (power_mw == 0) {
+		return;
+	}
+	//relative error in permille, positive if the power exceeds the budget
+	error = ((s64)power_mw - budget_mw) * 1000 / budget_mw;
+	if (error > 0) {
+		throttle += min_t(s64, DIV_ROUND_UP(error, 4), MEMUTIL_POWERCAP_MAX_STEP);
+	} else if (error < -MEMUTIL_POWERCAP_MARGIN) {
+		throttle -= min_t(s64, -error / 4, MEMUTIL_POWERCAP_MAX_STEP);
+	}
+	WRITE_ONCE(package->throttle, clamp(throttle, 0, MEMUTIL_POWERCAP_MAX_THROTTLE));
+}
+
+unsigned int memutil_powercap_update(s64 share, u64 package_nj, u64 interval_ns, unsigned int cur_freq,
+				     int max_freq, int min_freq, int budget_mw, u64 time)
+{
+	const struct memutil_package_report *report = memutil_package_own_report(&powercap_set);
+	struct powercap_package *package =
+		container_of(memutil_package_own(&powercap_set), struct powercap_package, base);
+	u32 power_mw, sensitivity;
+	int reduction;
+
+	if (share >= 0 && interval_ns > 0) {
+		// nJ / ns = W
+		power_mw = min_t(u64, package_nj * 1000 / interval_ns, U32_MAX);
+		if (report->time_ns != 0) {
+			power_mw = report->values[REPORT_POWER] +
+				   ((s64)power_mw - report->values[REPORT_POWER]) / (1 << POWER_SHIFT);
+		}
+		memutil_package_report(&powercap_set, power_mw,
+				       1000 - memutil_stall_share_at_max(share, cur_freq, max_freq), time);
+	}
+	if (budget_mw <= 0) {
+		WRITE_ONCE(package->throttle, 0);
+		return max_freq;
+	}
+	if (memutil_package_try_begin(&powercap_set, &package->base, time)) {
+		adapt_throttle(package, budget_mw, time);
+		memutil_package_end(&package->base);
+	}
+
+	//a cpu that was not busy yet counts as fully sensitive
+	sensitivity = report->time_ns != 0 ? report->values[REPORT_SENSITIVITY] : 1000;
+	reduction = clamp(READ_ONCE(package->throttle) - (int)sensitivity, 0, 1000);
+	return max_freq - (s64)(max_freq - min_freq) * reduction / 1000;
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_powercap.h
+ *
+ * Header file for the power cap mode. RAPL power limits throttle all cores of
+ * a package evenly, no matter how much each of them loses by it. Instead,
+ * memutil keeps the package power within a budget by lowering the frequency of
+ * the memory bound cores first.
+ *
+ * Every cpu reports the power of its intervals (from the energy source) and
+ * its frequency sensitivity, i.e. 1000 - its stall share (in permille, at the
+ * maximum frequency). About every MEMUTIL_POWERCAP_PERIOD_NS one cpu of the
+ * package (see memutil_package.h) estimates the package power from the reports of the recently busy
+ * cpus and moves the throttle level of the package (0 - 2000) up if the power
+ * exceeds the budget, and down if it is more than MEMUTIL_POWERCAP_MARGIN
+ * below it. Each cpu then caps its frequency at
+ *
+ *   max - (max - min) * clamp(throttle - sensitivity, 0, 1000) / 1000
+ *
+ * i.e. a rising throttle level first lowers the cores that barely benefit
+ * from their frequency, and only then the compute bound cores.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_POWERCAP_H
+#define _MEMUTIL_POWERCAP_H
+
+#include <linux/time64.h>
+#include <linux/types.h>
+
+/* How often the throttle level of a package is adapted */
+#define MEMUTIL_POWERCAP_PERIOD_NS (50 * NSEC_PER_MSEC)
+/* Highest throttle level, at which every cpu of the package runs at its minimum frequency */
+#define MEMUTIL_POWERCAP_MAX_THROTTLE 2000
+/* Largest step (in throttle levels) per period */
+#define MEMUTIL_POWERCAP_MAX_STEP 100
+/* Share (in permille) of the budget below which the throttle level is lowered */
+#define MEMUTIL_POWERCAP_MARGIN 30
+
+/**
+ * memutil_powercap_init_cpu - Let the given cpu take part in the power cap of
+ *                             its package.
+ *
+ *                             Returns 0 on success, otherwise an error code.
+ *                             This function may sleep.
+ * @cpu: The cpu that starts using memutil
+ * @cpu_scope: Whether the package energy of the energy source only covers the
+ *             reading cpu (see struct memutil_energy_source)
+ */
+int memutil_powercap_init_cpu(unsigned int cpu, bool cpu_scope);
+/**
+ * memutil_powercap_exit_cpu - Stop the power cap for the given cpu. The update
+ *                             hook of the cpu must not run anymore.
+ *
+ *                             This function may sleep.
+ * @cpu: The cpu that stops using memutil
+ */
+void memutil_powercap_exit_cpu(unsigned int cpu);
+/**
+ * memutil_powercap_update - Report the interval that just ended on the current
+ *                           cpu, adapt the throttle level of its package if
+ *                           the period is over and calculate the frequency cap
+ *                           of the cpu.
+ *
+ *                           Returns the highest frequency (in KHz) the cpu may
+ *                           request, max_freq if it is not throttled.
+ *                           This function does not sleep.
+ * @share: Stall share (in permille) of the interval, negative if the interval
+ *         was idle
+ * @package_nj: Package energy (in nanojoules) of the interval
+ * @interval_ns: Length of the interval, 0 if unknown
+ * @cur_freq: Frequency (in KHz) the interval ran at
+ * @max_freq: Maximum frequency (in KHz) of the cpu
+ * @min_freq: Minimum frequency (in KHz) of the cpu
+ * @budget_mw: The power budget (in milliwatts) of the package, 0 to lift the cap
+ * @time: Timestamp (nanoseconds) of the update
+ */
+unsigned int memutil_powercap_update(s64 share, u64 package_nj, u64 interval_ns, unsigned int cur_freq,
+				     int max_freq, int min_freq, int budget_mw, u64 time);
+
+#endif //_MEMUTIL_POWERCAP_H
@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_probing.c
+ *
+ * Implementation file for the online frequency-sensitivity probing.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/limits.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/prandom.h>
+#include <linux/random.h>
+#include <linux/string.h>
+#include <linux/time64.h>
+
+#include "memutil_probing.h"
+
+/* The estimate moves 1 / 2^ESTIMATE_SHIFT of the way to every new measurement */
+#define ESTIMATE_SHIFT 2
+/* No estimate for the phase yet */
+#define NO_ESTIMATE -1
+
+enum probe_state {
+	/* Counting down to the next probe */
+	PROBE_IDLE,
+	/* The interval that ends with the next update runs at probe_freq */
+	PROBE_RUNNING,
+	/* The interval that ends with the next update runs at base_freq again */
+	PROBE_SETTLING,
+};
+
+/**
+ * struct memutil_probing_cpu - Probing state of one cpu
+ *
+ * @period: Average amount of decisions between two probes
+ * @countdown: Decisions until the next probe
+ * @random: State of the pseudo random generator that jitters the countdown,
+ *          seeded from the kernel's random pool
+ * @state: enum probe_state
+ * @phase: Phase of the current probe
+ * @base_freq: The regular frequency of the current probe (in KHz)
+ * @probe_freq: The dithered frequency of the current probe (in KHz)
+ * @before_ips: Work per millisecond of the interval before the probe
+ * @probe_ips: Work per millisecond of the probe interval
+ * @estimate: Sensitivity (in permille) of each phase, NO_ESTIMATE if unknown
+ * @probes: Amount of completed probes
+ * @aborted: Amount of probes that were aborted, e.g. because the phase changed
+ * @in_use: Whether memutil with probing currently runs on this cpu
+ */
+struct memutil_probing_cpu {
+	unsigned int period;
+	unsigned int countdown;
+	struct rnd_state random;
+	int state;
+	unsigned int phase;
+	unsigned int base_freq;
+	unsigned int probe_freq;
+	u64 before_ips;
+	u64 probe_ips;
+	s32 estimate[MEMUTIL_PROBING_PHASES];
+	u64 probes;
+	u64 aborted;
+	bool in_use;
+};
+
+static DEFINE_PER_CPU(struct memutil_probing_cpu, memutil_probing);
+/* Protects in_use against the statsfile */
+static DEFINE_MUTEX(memutil_probing_mutex);
+
+/**
+ * reset_countdown - Draw the decisions until the next probe uniformly from
+ *                   [period / 2, period * 3 / 2), so that probes do not lock
+ *                   onto periodic workloads.
+ */
+static void reset_countdown(struct memutil_probing_cpu *probing)
+{
+	probing->countdown = probing->period / 2 + prandom_u32_state(&probing->random) % probing->period;
+}
+
+void memutil_probing_init_cpu(struct cpufreq_policy *policy, unsigned int period)
+{
+	struct memutil_probing_cpu *probing = per_cpu_ptr(&memutil_probing, policy->cpu);
+	unsigned int i;
+
+	mutex_lock(&memutil_probing_mutex);
+	memset(probing, 0, sizeof(*probing));
+	for (i = 0; i < MEMUTIL_PROBING_PHASES; ++i) {
+		probing->estimate[i] = NO_ESTIMATE;
+	}
+	probing->period = max_t(unsigned int, period, MEMUTIL_PROBING_MIN_PERIOD);
+	prandom_seed_state(&probing->random, get_random_u64());
+	reset_countdown(probing);
+	probing->in_use = true;
+	mutex_unlock(&memutil_probing_mutex);
+}
+
+void memutil_probing_exit_cpu(unsigned int cpu)
+{
+	mutex_lock(&memutil_probing_mutex);
+	per_cpu_ptr(&memutil_probing, cpu)->in_use = false;
+	mutex_unlock(&memutil_probing_mutex);
+}
+
+static unsigned int ratio_phase(s64 ratio)
+{
+	return min_t(u64, ratio / MEMUTIL_PROBING_PHASE_WIDTH, MEMUTIL_PROBING_PHASES - 1);
+}
+
+/**
+ * neighbour_freq - The next lower OPP of freq within the policy limits, or the
+ *                  next higher one if there is no lower one. Returns 0 if there
+ *                  is neither.
+ */
+static unsigned int neighbour_freq(struct cpufreq_policy *policy, unsigned int freq)
+{
+	struct cpufreq_frequency_table *pos;
+	unsigned int lower = 0, higher = UINT_MAX;
+
+	if (!policy->freq_table) {
+		if (freq >= policy->min + MEMUTIL_PROBING_STEP_KHZ) {
+			return freq - MEMUTIL_PROBING_STEP_KHZ;
+		}
+		return freq + MEMUTIL_PROBING_STEP_KHZ <= policy->max ? freq + MEMUTIL_PROBING_STEP_KHZ : 0;
+	}
+	cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+		if (pos->frequency < policy->min || pos->frequency > policy->max) {
+			continue;
+		}
+		if (pos->frequency < freq) {
+			lower = max(lower, pos->frequency);
+		} else if (pos->frequency > freq) {
+			higher = min(higher, pos->frequency);
+		}
+	}
+	if (lower) {
+		return lower;
+	}
+	return higher != UINT_MAX ? higher : 0;
+}
+
+/**
+ * is_steady - Whether two requested frequencies end up at the same OPP
+ */
+static bool is_steady(struct cpufreq_policy *policy, unsigned int freq_a, unsigned int freq_b)
+{
+	unsigned int resolved_a = cpufreq_driver_resolve_freq(policy, freq_a);
+	unsigned int resolved_b = cpufreq_driver_resolve_freq(policy, freq_b);
+
+	return max(resolved_a, resolved_b) - min(resolved_a, resolved_b) < MEMUTIL_PROBING_STEP_KHZ / 2;
+}
+
+/**
+ * finish_probe - Turn the measurements into a sensitivity sample and merge it
+ *                into the estimate of the phase
+ * @probing: The probing state
+ * @base_ips: Work per millisecond at base_freq
+ */
+static void finish_probe(struct memutil_probing_cpu *probing, u64 base_ips)
+{
+	s64 base_mhz = probing->base_freq / 1000;
+	s64 delta_mhz = (s64)(probing->probe_freq / 1000) - base_mhz;
+	s64 sensitivity;
+	s32 *estimate = &probing->estimate[probing->phase];
+
+	probing->state = PROBE_IDLE;
+	reset_countdown(probing);
+	if (base_ips == 0 || delta_mhz == 0) {
+		probing->aborted++;
+		return;
+	}
+	sensitivity = div64_s64(((s64)probing->probe_ips - (s64)base_ips) * base_mhz * 1000,
+				(s64)base_ips * delta_mhz);
+	sensitivity = clamp(sensitivity, 0LL, 1000LL);
+	if (*estimate == NO_ESTIMATE) {
+		*estimate = sensitivity;
+	} else {
+		*estimate += (s32)(sensitivity - *estimate) / (1 << ESTIMATE_SHIFT);
+	}
+	probing->probes++;
+}
+
+static void abort_probe(struct memutil_probing_cpu *probing)
+{
+	probing->state = PROBE_IDLE;
+	probing->aborted++;
+	reset_countdown(probing);
+}
+
+unsigned int memutil_probing_update(struct cpufreq_policy *policy, s64 ratio, u64 work, u64 interval_ns,
+				    unsigned int last_freq, unsigned int freq, bool may_start)
+{
+	struct memutil_probing_cpu *probing = this_cpu_ptr(&memutil_probing);
+	bool valid = ratio >= 0 && interval_ns > 0;
+	u64 ips = valid ? div64_u64(work * NSEC_PER_MSEC, interval_ns) : 0;
+
+	switch (probing->state) {
+	case PROBE_RUNNING:
+		if (!valid || ratio_phase(ratio) != probing->phase ||
+		    cpufreq_driver_resolve_freq(policy, last_freq) != probing->probe_freq) {
+			abort_probe(probing);
+			return freq;
+		}
+		probing->probe_ips = ips;
+		if (is_steady(policy, freq, probing->base_freq)) {
+			//measure at the base frequency once more to cancel out a drift of the phase
+			probing->state = PROBE_SETTLING;
+		} else {
+			finish_probe(probing, probing->before_ips);
+		}
+		return freq;
+	case PROBE_SETTLING:
+		if (valid && ratio_phase(ratio) == probing->phase) {
+			finish_probe(probing, (probing->before_ips + ips) / 2);
+		} else {
+			finish_probe(probing, probing->before_ips);
+		}
+		return freq;
+	default:
+		break;
+	}
+
+	if (probing->countdown > 0) {
+		probing->countdown--;
+		return freq;
+	}
+	if (!valid || !may_start || !is_steady(policy, last_freq, freq)) {
+		//try again with the next decision
+		return freq;
+	}
+	probing->base_freq = cpufreq_driver_resolve_freq(policy, freq);
+	probing->probe_freq = neighbour_freq(policy, probing->base_freq);
+	if (!probing->probe_freq) {
+		reset_countdown(probing);
+		return freq;
+	}
+	probing->phase = ratio_phase(ratio);
+	probing->before_ips = ips;
+	probing->state = PROBE_RUNNING;
+	return probing->probe_freq;
+}
+
+s64 memutil_probing_stall_share(s64 ratio)
+{
+	s32 estimate;
+
+	if (ratio < 0) {
+		return -1;
+	}
+	estimate = this_cpu_ptr(&memutil_probing)->estimate[ratio_phase(ratio)];
+	return estimate == NO_ESTIMATE ? -1 : 1000 - estimate;
+}
+
+void memutil_probing_show(struct seq_file *seq)
+{
+	struct memutil_probing_cpu *probing;
+	unsigned int cpu, i;
+	s32 estimate;
+
+	mutex_lock(&memutil_probing_mutex);
+	for_each_possible_cpu(cpu) {
+		probing = per_cpu_ptr(&memutil_probing, cpu);
+		if (!probing->in_use) {
+			continue;
+		}
+		for (i = 0; i < MEMUTIL_PROBING_PHASES; ++i) {
+			estimate = READ_ONCE(probing->estimate[i]);
+			if (estimate != NO_ESTIMATE) {
+				seq_printf(seq, "%u,sensitivity,%u,%d\n", cpu, i * MEMUTIL_PROBING_PHASE_WIDTH, estimate);
+			}
+		}
+		seq_printf(seq, "%u,probes,0,%llu\n", cpu, READ_ONCE(probing->probes));
+		seq_printf(seq, "%u,probes_aborted,0,%llu\n", cpu, READ_ONCE(probing->aborted));
+	}
+	mutex_unlock(&memutil_probing_mutex);
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_probing.h
+ *
+ * Header file for the online frequency-sensitivity probing. Every couple of
+ * hundred decisions (randomized around the configured period) a cpu runs one
+ * interval at the neighbouring OPP of the frequency the heuristic chose. The
+ * work per second of that interval is compared to the intervals before and
+ * after it at the regular frequency, which yields the elasticity of the
+ * throughput to the frequency:
+ *
+ *   sensitivity = (d(IPS) / IPS) / (d(freq) / freq)
+ *
+ * i.e. 1000 permille for compute bound code whose throughput scales with the
+ * frequency, 0 for code that does not gain anything from a higher frequency.
+ * The estimate is kept per phase, a phase being a bucket of the heuristic's
+ * ratio (stalls per cycle or IPC), as an exponentially weighted average.
+ *
+ * Unlike the stalls based model of the slowdown budget heuristic, the measured
+ * sensitivity includes effects like prefetching and the uncore frequency. It is
+ * used instead of the stall share by the slowdown budget heuristic once a
+ * phase has an estimate.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_PROBING_H
+#define _MEMUTIL_PROBING_H
+
+#include <linux/cpufreq.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+
+/* Amount and width (ratio in percent) of the phases, the last phase also collects larger ratios */
+#define MEMUTIL_PROBING_PHASES 10
+#define MEMUTIL_PROBING_PHASE_WIDTH 10
+/*
+ * Minimum probe period (in decisions), i.e. at most 1 of 20 intervals runs at
+ * a dithered frequency, and that only one OPP away from the chosen one
+ */
+#define MEMUTIL_PROBING_MIN_PERIOD 20
+/* Step (in KHz) used instead of the neighbouring OPP if the policy has no frequency table */
+#define MEMUTIL_PROBING_STEP_KHZ 100000
+
+/**
+ * memutil_probing_init_cpu - Reset the probing state and estimates of the given
+ *                            policy's cpu and enable probing with the given period.
+ * @policy: The policy
+ * @period: Average amount of decisions between two probes (>= MEMUTIL_PROBING_MIN_PERIOD)
+ */
+void memutil_probing_init_cpu(struct cpufreq_policy *policy, unsigned int period);
+/**
+ * memutil_probing_exit_cpu - Mark the probing state of the given cpu as unused.
+ */
+void memutil_probing_exit_cpu(unsigned int cpu);
+/**
+ * memutil_probing_update - Feed the interval that just ended on the current
+ *                          cpu into the probing and decide whether the next
+ *                          interval is a probe.
+ *
+ *                          Returns the frequency to request, i.e. freq or the
+ *                          neighbouring OPP of it if a probe starts. It has
+ *                          to be requested unchanged, so this is called after
+ *                          all caps and overrides. A probe whose interval did
+ *                          not run at the probe frequency is aborted.
+ *                          This function does not sleep.
+ * @policy: The policy of the current cpu
+ * @ratio: Ratio (in percent) of the interval, negative if it is unknown
+ * @work: Work (instructions or non-stalled cycles) of the interval
+ * @interval_ns: Length of the interval, 0 if it is unknown
+ * @last_freq: Frequency (in KHz) the interval ran at
+ * @freq: Final frequency (in KHz) chosen for the next interval
+ * @may_start: Whether a new probe may start, false if an override (e.g. an
+ *             application hint) fixed the frequency
+ */
+unsigned int memutil_probing_update(struct cpufreq_policy *policy, s64 ratio, u64 work, u64 interval_ns,
+				    unsigned int last_freq, unsigned int freq, bool may_start);
+/**
+ * memutil_probing_stall_share - The share (in permille) of the current cpu's
+ *                               time that does not scale with the frequency
+ *                               (1000 - sensitivity) in the phase of the given
+ *                               ratio, in the unit of memutil_stall_share().
+ *
+ *                               Returns -1 if the phase was not probed yet.
+ * @ratio: The ratio (in percent) of the current interval
+ */
+s64 memutil_probing_stall_share(s64 ratio);
+/**
+ * memutil_probing_show - Print the estimates of all cpus that use memutil as
+ *                        lines of the statsfile (histogram "sensitivity",
+ *                        bucket = lower bound of the phase, value = permille)
+ *                        followed by the amount of completed and aborted probes.
+ */
+void memutil_probing_show(struct seq_file *seq);
+
+#endif //_MEMUTIL_PROBING_H
@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_qlearning.c
+ *
+ * Implementation file for the Q-learning heuristic.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/ctype.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/prandom.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/topology.h>
+
+#include "memutil_qlearning.h"
+#include "memutil_heuristic.h"
+
+/* Learning rate 1 / 2^ALPHA_SHIFT */
+#define ALPHA_SHIFT 3
+/* Discount factor GAMMA_NUMERATOR / 2^GAMMA_SHIFT (0.875) */
+#define GAMMA_NUMERATOR 7
+#define GAMMA_SHIFT 3
+/* Bound of the action values, larger imported values are clamped */
+#define MAX_ACTION_VALUE (MEMUTIL_QL_MAX_REWARD << GAMMA_SHIFT)
+
+#define ACTION_DOWN 0
+#define ACTION_HOLD 1
+#define ACTION_UP 2
+
+/** The action values of one cpu */
+struct memutil_qtable {
+	s32 q[MEMUTIL_QL_STATES][MEMUTIL_QL_ACTIONS];
+};
+
+/**
+ * struct memutil_qlearning_cpu - Q-learning state of one cpu
+ *
+ * @table: The action values, NULL if the cpu does not use the heuristic
+ * @min_freq: Lowest hardware frequency (in KHz), i.e. level 0
+ * @max_freq: Highest hardware frequency (in KHz), i.e. the last level
+ * @last_state: State of the last decision, -1 if there is none
+ * @last_action: Action of the last decision
+ * @random: State of the pseudo random generator for the exploration, seeded
+ *          from the kernel's random pool
+ */
+struct memutil_qlearning_cpu {
+	struct memutil_qtable *table;
+	unsigned int min_freq;
+	unsigned int max_freq;
+	int last_state;
+	int last_action;
+	struct rnd_state random;
+};
+
+static DEFINE_PER_CPU(struct memutil_qlearning_cpu, memutil_qlearning);
+/* Protects the table pointers against export and import */
+static DEFINE_MUTEX(memutil_qlearning_mutex);
+
+int memutil_qlearning_parse_reward(const char *name)
+{
+	if (!name || !*name || strcmp(name, "ipj") == 0) {
+		return MEMUTIL_QL_REWARD_IPJ;
+	}
+	if (strcmp(name, "edp") == 0) {
+		return MEMUTIL_QL_REWARD_EDP;
+	}
+	return -EINVAL;
+}
+
+int memutil_qlearning_init_cpu(struct cpufreq_policy *policy)
+{
+	struct memutil_qlearning_cpu *qlearning = per_cpu_ptr(&memutil_qlearning, policy->cpu);
+	struct memutil_qtable *table;
+
+	table = kzalloc_node(sizeof(*table), GFP_KERNEL, cpu_to_node(policy->cpu));
+	if (!table) {
+		return -ENOMEM;
+	}
+	mutex_lock(&memutil_qlearning_mutex);
+	kfree(qlearning->table);
+	qlearning->table = table;
+	qlearning->min_freq = policy->cpuinfo.min_freq;
+	qlearning->max_freq = max(policy->cpuinfo.max_freq, policy->cpuinfo.min_freq + 1);
+	qlearning->last_state = -1;
+	prandom_seed_state(&qlearning->random, get_random_u64());
+	mutex_unlock(&memutil_qlearning_mutex);
+	return 0;
+}
+
+void memutil_qlearning_exit_cpu(unsigned int cpu)
+{
+	struct memutil_qlearning_cpu *qlearning = per_cpu_ptr(&memutil_qlearning, cpu);
+
+	mutex_lock(&memutil_qlearning_mutex);
+	kfree(qlearning->table);
+	qlearning->table = NULL;
+	mutex_unlock(&memutil_qlearning_mutex);
+}
+
+static unsigned int freq_level(struct memutil_qlearning_cpu *qlearning, unsigned int freq)
+{
+	unsigned int range = qlearning->max_freq - qlearning->min_freq;
+	unsigned int offset = clamp(freq, qlearning->min_freq, qlearning->max_freq) - qlearning->min_freq;
+
+	//round to the nearest level
+	return ((u64)offset * (MEMUTIL_QL_FREQ_LEVELS - 1) + range / 2) / range;
+}
+
+static unsigned int level_freq(struct memutil_qlearning_cpu *qlearning, unsigned int level)
+{
+	return qlearning->min_freq +
+	       (u64)(qlearning->max_freq - qlearning->min_freq) * level / (MEMUTIL_QL_FREQ_LEVELS - 1);
+}
+
+/**
+ * compute_reward - The throughput per energy proxy of the interval
+ * @instructions: Instructions of the interval
+ * @cycles: Cycles of the interval, non-zero
+ * @relative_freq: Frequency of the interval relative to the maximum (permille)
+ * @config: The tunables
+ */
+static s64 compute_reward(s64 instructions, s64 cycles, s64 relative_freq,
+			  const struct memutil_qlearning_config *config)
+{
+	s64 static_power = clamp(config->static_power, 0, 1000);
+	// IPC * relative frequency, i.e. the throughput relative to IPC 1 at max frequency (permille)
+	s64 throughput = instructions * relative_freq / cycles;
+	s64 power = static_power + (1000 - static_power) * relative_freq * relative_freq / 1000 * relative_freq / 1000000;
+	s64 reward;
+
+	power = max(power, 1LL);
+	if (config->reward == MEMUTIL_QL_REWARD_EDP) {
+		reward = throughput * throughput / power;
+	} else {
+		reward = throughput * 1000 / power;
+	}
+	return clamp(reward, 0LL, (s64)MEMUTIL_QL_MAX_REWARD);
+}
+
+static int best_action(const s32 *q)
+{
+	int action = ACTION_HOLD;
+
+	if (q[ACTION_DOWN] > q[action]) {
+		action = ACTION_DOWN;
+	}
+	if (q[ACTION_UP] > q[action]) {
+		action = ACTION_UP;
+	}
+	return action;
+}
+
+unsigned int memutil_qlearning_decide(const u64 *values, int max_freq, int min_freq, unsigned int last_freq,
+				      const struct memutil_qlearning_config *config, s64 *ratio)
+{
+	struct memutil_qlearning_cpu *qlearning = this_cpu_ptr(&memutil_qlearning);
+	struct memutil_qtable *table = qlearning->table;
+	s64 cycles = values[MEMUTIL_VALUE_CYCLES];
+	s64 instructions = values[MEMUTIL_VALUE_INSTRUCTIONS];
+	s64 share, ipc, reward, target;
+	s32 *last_q;
+	unsigned int stall_bucket, ipc_bucket, level, new_level;
+	int state, action;
+
+	if (unlikely(!table || cycles == 0)) {
+		*ratio = -1;
+		qlearning->last_state = -1;
+		return last_freq;
+	}
+	share = memutil_stall_share(values[MEMUTIL_VALUE_STALLS], cycles);
+	*ratio = share / 10;
+	ipc = memutil_ratio_percent(instructions, cycles);
+	stall_bucket = min_t(s64, share * MEMUTIL_QL_STALL_BUCKETS / 1000, MEMUTIL_QL_STALL_BUCKETS - 1);
+	ipc_bucket = min_t(s64, ipc / MEMUTIL_QL_IPC_BUCKET_WIDTH, MEMUTIL_QL_IPC_BUCKETS - 1);
+	level = freq_level(qlearning, last_freq);
+	state = (stall_bucket * MEMUTIL_QL_IPC_BUCKETS + ipc_bucket) * MEMUTIL_QL_FREQ_LEVELS + level;
+
+	if (config->learn && qlearning->last_state >= 0) {
+		reward = compute_reward(instructions, cycles,
+					(s64)last_freq * 1000 / qlearning->max_freq, config);
+		target = reward + (s64)table->q[state][best_action(table->q[state])] * GAMMA_NUMERATOR / (1 << GAMMA_SHIFT);
+		last_q = &table->q[qlearning->last_state][qlearning->last_action];
+		WRITE_ONCE(*last_q, *last_q + (s32)((target - *last_q) / (1 << ALPHA_SHIFT)));
+	}
+
+	if (config->explore > 0 && (int)(prandom_u32_state(&qlearning->random) % 1000) < config->explore) {
+		action = prandom_u32_state(&qlearning->random) % MEMUTIL_QL_ACTIONS;
+	} else {
+		action = best_action(table->q[state]);
+	}
+	new_level = clamp((int)level + action - ACTION_HOLD, 0, MEMUTIL_QL_FREQ_LEVELS - 1);
+	qlearning->last_state = state;
+	qlearning->last_action = action;
+	return clamp((int)level_freq(qlearning, new_level), min_freq, max_freq);
+}
+
+void memutil_qlearning_show(struct seq_file *seq)
+{
+	struct memutil_qtable *table;
+	unsigned int cpu, state;
+	s32 down, hold, up;
+
+	mutex_lock(&memutil_qlearning_mutex);
+	for_each_possible_cpu(cpu) {
+		table = per_cpu_ptr(&memutil_qlearning, cpu)->table;
+		if (!table) {
+			continue;
+		}
+		for (state = 0; state < MEMUTIL_QL_STATES; ++state) {
+			down = READ_ONCE(table->q[state][ACTION_DOWN]);
+			hold = READ_ONCE(table->q[state][ACTION_HOLD]);
+			up = READ_ONCE(table->q[state][ACTION_UP]);
+			if (down || hold || up) {
+				seq_printf(seq, "%u,%u,%d,%d,%d\n", cpu, state, down, hold, up);
+			}
+		}
+	}
+	mutex_unlock(&memutil_qlearning_mutex);
+}
+
+static void import_row(struct memutil_qtable *table, unsigned int state, const s32 *q)
+{
+	int action;
+
+	for (action = 0; action < MEMUTIL_QL_ACTIONS; ++action) {
+		WRITE_ONCE(table->q[state][action], clamp(q[action], -MAX_ACTION_VALUE, MAX_ACTION_VALUE));
+	}
+}
+
+int memutil_qlearning_import(const char *line)
+{
+	struct memutil_qtable *table;
+	unsigned int cpu, state;
+	s32 q[MEMUTIL_QL_ACTIONS];
+	bool all_cpus = false;
+	size_t length;
+	int consumed = -1;
+	int return_value = 0;
+
+	line = skip_spaces(line);
+	length = strlen(line);
+	//e.g. the \r of files with windows line endings
+	while (length > 0 && isspace(line[length - 1])) {
+		length--;
+	}
+	if (length == 0 || *line == '#') {
+		return 0;
+	}
+	if (length == strlen(MEMUTIL_QL_TABLE_HEADER) && !strncmp(line, MEMUTIL_QL_TABLE_HEADER, length)) {
+		return 0;
+	}
+	if (*line == '*') {
+		all_cpus = true;
+		if (sscanf(line, "*,%u,%d,%d,%d%n", &state, &q[0], &q[1], &q[2], &consumed) != 4) {
+			return -EINVAL;
+		}
+	} else if (sscanf(line, "%u,%u,%d,%d,%d%n", &cpu, &state, &q[0], &q[1], &q[2], &consumed) != 5) {
+		return -EINVAL;
+	}
+	if (consumed < 0 || (size_t)consumed != length) {
+		//trailing characters
+		return -EINVAL;
+	}
+	if (state >= MEMUTIL_QL_STATES || (!all_cpus && cpu >= nr_cpu_ids)) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&memutil_qlearning_mutex);
+	if (all_cpus) {
+		for_each_possible_cpu(cpu) {
+			table = per_cpu_ptr(&memutil_qlearning, cpu)->table;
+			if (table) {
+				import_row(table, state, q);
+			}
+		}
+	} else {
+		table = per_cpu_ptr(&memutil_qlearning, cpu)->table;
+		if (table) {
+			import_row(table, state, q);
+		} else {
+			return_value = -ENODEV;
+		}
+	}
+	mutex_unlock(&memutil_qlearning_mutex);
+	return return_value;
+}
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_qlearning.h
+ *
+ * Header file for the Q-learning heuristic (HEURISTIC_QLEARNING). Each cpu
+ * learns a table of action values with tabular Q-learning:
+ *
+ *   state:  stalls per cycle bucket, IPC bucket and frequency level of the
+ *           interval that just ended
+ *   action: one frequency level down, hold or up
+ *   reward: a throughput per energy proxy computed from the counters, either
+ *           work per energy ("ipj") or work^2 per energy ("edp", the inverse of
+ *           the energy-delay product). The power is modelled as a static share
+ *           plus a dynamic share that grows cubically with the frequency.
+ *
+ * Only integer arithmetic is used and the table has a fixed size per cpu. The
+ * tables can be exported and imported through the debugfs qtable file, so that
+ * a policy trained on one node can be used on other nodes.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_QLEARNING_H
+#define _MEMUTIL_QLEARNING_H
+
+#include <linux/cpufreq.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+
+/* Buckets of the stalls per cycle (12.5 percent each) */
+#define MEMUTIL_QL_STALL_BUCKETS 8
+/* Buckets of the IPC (0.5 each, the last one also collects larger IPCs) */
+#define MEMUTIL_QL_IPC_BUCKETS 8
+#define MEMUTIL_QL_IPC_BUCKET_WIDTH 50
+/* Frequency levels, spread evenly over the hardware frequency range */
+#define MEMUTIL_QL_FREQ_LEVELS 16
+#define MEMUTIL_QL_STATES (MEMUTIL_QL_STALL_BUCKETS * MEMUTIL_QL_IPC_BUCKETS * MEMUTIL_QL_FREQ_LEVELS)
+/* Actions: one level down, hold, one level up */
+#define MEMUTIL_QL_ACTIONS 3
+/* Upper bound of a reward, so that the action values cannot overflow */
+#define MEMUTIL_QL_MAX_REWARD (1 << 20)
+
+/* Reward functions */
+#define MEMUTIL_QL_REWARD_IPJ 0
+#define MEMUTIL_QL_REWARD_EDP 1
+
+/**
+ * struct memutil_qlearning_config - Tunables of the Q-learning heuristic, the
+ *                                   module parameters ql_*
+ *
+ * @explore: Probability (in permille) of a random action
+ * @learn: Whether the tables are updated. Disable to use an imported policy
+ *         as it is.
+ * @reward: MEMUTIL_QL_REWARD_IPJ or MEMUTIL_QL_REWARD_EDP
+ * @static_power: Share (in permille) of the power at the maximum frequency
+ *                that does not depend on the frequency
+ */
+struct memutil_qlearning_config {
+	int explore;
+	bool learn;
+	int reward;
+	int static_power;
+};
+
+/**
+ * memutil_qlearning_parse_reward - Returns the reward function for the given
+ *                                  name ("ipj" or "edp"), or -EINVAL. An
+ *                                  empty name selects "ipj".
+ */
+int memutil_qlearning_parse_reward(const char *name);
+/**
+ * memutil_qlearning_init_cpu - Allocate the zeroed table of the given policy's
+ *                              cpu on its node. Returns 0 on success.
+ *
+ *                              This function may sleep.
+ */
+int memutil_qlearning_init_cpu(struct cpufreq_policy *policy);
+/**
+ * memutil_qlearning_exit_cpu - Free the table of the given cpu. The update hook
+ *                              of the cpu must not run anymore.
+ */
+void memutil_qlearning_exit_cpu(unsigned int cpu);
+/**
+ * memutil_qlearning_decide - Learn from the interval that just ended on the
+ *                            current cpu and choose the next frequency.
+ *
+ *                            Returns last_freq if the cpu has no table or no
+ *                            cycles were counted. This function does not sleep.
+ * @values: Counter values of the interval (see MEMUTIL_VALUE_*)
+ * @max_freq: Maximum choosable frequency (in KHz)
+ * @min_freq: Minimum choosable frequency (in KHz)
+ * @last_freq: Frequency (in KHz) the interval ran at
+ * @config: The tunables
+ * @ratio: Set to the stalls per cycle (in percent), -1 if no cycles were counted
+ */
+unsigned int memutil_qlearning_decide(const u64 *values, int max_freq, int min_freq, unsigned int last_freq,
+				      const struct memutil_qlearning_config *config, s64 *ratio);
+/* Header line of the export format */
+#define MEMUTIL_QL_TABLE_HEADER "cpu,state,down,hold,up"
+
+/**
+ * memutil_qlearning_show - Export the non-zero rows of all tables in the format
+ *                          cpu,state,down,hold,up (see memutil_qlearning_import())
+ */
+void memutil_qlearning_show(struct seq_file *seq);
+/**
+ * memutil_qlearning_import - Import one line in the export format. The cpu may
+ *                            be * to set the row of all cpus that have a table.
+ *                            Empty lines, comments (#) and the header
+ *                            (MEMUTIL_QL_TABLE_HEADER) are ignored, any other
+ *                            line that is not a complete row is rejected.
+ *
+ *                            Returns 0 on success, otherwise an error code.
+ *                            This function may sleep.
+ */
+int memutil_qlearning_import(const char *line);
+
+#endif //_MEMUTIL_QLEARNING_H
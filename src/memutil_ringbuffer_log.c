@@ -15,62 +15,47 @@
 #include <linux/mm.h> //kvmalloc
 
 #include "memutil_ringbuffer_log.h"
-#include "memutil_debugfs_logfile.h"
 #include "memutil_printk_helper.h"
 
-/**
- * memutil_output_element - Format the given log entry as string and append that
- *                          string to the debugfs logfile
- * @element: log element that should be written
- */
-static void memutil_output_element(struct memutil_log_entry *element)
+size_t memutil_format_log_entries(struct memutil_log_entry *entries, u32 count, char *text, size_t text_size)
 {
-	char text[130];
-	size_t bytes_written;
-
-	bytes_written = scnprintf(text, sizeof(text), "%u,%llu,%llu,%llu,%llu,%u\n", element->cpu,
-		  element->timestamp,
-		  element->perf_value1,
-		  element->perf_value2,
-		  element->perf_value3,
-		  element->requested_freq);
-	memutil_debugfs_append_to_logfile(text, bytes_written);
-}
-
-/**
- * memutil_output_data - Format the content of the given ringbuffer as string and
- *                       append it to the debugfs logfile
- * @buffer: Ringbuffer whose content should be written
- */
-static void memutil_output_data(struct memutil_ringbuffer *buffer)
-{
-	int i, read_offset, valid_size;
-	if (buffer->had_wraparound) {
-		pr_warn_ratelimited("Memutil: Ringbuffer had wraparound! Loss of data!");
-	}
-	read_offset = buffer->had_wraparound ? buffer->insert_offset : 0;
-	valid_size = buffer->had_wraparound ? buffer->size : buffer->insert_offset;
+	size_t bytes_written = 0;
+	u32 i;
 
-	for (i = 0; i < valid_size; ++i) {
-		memutil_output_element(&buffer->data[read_offset]);
-		read_offset = (read_offset + 1) % buffer->size;
+	for (i = 0; i < count && text_size - bytes_written >= MEMUTIL_LOG_ENTRY_TEXT_SIZE; ++i) {
+		bytes_written += scnprintf(text + bytes_written, MEMUTIL_LOG_ENTRY_TEXT_SIZE,
+					   "%u,%llu,%llu,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", entries[i].cpu,
+					   entries[i].timestamp,
+					   entries[i].perf_value1,
+					   entries[i].perf_value2,
+					   entries[i].perf_value3,
+					   entries[i].requested_freq,
+					   entries[i].package_energy_uj,
+					   entries[i].core_energy_uj,
+					   entries[i].predicted_slowdown,
+					   entries[i].phase,
+					   entries[i].uncore_ratio,
+					   entries[i].idle_share,
+					   entries[i].boundness,
+					   entries[i].sequence);
 	}
+	return bytes_written;
 }
 
-struct memutil_ringbuffer *memutil_open_ringbuffer(u32 buffer_size)
+struct memutil_ringbuffer *memutil_open_ringbuffer(u32 buffer_size, int node)
 {
 	struct memutil_ringbuffer* buffer;
 	void* data;
 	size_t alloc_size = sizeof(struct memutil_ringbuffer);
 	
 	debug_info("Memutil: Initializing ringbuffer");
-	buffer = (struct memutil_ringbuffer *) kmalloc(alloc_size, GFP_KERNEL);
+	buffer = (struct memutil_ringbuffer *) kmalloc_node(alloc_size, GFP_KERNEL, node);
 	if (!buffer) {
 		pr_warn("Memutil: Failed to allocate buffer of size: %zu", alloc_size);
 		return NULL;
 	}
 	alloc_size = sizeof(struct memutil_log_entry) * buffer_size;
-	data = kvmalloc(alloc_size, GFP_KERNEL);
+	data = kvmalloc_node(alloc_size, GFP_KERNEL, node);
 	if (!data) {
 		pr_warn("Memutil: Failed to allocate data-buffer of size: %zu", alloc_size);
 		kfree(buffer);
@@ -81,6 +66,7 @@ struct memutil_ringbuffer *memutil_open_ringbuffer(u32 buffer_size)
 	buffer->size = buffer_size;
 	buffer->insert_offset = 0;
 	buffer->had_wraparound = 0;
+	buffer->next_sequence = 0;
 
 	debug_info("Memutil: Ringbuffer ready");
 	return buffer;
@@ -112,43 +98,37 @@ void memutil_write_ringbuffer(struct memutil_ringbuffer *buffer, struct memutil_
 	}
 	for (i = 0; i < count; ++i) {
 		buffer->data[buffer->insert_offset] = data[i];
+		buffer->data[buffer->insert_offset].sequence = buffer->next_sequence++;
 		buffer->insert_offset = (buffer->insert_offset + 1) % buffer->size;
 	}
 	raw_spin_unlock(&buffer->lock);
 }
 
-int memutil_ringbuffer_append_to_logfile(struct memutil_ringbuffer *buffer)
+u32 memutil_ringbuffer_take(struct memutil_ringbuffer *buffer, struct memutil_log_entry *entries, u32 max_count)
 {
-	struct memutil_ringbuffer buffer_copy;
-	size_t alloc_size;
+	u32 i, read_offset, valid_size, count;
 	unsigned long irqflags;
 
-	raw_spin_lock_init(&buffer_copy.lock);
-	alloc_size = sizeof(struct memutil_log_entry) * buffer->size;
-	buffer_copy.data = kvmalloc(alloc_size, GFP_KERNEL);
-	if (!buffer_copy.data) {
-		pr_warn("Memutil: Failed to allocate memory for ringbuffer copy");
-		return -ENOMEM;
-	}
-	buffer_copy.size = buffer->size;
-
 	//We not only have to acquire the lock but also need to disable interrupts.
 	//Otherwise an interrupt could cause the update_frequency code of memutil
 	//to run while we hold the lock. As the update_frequency code is run
 	//in a context that is not interruptable, it would deadlock trying to acquire
 	//the lock we hold while we do not get the possibility to release the lock.
 	raw_spin_lock_irqsave(&buffer->lock, irqflags);
-	memcpy(
-		buffer_copy.data,
-		buffer->data,
-		buffer->had_wraparound ? alloc_size : (buffer->insert_offset*sizeof(struct memutil_log_entry))
-	);
-	buffer_copy.had_wraparound = buffer->had_wraparound;
-	buffer_copy.insert_offset = buffer->insert_offset;
+	if (buffer->had_wraparound) {
+		pr_warn_ratelimited("Memutil: Ringbuffer had wraparound! Loss of data!");
+	}
+	read_offset = buffer->had_wraparound ? buffer->insert_offset : 0;
+	valid_size = buffer->had_wraparound ? buffer->size : buffer->insert_offset;
+	count = min(valid_size, max_count);
+	//skip the oldest entries if they do not fit
+	read_offset = (read_offset + (valid_size - count)) % buffer->size;
+
+	for (i = 0; i < count; ++i) {
+		entries[i] = buffer->data[read_offset];
+		read_offset = (read_offset + 1) % buffer->size;
+	}
 	clear_buffer(buffer);
 	raw_spin_unlock_irqrestore(&buffer->lock, irqflags);
-
-	memutil_output_data(&buffer_copy);
-	kvfree(buffer_copy.data);
-	return 0;
+	return count;
 }
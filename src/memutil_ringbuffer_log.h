@@ -26,6 +26,23 @@
  * @perf_value3: Third perf event value
  * @requested_freq: Frequency that was set / requested by memutil
  * @cpu: The cpu to which the perf values / frequency apply
+ * @package_energy_uj: Package energy (in microjoules) since the last entry, 0
+ *                     without an energy source
+ * @core_energy_uj: Core energy (in microjoules) since the last entry, 0 without
+ *                  an energy source
+ * @predicted_slowdown: Performance loss (in permille) the slowdown budget
+ *                      heuristic predicted for requested_freq, 0 without it
+ * @phase: Workload phase (1-based) of the interval that ended with this entry,
+ *         0 without phase detection
+ * @uncore_ratio: Uncore max ratio (in 100 MHz) of the cpu's package after this
+ *                entry, 0 without uncore coordination
+ * @idle_share: Idle share (in permille) that is injected after this entry, 0
+ *              without idle injection
+ * @boundness: Memory boundness (in permille) the cpu publishes after this
+ *             entry, 0 with the IPC heuristic
+ * @sequence: Number of the entry in its ringbuffer, set when it is written.
+ *            Consecutive entries of a cpu differ by one unless entries were
+ *            overwritten before they were read. Always the last column.
  */
 struct memutil_log_entry {
 	u64 timestamp;
@@ -34,8 +51,45 @@ struct memutil_log_entry {
 	u64 perf_value3;
 	unsigned int requested_freq;
 	unsigned int cpu;
+	u32 package_energy_uj;
+	u32 core_energy_uj;
+	u16 predicted_slowdown;
+	u16 idle_share;
+	u16 boundness;
+	u32 sequence;
+	u8 phase;
+	u8 uncore_ratio;
 };
 
+/**
+ * memutil_init_log_entry - Fill the columns every log entry has and clear the
+ *                          optional ones, which the features that produce them
+ *                          set afterwards. Shared with the self-benchmark, so
+ *                          that it builds its entries like the governor does.
+ * @entry: The entry to fill
+ * @time: Timestamp (nanosecond resolution) of the entry
+ * @values: The three perf counter values of the interval
+ * @cpu: The cpu the entry belongs to
+ * @requested_freq: The frequency (in KHz) that was requested
+ */
+static inline void memutil_init_log_entry(struct memutil_log_entry *entry, u64 time, const u64 *values,
+					  unsigned int cpu, unsigned int requested_freq)
+{
+	*entry = (struct memutil_log_entry) {
+		.timestamp = time,
+		.perf_value1 = values[0],
+		.perf_value2 = values[1],
+		.perf_value3 = values[2],
+		.requested_freq = requested_freq,
+		.cpu = cpu,
+	};
+}
+
+/*
+ * Maximum size (in bytes) of one log entry when it is formatted as text.
+ */
+#define MEMUTIL_LOG_ENTRY_TEXT_SIZE 176
+
 /**
  * struct memutil_ringbuffer - Structure that defines a memutil ringbuffer.
  *                             This ringbuffer is used to log data with every
@@ -54,6 +108,7 @@ struct memutil_log_entry {
  *                 elements to override the oldest ones
  * @had_wraparound: Tracks whether this buffer had at least one wraparound (i.e.
  *                  the insert offset reached the end and was reset to the start)
+ * @next_sequence: Sequence number of the next written entry (wraps around)
  */
 struct memutil_ringbuffer {
 	raw_spinlock_t lock;
@@ -61,6 +116,7 @@ struct memutil_ringbuffer {
 	u32 size;
 	u32 insert_offset;
 	bool had_wraparound;
+	u32 next_sequence;
 };
 
 /**
@@ -71,8 +127,10 @@ struct memutil_ringbuffer {
  * @buffer_size: The size of the buffer in elements. This should be small
  *               (not more than (4MB / sizeof(struct memutil_ringbuffer)). The
  *               buffer is intended to be fast and small.
+ * @node: The NUMA node on which the buffer should be allocated, i.e. the node
+ *        of the cpu that writes into it (or NUMA_NO_NODE)
  */
-struct memutil_ringbuffer *memutil_open_ringbuffer(u32 buffer_size);
+struct memutil_ringbuffer *memutil_open_ringbuffer(u32 buffer_size, int node);
 /**
  * memutil_close_ringbuffer - Close a previously opened ringbuffer
  *
@@ -82,6 +140,8 @@ struct memutil_ringbuffer *memutil_open_ringbuffer(u32 buffer_size);
 void memutil_close_ringbuffer(struct memutil_ringbuffer *buffer);
 /**
  * memutil_write_ringbuffer - Write the given log entries into the given ringbuffer.
+ *                            The buffer assigns the sequence numbers of the
+ *                            written copies, data itself is not changed.
  *
  *                            Note: This function does not sleep.
  * @buffer: The buffer into which the data should be logged
@@ -90,16 +150,30 @@ void memutil_close_ringbuffer(struct memutil_ringbuffer *buffer);
  */
 void memutil_write_ringbuffer(struct memutil_ringbuffer *buffer, struct memutil_log_entry *data, u32 count);
 /**
- * memutil_ringbuffer_append_to_logfile - Append the data of the given ringbuffer to
- *                                        the debugfs logfile and clear the ringbuffer.
+ * memutil_ringbuffer_take - Copy the content of the given ringbuffer (oldest entry
+ *                           first) into the given array and clear the ringbuffer.
  *
- *                                        NOTE again that this also clears the ringbuffer.
- *                                        This function may sleep.
+ *                           If the array is smaller than the buffer, only the
+ *                           newest entries are copied.
+ *                           Returns the amount of entries that were copied.
+ *                           This function does not sleep.
+ * @buffer: The ringbuffer whose content should be taken
+ * @entries: Array into which the entries are copied
+ * @max_count: Size of the entries array
+ */
+u32 memutil_ringbuffer_take(struct memutil_ringbuffer *buffer, struct memutil_log_entry *entries, u32 max_count);
+/**
+ * memutil_format_log_entries - Format the given log entries as text, one line
+ *                              per entry.
  *
- *                                        This returns 0 on success, otherwise an error
- *                                        code.
- * @buffer: The ringbuffer whose content should be appended
+ *                              Returns the amount of bytes written (without
+ *                              a nullbyte).
+ * @entries: Entries to format
+ * @count: Amount of entries
+ * @text: Buffer to write the text into. At least count * MEMUTIL_LOG_ENTRY_TEXT_SIZE
+ *        bytes are needed to fit all entries.
+ * @text_size: Size of the text buffer
  */
-int memutil_ringbuffer_append_to_logfile(struct memutil_ringbuffer *buffer);
+size_t memutil_format_log_entries(struct memutil_log_entry *entries, u32 count, char *text, size_t text_size);
 
 #endif //_MEMUTIL_RINGBUFFER_LOG_H
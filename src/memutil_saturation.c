@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_saturation.c
+ *
+ * Implementation file for the package-level memory bandwidth saturation detector.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/kernel.h>
+
+#include "memutil_heuristic.h"
+#include "memutil_package.h"
+#include "memutil_saturation.h"
+
+/**
+ * struct saturation_package - Detection state of one package
+ *
+ * The cpus report the stall share (in permille, at the maximum frequency) of
+ * their last busy interval as their first value and the excess of the measured
+ * over the modelled stall share (in permille) as their second value.
+ *
+ * @base: Generic package state
+ * @share: Mean stall share (in permille, at the maximum frequency) of the
+ *         package if it is saturated, otherwise -1
+ */
+struct saturation_package {
+	struct memutil_package base;
+	s64 share;
+};
+
+static int saturation_join(struct memutil_package *base, unsigned int cpu, void *arg)
+{
+	struct saturation_package *package = container_of(base, struct saturation_package, base);
+
+	WRITE_ONCE(package->share, -1);
+	return 0;
+}
+
+static struct memutil_package_set saturation_set =
+	MEMUTIL_PACKAGE_SET_INIT(saturation_set, struct saturation_package, MEMUTIL_SATURATION_PERIOD_NS,
+				 saturation_join, NULL);
+
+int memutil_saturation_init_cpu(unsigned int cpu)
+{
+	return memutil_package_join(&saturation_set, cpu, NULL);
+}
+
+void memutil_saturation_exit_cpu(unsigned int cpu)
+{
+	memutil_package_leave(&saturation_set, cpu);
+}
+
+/**
+ * evaluate - Aggregate the reports of the package's cpus. Has to be called
+ *            between memutil_package_try_begin() and memutil_package_end().
+ */
+static void evaluate(struct saturation_package *package, u64 time)
+{
+	struct memutil_package_summary summary;
+	s64 mean;
+
+	memutil_package_summarize(&saturation_set, time, &summary);
+	//a few memory bound cpus next to idle ones do not saturate the bandwidth
+	if (summary.busy == 0 || summary.busy * 2 < summary.users) {
+		WRITE_ONCE(package->share, -1);
+		return;
+	}
+	//latency bound stalls slow the cores down as modelled, only queueing ones do not
+	if (summary.sum[1] / summary.busy < MEMUTIL_SATURATION_MIN_EXCESS) {
+		WRITE_ONCE(package->share, -1);
+		return;
+	}
+	mean = summary.sum[0] / summary.busy;
+	if (mean >= MEMUTIL_SATURATION_ENTER_SHARE ||
+	    (package->share >= 0 && mean >= MEMUTIL_SATURATION_EXIT_SHARE)) {
+		WRITE_ONCE(package->share, mean);
+	} else {
+		WRITE_ONCE(package->share, -1);
+	}
+}
+
+s64 memutil_saturation_update(s64 share, s64 measured_share, unsigned int cur_freq, int max_freq, u64 time)
+{
+	struct saturation_package *package =
+		container_of(memutil_package_own(&saturation_set), struct saturation_package, base);
+	u32 excess;
+
+	if (share >= 0) {
+		excess = measured_share > share ? measured_share - share : 0;
+		memutil_package_report(&saturation_set, memutil_stall_share_at_max(share, cur_freq, max_freq), excess,
+				       time);
+	}
+	if (memutil_package_try_begin(&saturation_set, &package->base, time)) {
+		evaluate(package, time);
+		memutil_package_end(&package->base);
+	}
+	return READ_ONCE(package->share);
+}
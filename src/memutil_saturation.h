@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_saturation.h
+ *
+ * Header file for the package-level memory bandwidth saturation detector.
+ * When one package saturates its DRAM bandwidth, all of its cores stall, and
+ * each per-cpu decision only sees its own share of the stalls. Every cpu
+ * reports the stall share of its intervals, normalized to its maximum
+ * frequency so that the reports do not depend on the frequencies the cpus
+ * currently run at (and the cap below does not switch itself off). About every
+ * MEMUTIL_SATURATION_PERIOD_NS one cpu of the package aggregates the reports of
+ * the cpus that use memutil (see memutil_package.h): the package is saturated
+ * when at least half of them were busy recently, their mean share reaches
+ * MEMUTIL_SATURATION_ENTER_SHARE and their throughput is measurably less
+ * frequency sensitive than the stall model predicts. It stays saturated until
+ * the mean share drops below MEMUTIL_SATURATION_EXIT_SHARE or the excess
+ * vanishes.
+ *
+ * A high stall share alone does not tell saturated bandwidth from latency
+ * bound code (e.g. pointer chasing), for which the stall model is accurate and
+ * the cap would cost its full budget. With saturated bandwidth however, a
+ * slower core mostly waits less in the memory queues, so the share of the
+ * time that does not scale with the frequency, as measured by the probing
+ * (see memutil_probing.h), exceeds the stall share. Each cpu reports that
+ * excess of its phase, 0 while the phase was not probed, so the detection
+ * needs the probing.
+ *
+ * While the package is saturated, every cpu of it caps its frequency at the
+ * lowest frequency that stays within MEMUTIL_SATURATION_BUDGET according to the
+ * stall model of the slowdown budget heuristic with the package's mean share.
+ * Above that frequency, the cores only wait faster for the memory.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_SATURATION_H
+#define _MEMUTIL_SATURATION_H
+
+#include <linux/time64.h>
+#include <linux/types.h>
+
+/* How often the saturation of a package is reevaluated */
+#define MEMUTIL_SATURATION_PERIOD_NS (20 * NSEC_PER_MSEC)
+/* Mean stall share (in permille, at the maximum frequency) at which a package becomes saturated */
+#define MEMUTIL_SATURATION_ENTER_SHARE 600
+/* Mean stall share (in permille, at the maximum frequency) below which a package is no longer saturated */
+#define MEMUTIL_SATURATION_EXIT_SHARE 500
+/* Mean excess (in permille) of the measured over the modelled stall share a saturated package needs */
+#define MEMUTIL_SATURATION_MIN_EXCESS 150
+/*
+ * Slowdown (in permille) the cap may cost according to the stall model. It is
+ * larger than a typical slowdown budget, as the model assumes a fixed memory
+ * latency, while with saturated bandwidth a slower core mostly waits less in
+ * the memory queues.
+ */
+#define MEMUTIL_SATURATION_BUDGET 100
+
+/**
+ * memutil_saturation_init_cpu - Let the given cpu take part in the saturation
+ *                               detection of its package.
+ *
+ *                               Returns 0 on success, otherwise an error code.
+ *                               This function may sleep.
+ * @cpu: The cpu that starts using memutil
+ */
+int memutil_saturation_init_cpu(unsigned int cpu);
+/**
+ * memutil_saturation_exit_cpu - Stop the saturation detection for the given
+ *                               cpu. The update hook of the cpu must not run
+ *                               anymore.
+ *
+ *                               This function may sleep.
+ * @cpu: The cpu that stops using memutil
+ */
+void memutil_saturation_exit_cpu(unsigned int cpu);
+/**
+ * memutil_saturation_update - Report the stall share of the interval that just
+ *                             ended on the current cpu and reevaluate the
+ *                             saturation of its package if the period is over.
+ *
+ *                             Returns the mean stall share (in permille, at the
+ *                             maximum frequency) of the package if it is
+ *                             saturated, otherwise -1.
+ *                             This function does not sleep.
+ * @share: Stall share (in permille) of the interval, negative if the interval
+ *         was idle
+ * @measured_share: Share (in permille) of the time that does not scale with
+ *                  the frequency as measured by the probing for the phase of
+ *                  the interval, negative if the phase was not probed yet
+ * @cur_freq: Frequency (in KHz) the interval ran at
+ * @max_freq: Maximum frequency (in KHz) of the cpu
+ * @time: Timestamp (nanoseconds) of the update
+ */
+s64 memutil_saturation_update(s64 share, s64 measured_share, unsigned int cur_freq, int max_freq, u64 time);
+
+#endif //_MEMUTIL_SATURATION_H
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_stats.c
+ *
+ * Implementation file for the always-on memutil statistics.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/bitops.h>
+#include <linux/cpumask.h>
+#include <linux/minmax.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+
+#include "memutil_stats.h"
+
+/**
+ * struct memutil_stats_cpu - Statistics data of one cpu
+ *
+ * @counters: The counters, only written by the owning cpu
+ * @baseline: Snapshot of the counters taken at the last reset. Shown values
+ *            are always counters - baseline.
+ * @opp_freq: Frequencies (in KHz, ascending) of the tracked OPPs
+ * @opp_count: Amount of valid entries in opp_freq
+ * @base_freq: Highest frequency (in KHz) below the turbo range, 0 if unknown
+ * @in_use: Whether memutil currently runs on this cpu
+ */
+struct memutil_stats_cpu {
+	struct memutil_histograms counters;
+	struct memutil_histograms baseline;
+	unsigned int opp_freq[MEMUTIL_STATS_MAX_OPPS];
+	unsigned int opp_count;
+	unsigned int base_freq;
+	bool in_use;
+};
+
+static DEFINE_PER_CPU(struct memutil_stats_cpu, memutil_stats);
+/* Serializes resets against each other and against readers of the baseline */
+static DEFINE_MUTEX(memutil_stats_mutex);
+
+#define HISTOGRAM_U64_COUNT (sizeof(struct memutil_histograms) / sizeof(u64))
+
+static int compare_freq(const void *a, const void *b)
+{
+	unsigned int freq_a = *(const unsigned int *)a;
+	unsigned int freq_b = *(const unsigned int *)b;
+
+	return (freq_a > freq_b) - (freq_a < freq_b);
+}
+
+/**
+ * init_opps_from_table - Fill the OPPs of the given stats from the frequency
+ *                        table of the given policy.
+ *
+ *                        Returns false if the policy has no frequency table or
+ *                        the table has too many entries.
+ * @stats: The stats whose OPPs should be initialized
+ * @policy: The policy whose frequency table is used
+ */
+static bool init_opps_from_table(struct memutil_stats_cpu *stats, struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *pos;
+	unsigned int count = 0;
+
+	if (!policy->freq_table) {
+		return false;
+	}
+	cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+		if (count >= MEMUTIL_STATS_MAX_OPPS) {
+			return false;
+		}
+		stats->opp_freq[count++] = pos->frequency;
+	}
+	if (count == 0) {
+		return false;
+	}
+	sort(stats->opp_freq, count, sizeof(stats->opp_freq[0]), compare_freq, NULL);
+	stats->opp_count = count;
+	return true;
+}
+
+/**
+ * init_opps_linear - Split the hardware frequency range of the given policy into
+ *                    equally sized buckets that are used instead of OPPs.
+ * @stats: The stats whose OPPs should be initialized
+ * @policy: The policy whose frequency range is used
+ */
+static void init_opps_linear(struct memutil_stats_cpu *stats, struct cpufreq_policy *policy)
+{
+	unsigned int min_freq = policy->cpuinfo.min_freq;
+	unsigned int max_freq = max(policy->cpuinfo.max_freq, min_freq);
+	unsigned int i;
+
+	for (i = 0; i < MEMUTIL_STATS_MAX_OPPS; ++i) {
+		stats->opp_freq[i] = min_freq + (u64)(max_freq - min_freq) * i / (MEMUTIL_STATS_MAX_OPPS - 1);
+	}
+	stats->opp_count = MEMUTIL_STATS_MAX_OPPS;
+}
+
+void memutil_stats_init_cpu(struct cpufreq_policy *policy, unsigned int base_freq)
+{
+	struct memutil_stats_cpu *stats = per_cpu_ptr(&memutil_stats, policy->cpu);
+
+	mutex_lock(&memutil_stats_mutex);
+	memset(stats, 0, sizeof(*stats));
+	if (!init_opps_from_table(stats, policy)) {
+		init_opps_linear(stats, policy);
+	}
+	stats->base_freq = base_freq;
+	stats->in_use = true;
+	mutex_unlock(&memutil_stats_mutex);
+}
+
+void memutil_stats_exit_cpu(unsigned int cpu)
+{
+	mutex_lock(&memutil_stats_mutex);
+	per_cpu_ptr(&memutil_stats, cpu)->in_use = false;
+	mutex_unlock(&memutil_stats_mutex);
+}
+
+/**
+ * opp_index - Get the index of the OPP that is used for the given frequency,
+ *             i.e. the lowest OPP at or above the frequency (like
+ *             CPUFREQ_RELATION_L).
+ * @stats: Stats containing the OPPs
+ * @freq: The frequency (in KHz)
+ */
+static unsigned int opp_index(struct memutil_stats_cpu *stats, unsigned int freq)
+{
+	unsigned int i;
+
+	for (i = 0; i + 1 < stats->opp_count; ++i) {
+		if (stats->opp_freq[i] >= freq) {
+			break;
+		}
+	}
+	return i;
+}
+
+void memutil_stats_record(s64 ratio, unsigned int prev_freq, u64 prev_freq_time_ns, u64 latency_ns)
+{
+	struct memutil_stats_cpu *stats = this_cpu_ptr(&memutil_stats);
+	unsigned int ratio_bucket;
+	unsigned int latency_bucket;
+
+	latency_bucket = min_t(unsigned int, latency_ns ? fls64(latency_ns) - 1 : 0,
+			       MEMUTIL_STATS_LATENCY_BUCKETS - 1);
+
+	__this_cpu_inc(memutil_stats.counters.decisions);
+	__this_cpu_inc(memutil_stats.counters.latency[latency_bucket]);
+	if (ratio >= 0) {
+		ratio_bucket = min_t(u64, ratio / MEMUTIL_STATS_RATIO_BUCKET_WIDTH,
+				     MEMUTIL_STATS_RATIO_BUCKETS - 1);
+		__this_cpu_inc(memutil_stats.counters.ratio[ratio_bucket]);
+	}
+	if (prev_freq_time_ns) {
+		__this_cpu_add(memutil_stats.counters.opp_time_ns[opp_index(stats, prev_freq)], prev_freq_time_ns);
+		if (stats->base_freq && prev_freq > stats->base_freq) {
+			__this_cpu_add(memutil_stats.counters.turbo_time_ns, prev_freq_time_ns);
+		}
+	}
+}
+
+void memutil_stats_record_idle_hint(int hint, u64 time_ns)
+{
+	if (hint >= 0 && hint < MEMUTIL_STATS_IDLE_HINTS) {
+		__this_cpu_add(memutil_stats.counters.idle_hint_time_ns[hint], time_ns);
+	}
+}
+
+void memutil_stats_reset(void)
+{
+	unsigned int cpu, i;
+
+	mutex_lock(&memutil_stats_mutex);
+	for_each_possible_cpu(cpu) {
+		struct memutil_stats_cpu *stats = per_cpu_ptr(&memutil_stats, cpu);
+		u64 *counters = (u64 *)&stats->counters;
+		u64 *baseline = (u64 *)&stats->baseline;
+
+		for (i = 0; i < HISTOGRAM_U64_COUNT; ++i) {
+			baseline[i] = READ_ONCE(counters[i]);
+		}
+	}
+	mutex_unlock(&memutil_stats_mutex);
+}
+
+/**
+ * show_histogram - Print the non-empty buckets of one histogram
+ * @seq: The seq_file to print into
+ * @cpu: The cpu the histogram belongs to
+ * @name: Name of the histogram
+ * @counters: Current counter values
+ * @baseline: Counter values at the last reset
+ * @labels: Label of each bucket. If NULL the bucket index is used.
+ * @count: Amount of buckets
+ */
+static void show_histogram(struct seq_file *seq, unsigned int cpu, const char *name,
+			   const u64 *counters, const u64 *baseline,
+			   const unsigned int *labels, unsigned int count)
+{
+	unsigned int i;
+	u64 value;
+
+	for (i = 0; i < count; ++i) {
+		value = READ_ONCE(counters[i]) - baseline[i];
+		if (value) {
+			seq_printf(seq, "%u,%s,%u,%llu\n", cpu, name, labels ? labels[i] : i, value);
+		}
+	}
+}
+
+void memutil_stats_show(struct seq_file *seq)
+{
+	unsigned int ratio_labels[MEMUTIL_STATS_RATIO_BUCKETS];
+	unsigned int cpu, i;
+
+	for (i = 0; i < MEMUTIL_STATS_RATIO_BUCKETS; ++i) {
+		ratio_labels[i] = i * MEMUTIL_STATS_RATIO_BUCKET_WIDTH;
+	}
+
+	mutex_lock(&memutil_stats_mutex);
+	for_each_possible_cpu(cpu) {
+		struct memutil_stats_cpu *stats = per_cpu_ptr(&memutil_stats, cpu);
+		struct memutil_histograms *counters = &stats->counters;
+		struct memutil_histograms *baseline = &stats->baseline;
+
+		if (!stats->in_use) {
+			continue;
+		}
+		seq_printf(seq, "%u,decisions,0,%llu\n", cpu,
+			   READ_ONCE(counters->decisions) - baseline->decisions);
+		show_histogram(seq, cpu, "ratio_pct", counters->ratio, baseline->ratio,
+			       ratio_labels, MEMUTIL_STATS_RATIO_BUCKETS);
+		show_histogram(seq, cpu, "opp_time_ns", counters->opp_time_ns, baseline->opp_time_ns,
+			       stats->opp_freq, stats->opp_count);
+		show_histogram(seq, cpu, "latency_log2_ns", counters->latency, baseline->latency,
+			       NULL, MEMUTIL_STATS_LATENCY_BUCKETS);
+		if (stats->base_freq) {
+			seq_printf(seq, "%u,turbo_time_ns,%u,%llu\n", cpu, stats->base_freq,
+				   READ_ONCE(counters->turbo_time_ns) - baseline->turbo_time_ns);
+		}
+		show_histogram(seq, cpu, "idle_hint_time_ns", counters->idle_hint_time_ns,
+			       baseline->idle_hint_time_ns, NULL, MEMUTIL_STATS_IDLE_HINTS);
+	}
+	mutex_unlock(&memutil_stats_mutex);
+}
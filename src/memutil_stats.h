@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_stats.h
+ *
+ * Header file for the always-on memutil statistics. With every frequency
+ * decision a few per-cpu histogram buckets are incremented: the stall ratio
+ * (or IPC, depending on the heuristic), the time spent at each frequency
+ * (OPP) and the latency of the decision itself. The histograms are only ever
+ * written by the cpu they belong to, so no locking is needed on the update
+ * path. They can be read and reset via the debugfs statsfile.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_STATS_H
+#define _MEMUTIL_STATS_H
+
+#include <linux/types.h>
+#include <linux/cpufreq.h>
+#include <linux/seq_file.h>
+
+/*
+ * Amount of buckets for the stall ratio / IPC histogram. Each bucket covers
+ * MEMUTIL_STATS_RATIO_BUCKET_WIDTH percent, the last bucket additionally
+ * collects all values that are larger.
+ */
+#define MEMUTIL_STATS_RATIO_BUCKETS 32
+#define MEMUTIL_STATS_RATIO_BUCKET_WIDTH 5
+/*
+ * Maximum amount of frequencies (OPPs) that are tracked per cpu. If the
+ * cpufreq driver does not provide a frequency table, the range between
+ * cpuinfo.min_freq and cpuinfo.max_freq is split into this many buckets.
+ */
+#define MEMUTIL_STATS_MAX_OPPS 32
+/*
+ * Amount of buckets for the decision latency histogram. Bucket i counts
+ * latencies in the range [2^i, 2^(i+1)) nanoseconds, the last bucket also
+ * collects all larger values.
+ */
+#define MEMUTIL_STATS_LATENCY_BUCKETS 24
+/*
+ * Amount of cpuidle hints that are tracked (see MEMUTIL_IDLE_HINT_* in
+ * memutil_idle_hint.h).
+ */
+#define MEMUTIL_STATS_IDLE_HINTS 2
+
+/**
+ * struct memutil_histograms - Counters of one cpu. All members have to be u64
+ *                             as the reset code treats the structure as an
+ *                             array of u64.
+ *
+ * @decisions: Amount of frequency decisions that were made
+ * @ratio: Histogram of the stall ratio / IPC (in percent) of each decision
+ * @opp_time_ns: Time (in nanoseconds) spent at each OPP
+ * @latency: Histogram of the decision latency (log2 nanosecond buckets)
+ * @turbo_time_ns: Time (in nanoseconds) spent above the base frequency
+ * @idle_hint_time_ns: Time (in nanoseconds) spent with each cpuidle hint
+ */
+struct memutil_histograms {
+	u64 decisions;
+	u64 ratio[MEMUTIL_STATS_RATIO_BUCKETS];
+	u64 opp_time_ns[MEMUTIL_STATS_MAX_OPPS];
+	u64 latency[MEMUTIL_STATS_LATENCY_BUCKETS];
+	u64 turbo_time_ns;
+	u64 idle_hint_time_ns[MEMUTIL_STATS_IDLE_HINTS];
+};
+
+/**
+ * memutil_stats_init_cpu - Initialize the statistics of the given policy's cpu.
+ *                          This reads the OPPs from the policy's frequency
+ *                          table and clears all counters.
+ *
+ *                          Has to be called before the update hook of the
+ *                          policy is installed.
+ * @policy: The cpufreq policy whose cpu should be initialized
+ * @base_freq: Highest frequency (in KHz) below the turbo range, 0 if unknown
+ */
+void memutil_stats_init_cpu(struct cpufreq_policy *policy, unsigned int base_freq);
+/**
+ * memutil_stats_exit_cpu - Mark the statistics of the given cpu as unused.
+ *                          Unused cpus are omitted from the statsfile.
+ * @cpu: The cpu whose statistics are no longer updated
+ */
+void memutil_stats_exit_cpu(unsigned int cpu);
+/**
+ * memutil_stats_record - Record one frequency decision of the current cpu.
+ *
+ *                        This function does not sleep and has to be called
+ *                        on the cpu the statistics belong to.
+ * @ratio: Stall ratio / IPC (in percent) the decision was based on. Negative
+ *         if no ratio was available (e.g. no cycles were counted).
+ * @prev_freq: Frequency (in KHz) that was used since the last decision
+ * @prev_freq_time_ns: Time (in nanoseconds) that prev_freq was used
+ * @latency_ns: Time (in nanoseconds) it took to make the decision
+ */
+void memutil_stats_record(s64 ratio, unsigned int prev_freq, u64 prev_freq_time_ns, u64 latency_ns);
+/**
+ * memutil_stats_record_idle_hint - Record the time the current cpu spent with
+ *                                  the given cpuidle hint.
+ *
+ *                                  This function does not sleep and has to be
+ *                                  called on the cpu the statistics belong to.
+ * @hint: The hint (see MEMUTIL_IDLE_HINT_*)
+ * @time_ns: Time (in nanoseconds) spent with the hint
+ */
+void memutil_stats_record_idle_hint(int hint, u64 time_ns);
+/**
+ * memutil_stats_reset - Reset the statistics of all cpus.
+ *
+ *                       The counters are never written by anyone but their
+ *                       cpu. Instead a snapshot of the current values is taken
+ *                       and subtracted whenever the statistics are shown.
+ *                       This function may sleep.
+ */
+void memutil_stats_reset(void);
+/**
+ * memutil_stats_show - Print the statistics of all cpus that are in use as
+ *                      text into the given seq_file. The format is one line
+ *                      per non-empty bucket: <cpu>,<histogram>,<bucket>,<value>
+ *
+ *                      This function may sleep.
+ * @seq: The seq_file to print into
+ */
+void memutil_stats_show(struct seq_file *seq);
+
+#endif //_MEMUTIL_STATS_H
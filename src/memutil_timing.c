@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_timing.c
+ *
+ * Implementation file for the optional hot path timing.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/bitops.h>
+#include <linux/cpumask.h>
+#include <linux/limits.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+
+#include "memutil_timing.h"
+
+DEFINE_STATIC_KEY_FALSE(memutil_timing_key);
+
+/**
+ * struct memutil_timing_stage_data - Accumulated timings of one stage
+ *
+ * @count: Amount of recorded durations
+ * @sum_ns: Sum of all recorded durations
+ * @min_ns: Shortest recorded duration
+ * @max_ns: Longest recorded duration
+ * @histogram: log2 histogram of the recorded durations
+ */
+struct memutil_timing_stage_data {
+	u64 count;
+	u64 sum_ns;
+	u64 min_ns;
+	u64 max_ns;
+	u64 histogram[MEMUTIL_TIMING_BUCKETS];
+};
+
+/**
+ * struct memutil_timing_cpu - Timings of one cpu. Only written by its cpu.
+ *
+ * @generation: The reset generation the data belongs to. If it differs from
+ *              memutil_timing_generation, the data is outdated and cleared by
+ *              the cpu before the next duration is recorded.
+ * @stages: Data for each stage
+ */
+struct memutil_timing_cpu {
+	unsigned long generation;
+	struct memutil_timing_stage_data stages[MEMUTIL_TIMING_STAGE_COUNT];
+};
+
+static DEFINE_PER_CPU(struct memutil_timing_cpu, memutil_timing);
+/*
+ * Incremented for each reset. Starts at 1 so that the (zeroed) per cpu data
+ * is outdated initially.
+ */
+static unsigned long memutil_timing_generation = 1;
+/* Serializes enabling / disabling the timing */
+static DEFINE_MUTEX(memutil_timing_mutex);
+
+static const char * const stage_names[MEMUTIL_TIMING_STAGE_COUNT] = {
+	[MEMUTIL_TIMING_HOOK_SKIP] = "hook_skip",
+	[MEMUTIL_TIMING_READ_COUNTERS] = "read_counters",
+	[MEMUTIL_TIMING_HEURISTIC] = "heuristic",
+	[MEMUTIL_TIMING_SET_FREQUENCY] = "set_frequency",
+	[MEMUTIL_TIMING_LOG] = "log",
+	[MEMUTIL_TIMING_DECISION] = "decision",
+};
+
+void memutil_timing_record(enum memutil_timing_stage stage, u64 duration_ns)
+{
+	struct memutil_timing_cpu *timing = this_cpu_ptr(&memutil_timing);
+	unsigned long generation = READ_ONCE(memutil_timing_generation);
+	struct memutil_timing_stage_data *data;
+	unsigned int bucket, i;
+
+	if (unlikely(timing->generation != generation)) {
+		memset(timing->stages, 0, sizeof(timing->stages));
+		for (i = 0; i < MEMUTIL_TIMING_STAGE_COUNT; ++i) {
+			timing->stages[i].min_ns = U64_MAX;
+		}
+		WRITE_ONCE(timing->generation, generation);
+	}
+
+	data = &timing->stages[stage];
+	bucket = min_t(unsigned int, duration_ns ? fls64(duration_ns) - 1 : 0, MEMUTIL_TIMING_BUCKETS - 1);
+	WRITE_ONCE(data->count, data->count + 1);
+	WRITE_ONCE(data->sum_ns, data->sum_ns + duration_ns);
+	WRITE_ONCE(data->histogram[bucket], data->histogram[bucket] + 1);
+	if (duration_ns < data->min_ns) {
+		WRITE_ONCE(data->min_ns, duration_ns);
+	}
+	if (duration_ns > data->max_ns) {
+		WRITE_ONCE(data->max_ns, duration_ns);
+	}
+}
+
+void memutil_timing_set_enabled(bool enabled)
+{
+	mutex_lock(&memutil_timing_mutex);
+	if (enabled) {
+		//the cpus clear their outdated data themselves
+		WRITE_ONCE(memutil_timing_generation, memutil_timing_generation + 1);
+		static_branch_enable(&memutil_timing_key);
+	} else {
+		static_branch_disable(&memutil_timing_key);
+	}
+	mutex_unlock(&memutil_timing_mutex);
+}
+
+void memutil_timing_show(struct seq_file *seq)
+{
+	unsigned long generation = READ_ONCE(memutil_timing_generation);
+	unsigned int cpu, stage, bucket;
+
+	for_each_possible_cpu(cpu) {
+		struct memutil_timing_cpu *timing = per_cpu_ptr(&memutil_timing, cpu);
+
+		if (READ_ONCE(timing->generation) != generation) {
+			continue;
+		}
+		for (stage = 0; stage < MEMUTIL_TIMING_STAGE_COUNT; ++stage) {
+			struct memutil_timing_stage_data *data = &timing->stages[stage];
+			u64 count = READ_ONCE(data->count);
+
+			if (!count) {
+				continue;
+			}
+			seq_printf(seq, "%u,%s,%llu,%llu,%llu,%llu,", cpu, stage_names[stage], count,
+				   READ_ONCE(data->min_ns), div64_u64(READ_ONCE(data->sum_ns), count),
+				   READ_ONCE(data->max_ns));
+			for (bucket = 0; bucket < MEMUTIL_TIMING_BUCKETS; ++bucket) {
+				u64 value = READ_ONCE(data->histogram[bucket]);
+
+				if (value) {
+					seq_printf(seq, "%u:%llu ", bucket, value);
+				}
+			}
+			seq_putc(seq, '\n');
+		}
+	}
+}
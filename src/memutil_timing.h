@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_timing.h
+ *
+ * Header file for the optional hot path timing. When enabled (see the debugfs
+ * timingfile), each stage of the update hook is timed with local_clock() and
+ * accumulated into per-cpu min / mean / max values and log2 histograms.
+ * When disabled, the instrumentation is patched out via a static key and costs
+ * nothing but a nop per stage.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_TIMING_H
+#define _MEMUTIL_TIMING_H
+
+#include <linux/jump_label.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+
+/*
+ * Amount of buckets of the timing histograms. Bucket i counts durations in the
+ * range [2^i, 2^(i+1)) nanoseconds, the last bucket also collects all larger
+ * values.
+ */
+#define MEMUTIL_TIMING_BUCKETS 20
+
+/**
+ * enum memutil_timing_stage - The stages of the update hook that are timed
+ *
+ * @MEMUTIL_TIMING_HOOK_SKIP: Hook calls that did not lead to a decision
+ * @MEMUTIL_TIMING_READ_COUNTERS: Reading the perf counters
+ * @MEMUTIL_TIMING_HEURISTIC: Calculating the new frequency
+ * @MEMUTIL_TIMING_SET_FREQUENCY: memutil_set_frequency_to()
+ * @MEMUTIL_TIMING_LOG: Recording statistics and writing the log ringbuffer
+ * @MEMUTIL_TIMING_DECISION: Hook calls that made a decision, from start to end
+ */
+enum memutil_timing_stage {
+	MEMUTIL_TIMING_HOOK_SKIP,
+	MEMUTIL_TIMING_READ_COUNTERS,
+	MEMUTIL_TIMING_HEURISTIC,
+	MEMUTIL_TIMING_SET_FREQUENCY,
+	MEMUTIL_TIMING_LOG,
+	MEMUTIL_TIMING_DECISION,
+	MEMUTIL_TIMING_STAGE_COUNT
+};
+
+DECLARE_STATIC_KEY_FALSE(memutil_timing_key);
+
+/**
+ * memutil_timing_record - Record the duration of one stage for the current cpu.
+ *                         Use memutil_timing_lap() instead of calling this directly.
+ * @stage: The stage that was timed
+ * @duration_ns: Duration of the stage in nanoseconds
+ */
+void memutil_timing_record(enum memutil_timing_stage stage, u64 duration_ns);
+
+/**
+ * memutil_timing_now - Get the timestamp a timed stage starts at.
+ *                      Returns 0 if timing is disabled.
+ */
+static __always_inline u64 memutil_timing_now(void)
+{
+	if (static_branch_unlikely(&memutil_timing_key)) {
+		return local_clock();
+	}
+	return 0;
+}
+
+/**
+ * memutil_timing_lap - Record the time since *timestamp for the given stage and
+ *                      set *timestamp to now, so the next stage can be timed
+ *                      from here on. Nothing is recorded if *timestamp is 0
+ *                      (timing was disabled when the stage started).
+ * @stage: The stage that ends now
+ * @timestamp: Start of the stage, see memutil_timing_now()
+ */
+static __always_inline void memutil_timing_lap(enum memutil_timing_stage stage, u64 *timestamp)
+{
+	u64 now;
+
+	if (!static_branch_unlikely(&memutil_timing_key)) {
+		return;
+	}
+	now = local_clock();
+	if (*timestamp) {
+		memutil_timing_record(stage, now - *timestamp);
+	}
+	*timestamp = now;
+}
+
+/**
+ * memutil_timing_set_enabled - Enable or disable the hot path timing. Enabling
+ *                              also resets all previously recorded timings.
+ *
+ *                              This function may sleep.
+ * @enabled: Whether the timing should be enabled
+ */
+void memutil_timing_set_enabled(bool enabled);
+/**
+ * memutil_timing_show - Print the timings of all cpus as text into the given
+ *                       seq_file. The format is one line per cpu and stage:
+ *                       <cpu>,<stage>,<count>,<min_ns>,<mean_ns>,<max_ns>,<histogram>
+ *                       where histogram lists the non-empty buckets as
+ *                       <log2_ns>:<count> separated by spaces.
+ * @seq: The seq_file to print into
+ */
+void memutil_timing_show(struct seq_file *seq);
+
+#endif //_MEMUTIL_TIMING_H
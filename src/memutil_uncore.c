@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_uncore.c
+ *
+ * Implementation file for the uncore frequency coordination.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/printk.h>
+#include <linux/smp.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+#ifdef CONFIG_X86
+#include <asm/msr.h>
+#include <asm/processor.h>
+#endif
+
+#include "memutil_package.h"
+#include "memutil_uncore.h"
+
+/* Uncore range of the mock backend (0.8 - 2.4 GHz) */
+#define MOCK_MIN_RATIO 8
+#define MOCK_MAX_RATIO 24
+
+/**
+ * struct uncore_package - Coordination state of one package
+ *
+ * The cpus report the stall share (in permille) of their last interval as
+ * their first value.
+ *
+ * @base: Generic package state
+ * @backend: Backend that writes the limits of the package
+ * @original: The limits before memutil started
+ * @requested: The limits that were written last
+ * @mock: The limits of the mock backend
+ */
+struct uncore_package {
+	struct memutil_package base;
+	const struct memutil_uncore_backend *backend;
+	struct memutil_uncore_limits original;
+	struct memutil_uncore_limits requested;
+	struct memutil_uncore_limits mock;
+};
+
+/**
+ * struct uncore_call - Arguments of a backend call on a cpu of the package
+ */
+struct uncore_call {
+	struct uncore_package *package;
+	int return_value;
+};
+
+static void read_original(void *info)
+{
+	struct uncore_call *call = info;
+	struct uncore_package *package = call->package;
+
+	call->return_value = package->backend->read(package->base.index, &package->original);
+	package->requested = package->original;
+}
+
+static void restore_original(void *info)
+{
+	struct uncore_call *call = info;
+	struct uncore_package *package = call->package;
+
+	call->return_value = package->backend->write(package->base.index, &package->original);
+}
+
+/**
+ * uncore_join - Read the original limits of the package on the given cpu of it
+ */
+static int uncore_join(struct memutil_package *base, unsigned int cpu, void *arg)
+{
+	struct uncore_call call = {
+		.package = container_of(base, struct uncore_package, base),
+	};
+	int return_value;
+
+	call.package->backend = arg;
+	call.package->mock = (struct memutil_uncore_limits) {
+		.min_ratio = MOCK_MIN_RATIO,
+		.max_ratio = MOCK_MAX_RATIO,
+	};
+	return_value = smp_call_function_single(cpu, read_original, &call, 1);
+	if (return_value) {
+		return return_value;
+	}
+	if (call.return_value) {
+		return call.return_value;
+	}
+	if (call.package->original.min_ratio >= call.package->original.max_ratio) {
+		//the uncore frequency is fixed
+		return -ENODEV;
+	}
+	return 0;
+}
+
+/**
+ * uncore_leave - Restore the original limits of the package on the given cpu of it
+ */
+static void uncore_leave(struct memutil_package *base, unsigned int cpu)
+{
+	struct uncore_call call = {
+		.package = container_of(base, struct uncore_package, base),
+	};
+	int return_value;
+
+	return_value = smp_call_function_single(cpu, restore_original, &call, 1);
+	if (return_value || call.return_value) {
+		pr_warn("Memutil: Failed to restore the uncore limits of package %u: %d", base->index,
+			return_value ? return_value : call.return_value);
+	}
+}
+
+static struct memutil_package_set uncore_set =
+	MEMUTIL_PACKAGE_SET_INIT(uncore_set, struct uncore_package, MEMUTIL_UNCORE_PERIOD_NS, uncore_join,
+				 uncore_leave);
+
+static struct uncore_package *get_uncore_package(unsigned int index)
+{
+	return container_of(memutil_package_get(&uncore_set, index), struct uncore_package, base);
+}
+
+#ifdef CONFIG_X86
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,16,0)
+#define memutil_rdmsr_safe rdmsrq_safe
+#define memutil_wrmsr_safe wrmsrq_safe
+#else
+#define memutil_rdmsr_safe rdmsrl_safe
+#define memutil_wrmsr_safe wrmsrl_safe
+#endif
+
+#ifndef MSR_UNCORE_RATIO_LIMIT
+#define MSR_UNCORE_RATIO_LIMIT 0x620
+#endif
+/* Fields of MSR_UNCORE_RATIO_LIMIT */
+#define UNCORE_MAX_RATIO_MASK 0x7f
+#define UNCORE_MIN_RATIO_SHIFT 8
+#define UNCORE_MIN_RATIO_MASK (0x7fULL << UNCORE_MIN_RATIO_SHIFT)
+
+static int msr_probe(void)
+{
+	u64 value;
+
+	if (boot_cpu_data.x86_vendor != X86_VENDOR_INTEL) {
+		return -ENODEV;
+	}
+	if (memutil_rdmsr_safe(MSR_UNCORE_RATIO_LIMIT, &value)) {
+		return -ENODEV;
+	}
+	return 0;
+}
+
+static int msr_read(unsigned int package, struct memutil_uncore_limits *limits)
+{
+	u64 value;
+
+	if (memutil_rdmsr_safe(MSR_UNCORE_RATIO_LIMIT, &value)) {
+		return -EIO;
+	}
+	limits->max_ratio = value & UNCORE_MAX_RATIO_MASK;
+	limits->min_ratio = (value & UNCORE_MIN_RATIO_MASK) >> UNCORE_MIN_RATIO_SHIFT;
+	return 0;
+}
+
+static int msr_write(unsigned int package, const struct memutil_uncore_limits *limits)
+{
+	u64 value;
+
+	//keep the reserved bits
+	if (unlikely(memutil_rdmsr_safe(MSR_UNCORE_RATIO_LIMIT, &value))) {
+		return -EIO;
+	}
+	value &= ~(UNCORE_MAX_RATIO_MASK | UNCORE_MIN_RATIO_MASK);
+	value |= limits->max_ratio & UNCORE_MAX_RATIO_MASK;
+	value |= ((u64)limits->min_ratio << UNCORE_MIN_RATIO_SHIFT) & UNCORE_MIN_RATIO_MASK;
+	if (unlikely(memutil_wrmsr_safe(MSR_UNCORE_RATIO_LIMIT, value))) {
+		return -EIO;
+	}
+	return 0;
+}
+
+static const struct memutil_uncore_backend msr_backend = {
+	.name = "msr",
+	.probe = msr_probe,
+	.read = msr_read,
+	.write = msr_write,
+};
+
+#endif //CONFIG_X86
+
+static int mock_probe(void)
+{
+	return 0;
+}
+
+static int mock_read(unsigned int package, struct memutil_uncore_limits *limits)
+{
+	*limits = get_uncore_package(package)->mock;
+	return 0;
+}
+
+static int mock_write(unsigned int package, const struct memutil_uncore_limits *limits)
+{
+	get_uncore_package(package)->mock = *limits;
+	return 0;
+}
+
+static const struct memutil_uncore_backend mock_backend = {
+	.name = "mock",
+	.probe = mock_probe,
+	.read = mock_read,
+	.write = mock_write,
+};
+
+static const struct memutil_uncore_backend *uncore_backends[] = {
+#ifdef CONFIG_X86
+	&msr_backend,
+#endif
+	&mock_backend,
+};
+
+const struct memutil_uncore_backend *memutil_uncore_select(const char *name)
+{
+	unsigned int i;
+	int return_value;
+
+	if (!name || !*name || strcmp(name, "none") == 0) {
+		return NULL;
+	}
+	for (i = 0; i < ARRAY_SIZE(uncore_backends); ++i) {
+		if (strcmp(name, uncore_backends[i]->name) != 0) {
+			continue;
+		}
+		return_value = uncore_backends[i]->probe();
+		if (return_value) {
+			pr_warn("Memutil: Uncore backend %s is not available: %d", name, return_value);
+			return NULL;
+		}
+		pr_info("Memutil: Using uncore backend %s", name);
+		return uncore_backends[i];
+	}
+	pr_warn("Memutil: Unknown uncore backend %s", name);
+	return NULL;
+}
+
+int memutil_uncore_init_cpu(unsigned int cpu, const struct memutil_uncore_backend *backend)
+{
+	return memutil_package_join(&uncore_set, cpu, (void *)backend);
+}
+
+void memutil_uncore_exit_cpu(unsigned int cpu)
+{
+	memutil_package_leave(&uncore_set, cpu);
+}
+
+/**
+ * target_limits - Map the stall share of a package onto its uncore range
+ * @package: The package
+ * @share: Maximum stall share (in permille) of the package's cpus
+ * @limits: Set to the limits to request
+ */
+static void target_limits(const struct uncore_package *package, u32 share, struct memutil_uncore_limits *limits)
+{
+	int low = package->original.min_ratio;
+	int high = package->original.max_ratio;
+	int target;
+
+	if (share <= MEMUTIL_UNCORE_LOW_SHARE) {
+		target = low;
+	} else if (share >= MEMUTIL_UNCORE_HIGH_SHARE) {
+		target = high;
+	} else {
+		target = low + DIV_ROUND_UP((high - low) * (int)(share - MEMUTIL_UNCORE_LOW_SHARE),
+					    MEMUTIL_UNCORE_HIGH_SHARE - MEMUTIL_UNCORE_LOW_SHARE);
+	}
+	limits->max_ratio = target;
+	limits->min_ratio = max(target - MEMUTIL_UNCORE_WINDOW, low);
+}
+
+unsigned int memutil_uncore_update(s64 share, u64 time)
+{
+	struct uncore_package *package = container_of(memutil_package_own(&uncore_set), struct uncore_package, base);
+	struct memutil_package_summary summary;
+	struct memutil_uncore_limits limits;
+
+	if (share >= 0) {
+		memutil_package_report(&uncore_set, share, 0, time);
+	}
+	if (!memutil_package_try_begin(&uncore_set, &package->base, time)) {
+		return READ_ONCE(package->requested.max_ratio);
+	}
+
+	memutil_package_summarize(&uncore_set, time, &summary);
+	target_limits(package, summary.max[0], &limits);
+	if (limits.min_ratio != package->requested.min_ratio || limits.max_ratio != package->requested.max_ratio) {
+		if (likely(package->backend->write(package->base.index, &limits) == 0)) {
+			WRITE_ONCE(package->requested, limits);
+		} else {
+			pr_warn_ratelimited("Memutil: Uncore write failed (package=%u)", package->base.index);
+		}
+	}
+	memutil_package_end(&package->base);
+	return package->requested.max_ratio;
+}
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_uncore.h
+ *
+ * Header file for the uncore frequency coordination. For memory bound code the
+ * uncore (LLC and memory controller) clock matters more than the core clock.
+ * Every cpu reports the stall share of its intervals, and about every
+ * MEMUTIL_UNCORE_PERIOD_NS one cpu of a package aggregates the reports of all
+ * cpus of the package that use memutil and were busy recently (see
+ * memutil_package.h). The maximum
+ * share is mapped linearly onto the uncore ratio range of the package, i.e. a
+ * DRAM bound cpu raises the uncore for the whole package, a package of compute
+ * bound cpus lowers it. The uncore is limited to a window below the target
+ * ratio, within which the hardware keeps scaling it on its own.
+ *
+ * Available backends:
+ *
+ *   msr:  The uncore ratio limit MSR of Intel cpus, the register behind the
+ *         intel_uncore_frequency sysfs interface (which has no in-kernel API).
+ *         Do not change the limits through that interface at the same time.
+ *   mock: Keeps the limits in memory only, for test machines. Every
+ *         coordination of a package starts at the full mock range.
+ *
+ * The original limits of a package are restored when the last cpu of the
+ * package stops using memutil.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_UNCORE_H
+#define _MEMUTIL_UNCORE_H
+
+#include <linux/time64.h>
+#include <linux/types.h>
+
+/* How often the uncore limits of a package are adapted */
+#define MEMUTIL_UNCORE_PERIOD_NS (20 * NSEC_PER_MSEC)
+/* Stall share (in permille) at or below which the uncore runs at its lowest ratio */
+#define MEMUTIL_UNCORE_LOW_SHARE 100
+/* Stall share (in permille) at or above which the uncore runs at its highest ratio */
+#define MEMUTIL_UNCORE_HIGH_SHARE 500
+/* Width (in ratio units, i.e. 100 MHz) of the window below the target ratio */
+#define MEMUTIL_UNCORE_WINDOW 4
+
+/**
+ * struct memutil_uncore_limits - Uncore frequency limits of a package as
+ *                                ratios of 100 MHz
+ *
+ * @min_ratio: Lowest ratio the uncore may run at
+ * @max_ratio: Highest ratio the uncore may run at
+ */
+struct memutil_uncore_limits {
+	u8 min_ratio;
+	u8 max_ratio;
+};
+
+/**
+ * struct memutil_uncore_backend - An uncore backend
+ *
+ * @name: Name of the backend, used for the uncore module parameter
+ * @probe: Check whether the backend is usable on this machine. Returns 0 if
+ *         it is, otherwise an error code. May sleep.
+ * @read: Read the limits of the given package. Has to be called on a cpu of
+ *        the package. Returns 0 on success. Must not sleep.
+ * @write: Write the limits of the given package. Has to be called on a cpu of
+ *         the package. Returns 0 on success. Must not sleep, it is called
+ *         from the update hook.
+ */
+struct memutil_uncore_backend {
+	const char *name;
+	int (*probe)(void);
+	int (*read)(unsigned int package, struct memutil_uncore_limits *limits);
+	int (*write)(unsigned int package, const struct memutil_uncore_limits *limits);
+};
+
+/**
+ * memutil_uncore_select - Select the uncore backend with the given name.
+ *
+ *                         Returns the backend on success, NULL if the name is
+ *                         "none" or the backend is unknown / not usable.
+ *                         This function may sleep.
+ * @name: Name of the backend
+ */
+const struct memutil_uncore_backend *memutil_uncore_select(const char *name);
+/**
+ * memutil_uncore_init_cpu - Start coordinating the uncore of the given cpu's
+ *                           package with the given backend. The first cpu of a
+ *                           package reads its original limits.
+ *
+ *                           Returns 0 on success, otherwise an error code.
+ *                           This function may sleep.
+ * @cpu: The cpu that starts using memutil
+ * @backend: The selected backend
+ */
+int memutil_uncore_init_cpu(unsigned int cpu, const struct memutil_uncore_backend *backend);
+/**
+ * memutil_uncore_exit_cpu - Stop coordinating the uncore for the given cpu. The
+ *                           last cpu of a package restores the original limits.
+ *                           The update hook of the cpu must not run anymore.
+ *
+ *                           This function may sleep.
+ * @cpu: The cpu that stops using memutil
+ */
+void memutil_uncore_exit_cpu(unsigned int cpu);
+/**
+ * memutil_uncore_update - Report the stall share of the interval that just
+ *                         ended on the current cpu and adapt the limits of its
+ *                         package if the period is over.
+ *
+ *                         Returns the current max ratio of the package, 0 if
+ *                         the package is not coordinated.
+ *                         This function does not sleep.
+ * @share: Stall share (in permille) of the interval, negative if unknown
+ * @time: Timestamp (nanoseconds) of the update
+ */
+unsigned int memutil_uncore_update(s64 share, u64 time);
+
+#endif //_MEMUTIL_UNCORE_H
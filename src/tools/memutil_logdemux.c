@@ -0,0 +1,648 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_logdemux.c
+ *
+ * Userspace tool that continuously reads the memutil log and demultiplexes the
+ * records by cpu in a single pass. It replaces copy-log.sh, which forked a
+ * grep per core every interval.
+ *
+ * For every cpu a file cpu<N>.mcol is written in a compact columnar format
+ * (see below) and optionally a csv file log-<N>.txt that has the same format
+ * as the log itself. Memory usage is bounded: each cpu buffers at most one
+ * block of rows before it is written. Records that were lost (because a
+ * ringbuffer wrapped around before it was drained) are detected by the
+ * sequence number in the last column of the log and reported. Long intervals
+ * between the records of a cpu are reported separately: they are no loss, a
+ * tickless idle cpu simply does not log.
+ *
+ * Columnar format: The file is a sequence of blocks. Each block starts with
+ * a header (all values little endian)
+ *   char magic[4] = "MCOL"
+ *   u8   version = 1
+ *   u8   column_count
+ *   u16  reserved = 0
+ *   u32  row_count
+ *   u32  payload_size
+ * followed by payload_size bytes containing the columns one after another.
+ * Each column contains row_count values, every value is stored as the
+ * difference to the previous value of the column (the first one to 0),
+ * zigzag encoded as a LEB128 varint. The columns are the columns of the log,
+ * i.e. cpu,timestamp,perf_value1,... . Use -d to decode a file back into csv.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SOURCE "/sys/kernel/debug/memutil/log"
+#define DEFAULT_INFO "/sys/kernel/debug/memutil/info"
+/* Maximum amount of columns of one log line */
+#define MAX_COLUMNS 32
+/* Maximum length of one log line */
+#define MAX_LINE_LENGTH 1024
+#define READ_CHUNK_SIZE (64 * 1024)
+#define DEFAULT_BLOCK_ROWS 4096
+#define DEFAULT_INTERVAL_MS 1000
+/* Default long interval threshold as multiple of the update interval */
+#define LONG_INTERVAL_FACTOR 4
+#define MCOL_MAGIC "MCOL"
+#define MCOL_VERSION 1
+#define MCOL_HEADER_SIZE 16
+/* A zigzag encoded u64 needs at most 10 bytes as varint */
+#define MAX_VARINT_SIZE 10
+
+/**
+ * struct cpu_output - Output state of one cpu
+ *
+ * @in_use: Whether any record of this cpu was seen
+ * @column_count: Amount of columns of the records of this cpu
+ * @rows: Buffered rows, block_rows * column_count values (row major)
+ * @row_count: Amount of buffered rows
+ * @mcol: The columnar output file
+ * @csv: The csv output file (NULL if disabled)
+ * @last_timestamp: Timestamp of the last record
+ * @last_sequence: Sequence number (last column) of the last record
+ * @records: Amount of records written
+ * @lost: Amount of records that were lost according to the sequence numbers
+ * @long_intervals: Amount of long intervals between records
+ */
+struct cpu_output {
+	bool in_use;
+	unsigned int column_count;
+	uint64_t *rows;
+	unsigned int row_count;
+	FILE *mcol;
+	FILE *csv;
+	uint64_t last_timestamp;
+	uint32_t last_sequence;
+	uint64_t records;
+	uint64_t lost;
+	uint64_t long_intervals;
+};
+
+/**
+ * struct demux - State of the demultiplexer
+ */
+struct demux {
+	const char *output_dir;
+	bool write_csv;
+	unsigned int block_rows;
+	uint64_t long_interval_ns;
+	struct cpu_output *cpus;
+	unsigned int cpu_count;
+	uint64_t malformed_lines;
+	uint8_t *payload;
+	size_t payload_size;
+};
+
+static volatile sig_atomic_t should_stop = 0;
+
+static void handle_signal(int signal)
+{
+	(void)signal;
+	should_stop = 1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-s SOURCE (" DEFAULT_SOURCE ") | -i INTERVAL_MS (%d) | -l LONG_MS | -b BLOCK_ROWS (%d) | -c | -o] <output_dir>\n"
+		"       %s -d <file.mcol>\n"
+		"\n"
+		"Continuously reads the memutil log and splits it by cpu in one pass.\n"
+		"For each cpu cpu<N>.mcol (columnar format) is written into output_dir.\n"
+		"Parameters:\n"
+		"\t-s SOURCE: Path of the memutil log, - for stdin\n"
+		"\t-i INTERVAL_MS: Time to wait after the log was drained completely\n"
+		"\t-l LONG_MS: Report a long interval if two records of a cpu are further\n"
+		"\t            apart (e.g. idle, no loss). Defaults to %d times the update\n"
+		"\t            interval of the info file. Lost records are always reported.\n"
+		"\t-b BLOCK_ROWS: Rows per cpu that are buffered before they are written\n"
+		"\t-c: Additionally write log-<N>.txt in csv format (like copy-log.sh)\n"
+		"\t-o: Stop at the end of the source instead of reading continuously\n"
+		"\t-d FILE: Decode a .mcol file and print it as csv\n",
+		name, DEFAULT_INTERVAL_MS, DEFAULT_BLOCK_ROWS, name, LONG_INTERVAL_FACTOR);
+}
+
+static void put_u16(uint8_t *out, uint16_t value)
+{
+	out[0] = value & 0xFF;
+	out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+	put_u16(out, value & 0xFFFF);
+	put_u16(out + 2, value >> 16);
+}
+
+static uint32_t get_u32(const uint8_t *in)
+{
+	return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/**
+ * put_varint - Write the zigzag encoded difference as LEB128 varint.
+ *              Returns the amount of bytes written.
+ */
+static size_t put_varint(uint8_t *out, uint64_t value, uint64_t previous)
+{
+	int64_t delta = (int64_t)(value - previous);
+	uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+	size_t size = 0;
+
+	while (zigzag >= 0x80) {
+		out[size++] = (zigzag & 0x7F) | 0x80;
+		zigzag >>= 7;
+	}
+	out[size++] = zigzag;
+	return size;
+}
+
+/**
+ * get_varint - Read one varint written by put_varint and return the value.
+ *              Returns the amount of bytes read, 0 if the input is malformed.
+ */
+static size_t get_varint(const uint8_t *in, size_t in_size, uint64_t previous, uint64_t *value)
+{
+	uint64_t zigzag = 0;
+	size_t size = 0;
+	int64_t delta;
+
+	for (;;) {
+		if (size >= in_size || size >= MAX_VARINT_SIZE) {
+			return 0;
+		}
+		zigzag |= (uint64_t)(in[size] & 0x7F) << (7 * size);
+		if (!(in[size++] & 0x80)) {
+			break;
+		}
+	}
+	delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+	*value = previous + (uint64_t)delta;
+	return size;
+}
+
+static FILE *open_output(const char *dir, const char *prefix, unsigned int cpu, const char *suffix)
+{
+	char path[4096];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s/%s%u%s", dir, prefix, cpu, suffix);
+	file = fopen(path, "ab");
+	if (!file) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+	}
+	return file;
+}
+
+/**
+ * flush_cpu - Write the buffered rows of the given cpu as one block
+ */
+static int flush_cpu(struct demux *demux, struct cpu_output *output)
+{
+	uint8_t header[MCOL_HEADER_SIZE];
+	size_t payload_used = 0;
+	unsigned int row, column;
+	uint64_t previous;
+
+	if (output->row_count == 0) {
+		return 0;
+	}
+	for (column = 0; column < output->column_count; ++column) {
+		previous = 0;
+		for (row = 0; row < output->row_count; ++row) {
+			uint64_t value = output->rows[row * output->column_count + column];
+
+			payload_used += put_varint(demux->payload + payload_used, value, previous);
+			previous = value;
+		}
+	}
+	memcpy(header, MCOL_MAGIC, 4);
+	header[4] = MCOL_VERSION;
+	header[5] = output->column_count;
+	put_u16(header + 6, 0);
+	put_u32(header + 8, output->row_count);
+	put_u32(header + 12, payload_used);
+	if (fwrite(header, sizeof(header), 1, output->mcol) != 1 ||
+	    fwrite(demux->payload, payload_used, 1, output->mcol) != 1) {
+		fprintf(stderr, "Failed to write block: %s\n", strerror(errno));
+		return -1;
+	}
+	output->row_count = 0;
+	return 0;
+}
+
+/**
+ * get_cpu_output - Get (and create if needed) the output for the given cpu
+ */
+static struct cpu_output *get_cpu_output(struct demux *demux, unsigned int cpu, unsigned int column_count)
+{
+	struct cpu_output *output;
+
+	if (cpu >= demux->cpu_count) {
+		unsigned int new_count = cpu + 1;
+		struct cpu_output *cpus = realloc(demux->cpus, new_count * sizeof(*cpus));
+
+		if (!cpus) {
+			return NULL;
+		}
+		memset(cpus + demux->cpu_count, 0, (new_count - demux->cpu_count) * sizeof(*cpus));
+		demux->cpus = cpus;
+		demux->cpu_count = new_count;
+	}
+	output = &demux->cpus[cpu];
+	if (output->in_use) {
+		if (output->column_count != column_count) {
+			return NULL;
+		}
+		return output;
+	}
+
+	output->rows = malloc((size_t)demux->block_rows * column_count * sizeof(uint64_t));
+	output->mcol = open_output(demux->output_dir, "cpu", cpu, ".mcol");
+	if (demux->write_csv) {
+		output->csv = open_output(demux->output_dir, "log-", cpu, ".txt");
+	}
+	if (!output->rows || !output->mcol || (demux->write_csv && !output->csv)) {
+		exit(EXIT_FAILURE);
+	}
+	output->column_count = column_count;
+	output->in_use = true;
+	return output;
+}
+
+/**
+ * handle_line - Parse one line of the log and add it to the output of its cpu
+ */
+static void handle_line(struct demux *demux, char *line, size_t length)
+{
+	uint64_t values[MAX_COLUMNS];
+	unsigned int column_count = 0;
+	struct cpu_output *output;
+	uint32_t sequence, lost;
+	char *current = line;
+	char *end;
+
+	if (length == 0) {
+		return;
+	}
+	for (;;) {
+		if (column_count >= MAX_COLUMNS) {
+			goto malformed;
+		}
+		errno = 0;
+		values[column_count++] = strtoull(current, &end, 10);
+		if (end == current || errno) {
+			goto malformed;
+		}
+		if (*end != ',') {
+			break;
+		}
+		current = end + 1;
+	}
+	if (*end != '\0' || column_count < 2) {
+		goto malformed;
+	}
+
+	output = get_cpu_output(demux, values[0], column_count);
+	if (!output) {
+		goto malformed;
+	}
+	sequence = values[column_count - 1];
+	if (output->records > 0 && sequence != (uint32_t)(output->last_sequence + 1)) {
+		//the sequence numbers are u32 in the kernel and wrap around
+		lost = (uint32_t)(sequence - output->last_sequence - 1);
+		output->lost += lost;
+		fprintf(stderr, "Lost %" PRIu32 " records on cpu %" PRIu64 " (after timestamp %" PRIu64 ")\n",
+			lost, values[0], output->last_timestamp);
+	} else if (output->records > 0 && values[1] > output->last_timestamp &&
+		   values[1] - output->last_timestamp > demux->long_interval_ns) {
+		output->long_intervals++;
+		fprintf(stderr, "Long interval on cpu %" PRIu64 ": %" PRIu64 " ms without records (at timestamp %" PRIu64 ")\n",
+			values[0], (values[1] - output->last_timestamp) / 1000000, output->last_timestamp);
+	}
+	output->last_timestamp = values[1];
+	output->last_sequence = sequence;
+	output->records++;
+
+	memcpy(&output->rows[output->row_count * column_count], values, column_count * sizeof(uint64_t));
+	if (++output->row_count >= demux->block_rows) {
+		flush_cpu(demux, output);
+	}
+	if (output->csv) {
+		fwrite(line, length, 1, output->csv);
+		fputc('\n', output->csv);
+	}
+	return;
+
+malformed:
+	demux->malformed_lines++;
+}
+
+/**
+ * handle_chunk - Split the given data into lines and handle every complete line.
+ *                Returns the amount of bytes that belong to an incomplete line
+ *                at the end (they were moved to the start of the buffer).
+ */
+static size_t handle_chunk(struct demux *demux, char *buffer, size_t size)
+{
+	char *line = buffer;
+	char *newline;
+	size_t rest;
+
+	while ((newline = memchr(line, '\n', buffer + size - line))) {
+		*newline = '\0';
+		handle_line(demux, line, newline - line);
+		line = newline + 1;
+	}
+	rest = buffer + size - line;
+	if (rest >= MAX_LINE_LENGTH) {
+		demux->malformed_lines++;
+		return 0;
+	}
+	memmove(buffer, line, rest);
+	return rest;
+}
+
+static void sleep_ms(unsigned int milliseconds)
+{
+	struct timespec time = {
+		.tv_sec = milliseconds / 1000,
+		.tv_nsec = (milliseconds % 1000) * 1000000L
+	};
+	nanosleep(&time, NULL);
+}
+
+/**
+ * read_update_interval_ms - Read the update interval from the memutil infofile.
+ *                           Returns 0 if it is not available.
+ */
+static unsigned int read_update_interval_ms(void)
+{
+	char line[128];
+	unsigned int interval = 0;
+	FILE *info = fopen(DEFAULT_INFO, "r");
+
+	if (!info) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), info)) {
+		if (sscanf(line, "update_interval=%u", &interval) == 1) {
+			break;
+		}
+	}
+	fclose(info);
+	return interval;
+}
+
+/**
+ * drain_pass - Read the source until the end of the current pass over the
+ *              ringbuffers. Returns the amount of bytes of an incomplete line
+ *              at the start of the buffer, like handle_chunk.
+ */
+static size_t drain_pass(struct demux *demux, int fd, char *buffer, size_t buffered)
+{
+	ssize_t bytes_read;
+
+	for (;;) {
+		bytes_read = read(fd, buffer + buffered, READ_CHUNK_SIZE);
+		if (bytes_read > 0) {
+			buffered = handle_chunk(demux, buffer, buffered + bytes_read);
+		} else if (bytes_read == 0 || errno != EINTR) {
+			return buffered;
+		}
+	}
+}
+
+static int run(struct demux *demux, const char *source, unsigned int interval_ms, bool one_shot)
+{
+	char *buffer = malloc(READ_CHUNK_SIZE + MAX_LINE_LENGTH);
+	bool from_stdin = !strcmp(source, "-");
+	size_t buffered = 0;
+	ssize_t bytes_read;
+	int fd = -1;
+
+	if (!buffer) {
+		return -1;
+	}
+	while (!should_stop) {
+		if (fd < 0) {
+			fd = from_stdin ? STDIN_FILENO : open(source, O_RDONLY);
+			if (fd < 0) {
+				if (one_shot) {
+					fprintf(stderr, "Failed to open %s: %s\n", source, strerror(errno));
+					break;
+				}
+				sleep_ms(interval_ms);
+				continue;
+			}
+		}
+		bytes_read = read(fd, buffer + buffered, READ_CHUNK_SIZE);
+		if (bytes_read > 0) {
+			buffered = handle_chunk(demux, buffer, buffered + bytes_read);
+			continue;
+		}
+		if (bytes_read < 0 && errno == EINTR) {
+			continue;
+		}
+		if (one_shot || from_stdin) {
+			break;
+		}
+		if (bytes_read < 0) {
+			//e.g. the governor was stopped, try to reopen later
+			close(fd);
+			fd = -1;
+		}
+		//end of one pass over all ringbuffers, wait for new data
+		sleep_ms(interval_ms);
+	}
+	if (should_stop && !from_stdin) {
+		/*
+		 * Take what was logged until the signal: finish the current pass
+		 * (the ringbuffers read before it got new data since) and do another one.
+		 */
+		if (fd < 0) {
+			fd = open(source, O_RDONLY);
+		}
+		if (fd >= 0) {
+			buffered = drain_pass(demux, fd, buffer, buffered);
+			drain_pass(demux, fd, buffer, buffered);
+		}
+	}
+	if (fd >= 0 && !from_stdin) {
+		close(fd);
+	}
+	free(buffer);
+	return 0;
+}
+
+static void finish(struct demux *demux)
+{
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < demux->cpu_count; ++cpu) {
+		struct cpu_output *output = &demux->cpus[cpu];
+
+		if (!output->in_use) {
+			continue;
+		}
+		flush_cpu(demux, output);
+		fclose(output->mcol);
+		if (output->csv) {
+			fclose(output->csv);
+		}
+		free(output->rows);
+		fprintf(stderr, "cpu %u: %" PRIu64 " records, %" PRIu64 " lost, %" PRIu64 " long intervals\n", cpu,
+			output->records, output->lost, output->long_intervals);
+	}
+	if (demux->malformed_lines) {
+		fprintf(stderr, "%" PRIu64 " malformed lines skipped\n", demux->malformed_lines);
+	}
+	free(demux->cpus);
+	free(demux->payload);
+}
+
+/**
+ * decode - Print the given columnar file as csv
+ */
+static int decode(const char *path)
+{
+	uint8_t header[MCOL_HEADER_SIZE];
+	uint64_t *rows = NULL;
+	uint8_t *payload = NULL;
+	int return_value = EXIT_FAILURE;
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	while (fread(header, sizeof(header), 1, file) == 1) {
+		unsigned int column_count = header[5];
+		uint32_t row_count = get_u32(header + 8);
+		uint32_t payload_size = get_u32(header + 12);
+		size_t offset = 0, size;
+		unsigned int row, column;
+		uint64_t previous;
+
+		if (memcmp(header, MCOL_MAGIC, 4) || header[4] != MCOL_VERSION || column_count == 0) {
+			fprintf(stderr, "Invalid block header\n");
+			goto out;
+		}
+		free(rows);
+		free(payload);
+		rows = malloc((size_t)row_count * column_count * sizeof(uint64_t));
+		payload = malloc(payload_size);
+		if (!rows || !payload || fread(payload, payload_size, 1, file) != 1) {
+			fprintf(stderr, "Failed to read block\n");
+			goto out;
+		}
+		for (column = 0; column < column_count; ++column) {
+			previous = 0;
+			for (row = 0; row < row_count; ++row) {
+				size = get_varint(payload + offset, payload_size - offset, previous,
+						  &rows[row * column_count + column]);
+				if (!size) {
+					fprintf(stderr, "Malformed block payload\n");
+					goto out;
+				}
+				offset += size;
+				previous = rows[row * column_count + column];
+			}
+		}
+		for (row = 0; row < row_count; ++row) {
+			for (column = 0; column < column_count; ++column) {
+				printf(column ? ",%" PRIu64 : "%" PRIu64, rows[row * column_count + column]);
+			}
+			putchar('\n');
+		}
+	}
+	return_value = EXIT_SUCCESS;
+out:
+	free(rows);
+	free(payload);
+	fclose(file);
+	return return_value;
+}
+
+int main(int argc, char **argv)
+{
+	struct demux demux = {
+		.block_rows = DEFAULT_BLOCK_ROWS,
+	};
+	const char *source = DEFAULT_SOURCE;
+	unsigned int interval_ms = DEFAULT_INTERVAL_MS;
+	unsigned int long_ms = 0;
+	bool one_shot = false;
+	struct sigaction action;
+	int option;
+
+	while ((option = getopt(argc, argv, "hs:i:l:b:cod:")) != -1) {
+		switch (option) {
+		case 's':
+			source = optarg;
+			break;
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			long_ms = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			demux.block_rows = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			demux.write_csv = true;
+			break;
+		case 'o':
+			one_shot = true;
+			break;
+		case 'd':
+			return decode(optarg);
+		case 'h':
+		default:
+			usage(argv[0]);
+			return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (optind + 1 != argc || demux.block_rows == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	demux.output_dir = argv[optind];
+
+	if (long_ms == 0) {
+		unsigned int update_interval_ms = read_update_interval_ms();
+
+		long_ms = update_interval_ms ? LONG_INTERVAL_FACTOR * update_interval_ms : 50;
+	}
+	demux.long_interval_ns = (uint64_t)long_ms * 1000000;
+	demux.payload_size = (size_t)demux.block_rows * MAX_COLUMNS * MAX_VARINT_SIZE;
+	demux.payload = malloc(demux.payload_size);
+	if (!demux.payload) {
+		return EXIT_FAILURE;
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	run(&demux, source, interval_ms, one_shot);
+	finish(&demux);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,689 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_sim.c
+ *
+ * Userspace simulator that replays a recorded memutil log through the
+ * heuristics of the governor (memutil_heuristic.c is compiled in unchanged).
+ * For every parameter set it reports which frequencies the governor would
+ * have chosen and the estimated time and energy compared to the recorded run.
+ * Many parameter sets can be evaluated in one pass over the log, which allows
+ * offline parameter sweeps over production traces.
+ *
+ * Input: csv lines in the log format cpu,timestamp,perf_value1,perf_value2,
+ * perf_value3,requested_freq (further columns are ignored), e.g. the log-N.txt
+ * files of memutil-logdemux or the output of memutil-logdemux -d. The records
+ * of each cpu have to be in timestamp order.
+ *
+ * The replay is open loop: the counter values of the trace are used as they
+ * were recorded, even though they would have been different at the simulated
+ * frequency. Time and energy are estimated with a simple model:
+ *  - The busy time of an interval is cycles / recorded frequency.
+ *  - A fraction beta of the busy time is memory bound and does not scale with
+ *    the frequency, the rest scales with recorded / simulated frequency.
+ *    beta is the stalls per cycle of the interval (or fixed with -b).
+ *  - Busy power is static + dynamic * (f / max_freq)^3, idle power is constant
+ *    and the idle time of an interval is not changed by the simulation.
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memutil_heuristic.h"
+#include "memutil_autorange.h"
+
+#define READ_CHUNK_SIZE (1024 * 1024)
+/* Maximum length of one log line */
+#define MAX_LINE_LENGTH 1024
+/* Columns of the log that are used by the simulation */
+#define LOG_COLUMNS 6
+#define MAX_PARAM_SETS 4096
+/* Default power model (in watts) */
+#define DEFAULT_STATIC_POWER 1.0
+#define DEFAULT_DYNAMIC_POWER 8.0
+#define DEFAULT_IDLE_POWER 0.5
+/* Default slowdown budget (in permille) of the budget heuristic */
+#define DEFAULT_SLOWDOWN_BUDGET 50
+/*
+ * Phase change of the auto-ranging check (-c): decay steps of a phase that
+ * covers all ratios, the ratios (in percent) of the following phase, the decay
+ * steps after which the range has to match them and the tolerance of the match
+ */
+#define CHECK_FIRST_PHASE_STEPS 64
+#define CHECK_SECOND_PHASE_MIN 100
+#define CHECK_SECOND_PHASE_MAX 120
+#define CHECK_CONVERGENCE_STEPS 128
+#define CHECK_TOLERANCE 4
+
+/**
+ * struct sample - One record of the log
+ *
+ * @cpu: The cpu
+ * @timestamp: Timestamp (ns)
+ * @values: The perf event values (see MEMUTIL_VALUE_*)
+ * @freq: Frequency (KHz) that was requested by the recorded run
+ */
+struct sample {
+	unsigned int cpu;
+	u64 timestamp;
+	u64 values[3];
+	unsigned int freq;
+};
+
+/**
+ * struct result - Accumulated estimate of one parameter set (or the recorded run)
+ *
+ * @busy_ns: Estimated busy time
+ * @freq_busy_ns: Sum of frequency * busy time, for the mean frequency
+ * @energy_j: Estimated energy
+ * @changes: Amount of decisions that changed the frequency
+ */
+struct result {
+	double busy_ns;
+	double freq_busy_ns;
+	double energy_j;
+	uint64_t changes;
+};
+
+/**
+ * struct cpu_state - Replay state of one cpu
+ *
+ * @seen: Whether a record of this cpu was seen
+ * @last_timestamp: Timestamp of the last record
+ * @last_freq: Frequency requested by the recorded run at the last record
+ * @sim_freq: Frequency requested by each parameter set at the last record
+ * @params: Current thresholds of each parameter set (only with auto-ranging)
+ * @autorange: Auto-ranging state of each parameter set (only with auto-ranging)
+ */
+struct cpu_state {
+	bool seen;
+	u64 last_timestamp;
+	unsigned int last_freq;
+	unsigned int *sim_freq;
+	struct memutil_heuristic_params *params;
+	struct memutil_autorange *autorange;
+};
+
+/**
+ * struct simulation - Configuration and state of the simulation
+ *
+ * @heuristic: HEURISTIC_IPC, HEURISTIC_OFFCORE_STALLS or HEURISTIC_SLOWDOWN_BUDGET
+ * @params: The parameter sets
+ * @param_count: Amount of parameter sets
+ * @min_freq: Minimum frequency (KHz), 0 if it should be taken from the trace
+ * @max_freq: Maximum frequency (KHz), 0 if it should be taken from the trace
+ * @autorange: Whether the thresholds are auto-ranged, starting from each parameter set
+ * @beta: Fixed memory bound fraction (0..1), negative to use stalls / cycles
+ * @static_power: Static busy power (W)
+ * @dynamic_power: Dynamic power at max_freq (W)
+ * @idle_power: Idle power (W)
+ * @timeline: Output for the frequency timeline, NULL if disabled
+ * @cpus: The replay state of each cpu
+ * @cpu_count: Amount of entries in cpus
+ * @recorded: Estimate of the recorded run
+ * @results: Estimate of each parameter set
+ * @samples: Amount of replayed records
+ * @malformed_lines: Amount of lines that could not be parsed
+ */
+struct simulation {
+	int heuristic;
+	struct memutil_heuristic_params params[MAX_PARAM_SETS];
+	unsigned int param_count;
+	int min_freq;
+	int max_freq;
+	bool autorange;
+	double beta;
+	double static_power;
+	double dynamic_power;
+	double idle_power;
+	FILE *timeline;
+	struct cpu_state *cpus;
+	unsigned int cpu_count;
+	struct result recorded;
+	struct result results[MAX_PARAM_SETS];
+	uint64_t samples;
+	uint64_t malformed_lines;
+};
+
+typedef void (*sample_fn)(struct simulation *sim, const struct sample *sample);
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-c] [-H ipc|stalls|budget (stalls) | -p MIN:MAX ... | -S MIN_FROM:MIN_TO:MAX_FROM:MAX_TO:STEP | -a | -B PERMILLE |\n"
+		"          -T BASE_KHZ:RATIO | -f MIN_KHZ:MAX_KHZ | -b BETA_PCT | -P STATIC:DYNAMIC:IDLE | -t TIMELINE] [log.csv ...]\n"
+		"\n"
+		"Replays memutil logs (csv, - or no file for stdin) through the heuristic and\n"
+		"prints the estimated time and energy of each parameter set as csv.\n"
+		"Parameters:\n"
+		"\t-H: Heuristic to simulate\n"
+		"\t-p MIN:MAX: Parameter set (min/max stalls per cycle or IPC, * 100). Can be repeated.\n"
+		"\t            Defaults to the defaults of the governor.\n"
+		"\t-S ...: Add all parameter sets of a grid, MIN < MAX\n"
+		"\t-B PERMILLE: Slowdown budget of the budget heuristic (%d)\n"
+		"\t-a: Auto-range the thresholds like the governor's autorange mode, starting\n"
+		"\t    from each parameter set\n"
+		"\t-T BASE_KHZ:RATIO: Only enter the turbo range above BASE_KHZ at a stalls per\n"
+		"\t                   cycle <= RATIO (IPC >= RATIO with -H ipc), like the governor\n"
+		"\t-f MIN_KHZ:MAX_KHZ: Frequency range of the policy. Defaults to the lowest and\n"
+		"\t                    highest requested frequency of the trace (needs files).\n"
+		"\t-b BETA_PCT: Use a fixed memory bound fraction (in percent) instead of the\n"
+		"\t             stalls per cycle, e.g. for traces recorded with the IPC heuristic\n"
+		"\t-P STATIC:DYNAMIC:IDLE: Power model in watts (%g:%g:%g)\n"
+		"\t-t TIMELINE: Write set,cpu,timestamp,recorded_freq,simulated_freq for every\n"
+		"\t             record and parameter set into the file TIMELINE\n"
+		"\t-c: Check that the auto-ranging follows a phase change and exit\n",
+		name, DEFAULT_SLOWDOWN_BUDGET, DEFAULT_STATIC_POWER, DEFAULT_DYNAMIC_POWER, DEFAULT_IDLE_POWER);
+}
+
+/**
+ * parse_line - Parse the first LOG_COLUMNS columns of a log line.
+ *
+ *              Returns false if the line is no valid record (e.g. a header).
+ */
+static bool parse_line(const char *line, const char *end, struct sample *sample)
+{
+	u64 columns[LOG_COLUMNS];
+	unsigned int column;
+
+	for (column = 0; column < LOG_COLUMNS; ++column) {
+		u64 value = 0;
+		const char *start = line;
+
+		while (line < end && *line >= '0' && *line <= '9') {
+			value = value * 10 + (*line - '0');
+			++line;
+		}
+		if (line == start) {
+			return false;
+		}
+		columns[column] = value;
+		if (column + 1 < LOG_COLUMNS) {
+			if (line == end || *line != ',') {
+				return false;
+			}
+			++line;
+		}
+	}
+	sample->cpu = columns[0];
+	sample->timestamp = columns[1];
+	sample->values[0] = columns[2];
+	sample->values[1] = columns[3];
+	sample->values[2] = columns[4];
+	sample->freq = columns[5];
+	return true;
+}
+
+/**
+ * read_log - Parse all records of the given file and pass them to fn.
+ *
+ *            Returns 0 on success, -1 if the file could not be read.
+ */
+static int read_log(struct simulation *sim, FILE *file, sample_fn fn)
+{
+	char *buffer = malloc(READ_CHUNK_SIZE + MAX_LINE_LENGTH);
+	size_t used = 0, count;
+	struct sample sample;
+
+	if (!buffer) {
+		return -1;
+	}
+	for (;;) {
+		char *line, *newline, *end;
+
+		count = fread(buffer + used, 1, READ_CHUNK_SIZE + MAX_LINE_LENGTH - used, file);
+		if (count == 0 && used == 0) {
+			break;
+		}
+		end = buffer + used + count;
+		if (count == 0) {
+			//last line without newline
+			*end++ = '\n';
+		}
+		line = buffer;
+		while ((newline = memchr(line, '\n', end - line))) {
+			if (parse_line(line, newline, &sample)) {
+				fn(sim, &sample);
+			} else if (newline != line && *line >= '0' && *line <= '9') {
+				sim->malformed_lines++;
+			}
+			line = newline + 1;
+		}
+		used = end - line;
+		if (used >= MAX_LINE_LENGTH) {
+			//overlong line, skip it
+			sim->malformed_lines++;
+			used = 0;
+		}
+		memmove(buffer, line, used);
+	}
+	free(buffer);
+	return ferror(file) ? -1 : 0;
+}
+
+static void scan_frequency_range(struct simulation *sim, const struct sample *sample)
+{
+	if (sample->freq == 0) {
+		return;
+	}
+	if (sim->min_freq == 0 || (int)sample->freq < sim->min_freq) {
+		sim->min_freq = sample->freq;
+	}
+	if ((int)sample->freq > sim->max_freq) {
+		sim->max_freq = sample->freq;
+	}
+}
+
+/**
+ * get_cpu_state - Get the replay state of the given cpu, allocating it if needed
+ */
+static struct cpu_state *get_cpu_state(struct simulation *sim, unsigned int cpu)
+{
+	if (cpu >= sim->cpu_count) {
+		unsigned int count = cpu + 1;
+		struct cpu_state *cpus = realloc(sim->cpus, count * sizeof(*cpus));
+
+		if (!cpus) {
+			return NULL;
+		}
+		memset(cpus + sim->cpu_count, 0, (count - sim->cpu_count) * sizeof(*cpus));
+		sim->cpus = cpus;
+		sim->cpu_count = count;
+	}
+	if (!sim->cpus[cpu].sim_freq) {
+		struct cpu_state *state = &sim->cpus[cpu];
+		unsigned int i;
+
+		state->sim_freq = malloc(sim->param_count * sizeof(unsigned int));
+		if (!state->sim_freq) {
+			return NULL;
+		}
+		if (sim->autorange) {
+			state->params = malloc(sim->param_count * sizeof(*state->params));
+			state->autorange = malloc(sim->param_count * sizeof(*state->autorange));
+			if (!state->params || !state->autorange) {
+				return NULL;
+			}
+			for (i = 0; i < sim->param_count; ++i) {
+				state->params[i] = sim->params[i];
+				memutil_autorange_init(&state->autorange[i], &sim->params[i]);
+			}
+		}
+	}
+	return &sim->cpus[cpu];
+}
+
+static double busy_power(struct simulation *sim, double freq)
+{
+	double relative_freq = freq / sim->max_freq;
+
+	return sim->static_power + sim->dynamic_power * relative_freq * relative_freq * relative_freq;
+}
+
+/**
+ * account_interval - Add the estimate of one interval run at freq to result
+ * @busy_ns: Busy time of the interval at the recorded frequency
+ * @recorded_freq: Frequency the interval was recorded at
+ * @idle_ns: Idle time of the interval
+ * @beta: Memory bound fraction of the busy time
+ */
+static void account_interval(struct simulation *sim, struct result *result, double busy_ns,
+			     double recorded_freq, double idle_ns, double beta, double freq)
+{
+	double scaled_busy_ns = busy_ns * ((1.0 - beta) * recorded_freq / freq + beta);
+
+	result->busy_ns += scaled_busy_ns;
+	result->freq_busy_ns += freq * scaled_busy_ns;
+	result->energy_j += (busy_power(sim, freq) * scaled_busy_ns + sim->idle_power * idle_ns) * 1e-9;
+}
+
+static void replay_sample(struct simulation *sim, const struct sample *sample)
+{
+	struct cpu_state *state = get_cpu_state(sim, sample->cpu);
+	bool has_interval;
+	double busy_ns = 0, idle_ns = 0, beta = 0;
+	double recorded_freq;
+	unsigned int i, new_freq;
+	s64 ratio;
+
+	if (!state) {
+		sim->malformed_lines++;
+		return;
+	}
+	has_interval = state->seen && sample->timestamp > state->last_timestamp && state->last_freq != 0;
+	recorded_freq = state->last_freq;
+	if (has_interval) {
+		double interval_ns = sample->timestamp - state->last_timestamp;
+		double cycles = sample->values[MEMUTIL_VALUE_CYCLES];
+
+		// cycles / KHz = ms, so * 1e6 for ns
+		busy_ns = cycles * 1e6 / recorded_freq;
+		if (busy_ns > interval_ns) {
+			busy_ns = interval_ns;
+		}
+		idle_ns = interval_ns - busy_ns;
+		if (sim->beta >= 0) {
+			beta = sim->beta;
+		} else if (cycles > 0) {
+			beta = sample->values[MEMUTIL_VALUE_STALLS] / cycles;
+			beta = beta > 1.0 ? 1.0 : beta;
+		}
+		account_interval(sim, &sim->recorded, busy_ns, recorded_freq, idle_ns, beta, recorded_freq);
+		if (sample->freq != state->last_freq) {
+			sim->recorded.changes++;
+		}
+	}
+
+	for (i = 0; i < sim->param_count; ++i) {
+		unsigned int last_freq = state->seen ? state->sim_freq[i] : (unsigned int)sim->max_freq;
+		/*
+		 * The budget heuristic derives the stall time from the frequency the
+		 * counters were measured at, which is the recorded one in the replay
+		 */
+		unsigned int counter_freq = sim->heuristic == HEURISTIC_SLOWDOWN_BUDGET && has_interval ?
+					    state->last_freq : last_freq;
+
+		if (has_interval) {
+			account_interval(sim, &sim->results[i], busy_ns, recorded_freq, idle_ns, beta, last_freq);
+		}
+		if (sim->autorange) {
+			new_freq = memutil_decide_frequency(sim->heuristic, sample->values, sim->max_freq, sim->min_freq,
+							    counter_freq, &state->params[i], &ratio);
+			if (ratio >= 0) {
+				memutil_autorange_update(&state->autorange[i], ratio, false, false, &state->params[i]);
+			}
+		} else {
+			new_freq = memutil_decide_frequency(sim->heuristic, sample->values, sim->max_freq, sim->min_freq,
+							    counter_freq, &sim->params[i], &ratio);
+		}
+		if (state->seen && new_freq != last_freq) {
+			sim->results[i].changes++;
+		}
+		state->sim_freq[i] = new_freq;
+		if (sim->timeline) {
+			fprintf(sim->timeline, "%u,%u,%" PRIu64 ",%u,%u\n", i, sample->cpu, sample->timestamp,
+				sample->freq, new_freq);
+		}
+	}
+
+	state->seen = true;
+	state->last_timestamp = sample->timestamp;
+	state->last_freq = sample->freq;
+	sim->samples++;
+}
+
+static void print_result(struct simulation *sim, const char *name, int min_ratio, int max_ratio,
+			 const struct result *result)
+{
+	const struct result *recorded = &sim->recorded;
+
+	printf("%s,%d,%d,%" PRIu64 ",%.0f,%" PRIu64 ",%.6f,%.6f,%.2f,%.2f\n",
+	       name, min_ratio, max_ratio, sim->samples,
+	       result->busy_ns > 0 ? result->freq_busy_ns / result->busy_ns : 0.0, result->changes,
+	       result->busy_ns * 1e-9, result->energy_j,
+	       recorded->busy_ns > 0 ? (result->busy_ns / recorded->busy_ns - 1.0) * 100.0 : 0.0,
+	       recorded->energy_j > 0 ? (result->energy_j / recorded->energy_j - 1.0) * 100.0 : 0.0);
+}
+
+static bool add_param_set(struct simulation *sim, int min_ratio, int max_ratio)
+{
+	if (sim->param_count >= MAX_PARAM_SETS) {
+		fprintf(stderr, "Too many parameter sets (max %d)\n", MAX_PARAM_SETS);
+		return false;
+	}
+	sim->params[sim->param_count].min_ratio = min_ratio;
+	sim->params[sim->param_count].max_ratio = max_ratio;
+	sim->param_count++;
+	return true;
+}
+
+static bool add_param_grid(struct simulation *sim, const char *grid)
+{
+	int min_from, min_to, max_from, max_to, step, min_ratio, max_ratio;
+
+	if (sscanf(grid, "%d:%d:%d:%d:%d", &min_from, &min_to, &max_from, &max_to, &step) != 5 || step <= 0) {
+		fprintf(stderr, "Invalid grid %s\n", grid);
+		return false;
+	}
+	for (min_ratio = min_from; min_ratio <= min_to; min_ratio += step) {
+		for (max_ratio = max_from; max_ratio <= max_to; max_ratio += step) {
+			if (min_ratio < max_ratio && !add_param_set(sim, min_ratio, max_ratio)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * check_autorange - Feed a phase with ratios all over the histogram and then a
+ *                   phase with a narrow range of ratios through the
+ *                   auto-ranging. The range has to converge to the percentiles
+ *                   of the second phase, i.e. the first phase has to decay
+ *                   completely.
+ *
+ *                   Returns EXIT_SUCCESS if it does.
+ */
+static int check_autorange(void)
+{
+	static struct memutil_autorange autorange;
+	struct memutil_heuristic_params params = { .min_ratio = 10, .max_ratio = 65 };
+	const s32 span = CHECK_SECOND_PHASE_MAX - CHECK_SECOND_PHASE_MIN;
+	const s32 expected_min = CHECK_SECOND_PHASE_MIN + span * MEMUTIL_AUTORANGE_LOW_PERCENTILE / 100;
+	const s32 expected_max = CHECK_SECOND_PHASE_MIN + span * MEMUTIL_AUTORANGE_HIGH_PERCENTILE / 100;
+	unsigned int step, decision;
+	bool converged;
+
+	memutil_autorange_init(&autorange, &params);
+	for (step = 0; step < CHECK_FIRST_PHASE_STEPS * MEMUTIL_AUTORANGE_DECAY_INTERVAL; ++step) {
+		memutil_autorange_update(&autorange, step % (MEMUTIL_AUTORANGE_BUCKETS * MEMUTIL_AUTORANGE_BUCKET_WIDTH),
+					 false, false, &params);
+	}
+	printf("first phase: %d,%d\n", params.min_ratio, params.max_ratio);
+	for (step = 0; step < CHECK_CONVERGENCE_STEPS; ++step) {
+		for (decision = 0; decision < MEMUTIL_AUTORANGE_DECAY_INTERVAL; ++decision) {
+			memutil_autorange_update(&autorange, CHECK_SECOND_PHASE_MIN + decision % span, false, false,
+						 &params);
+		}
+	}
+	converged = abs(params.min_ratio - expected_min) <= CHECK_TOLERANCE &&
+		    abs(params.max_ratio - expected_max) <= CHECK_TOLERANCE;
+	printf("second phase: %d,%d (expected %d,%d): %s\n", params.min_ratio, params.max_ratio, expected_min,
+	       expected_max, converged ? "converged" : "FAILED");
+	return converged ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * for_each_input - Run read_log with fn for all input files (stdin if none)
+ */
+static int for_each_input(struct simulation *sim, int count, char **paths, sample_fn fn)
+{
+	int i;
+
+	if (count == 0) {
+		return read_log(sim, stdin, fn);
+	}
+	for (i = 0; i < count; ++i) {
+		FILE *file = strcmp(paths[i], "-") == 0 ? stdin : fopen(paths[i], "r");
+		int result;
+
+		if (!file) {
+			fprintf(stderr, "Failed to open %s: %s\n", paths[i], strerror(errno));
+			return -1;
+		}
+		result = read_log(sim, file, fn);
+		if (file != stdin) {
+			fclose(file);
+		}
+		if (result) {
+			fprintf(stderr, "Failed to read %s\n", paths[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct simulation sim = {
+		.heuristic = HEURISTIC_OFFCORE_STALLS,
+		.beta = -1,
+		.static_power = DEFAULT_STATIC_POWER,
+		.dynamic_power = DEFAULT_DYNAMIC_POWER,
+		.idle_power = DEFAULT_IDLE_POWER,
+	};
+	const char *timeline_path = NULL;
+	struct timespec start, end;
+	double seconds;
+	unsigned int i;
+	int option, min_ratio, max_ratio, slowdown_budget = DEFAULT_SLOWDOWN_BUDGET;
+	int base_freq = 0, turbo_ratio = 0;
+
+	while ((option = getopt(argc, argv, "hcH:p:S:aB:T:f:b:P:t:")) != -1) {
+		switch (option) {
+		case 'c':
+			return check_autorange();
+		case 'H':
+			if (strcmp(optarg, "ipc") == 0) {
+				sim.heuristic = HEURISTIC_IPC;
+			} else if (strcmp(optarg, "stalls") == 0) {
+				sim.heuristic = HEURISTIC_OFFCORE_STALLS;
+			} else if (strcmp(optarg, "budget") == 0) {
+				sim.heuristic = HEURISTIC_SLOWDOWN_BUDGET;
+			} else {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'p':
+			if (sscanf(optarg, "%d:%d", &min_ratio, &max_ratio) != 2 ||
+			    !add_param_set(&sim, min_ratio, max_ratio)) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'S':
+			if (!add_param_grid(&sim, optarg)) {
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'a':
+			sim.autorange = true;
+			break;
+		case 'B':
+			slowdown_budget = atoi(optarg);
+			if (slowdown_budget <= 0) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'T':
+			if (sscanf(optarg, "%d:%d", &base_freq, &turbo_ratio) != 2 || base_freq <= 0) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'f':
+			if (sscanf(optarg, "%d:%d", &sim.min_freq, &sim.max_freq) != 2 ||
+			    sim.min_freq <= 0 || sim.max_freq < sim.min_freq) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'b':
+			sim.beta = strtod(optarg, NULL) / 100.0;
+			break;
+		case 'P':
+			if (sscanf(optarg, "%lf:%lf:%lf", &sim.static_power, &sim.dynamic_power, &sim.idle_power) != 3) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 't':
+			timeline_path = optarg;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (sim.param_count == 0) {
+		//the defaults of the governor
+		if (sim.heuristic == HEURISTIC_IPC) {
+			add_param_set(&sim, 10, 45);
+		} else {
+			add_param_set(&sim, 10, 65);
+		}
+	}
+	for (i = 0; i < sim.param_count; ++i) {
+		sim.params[i].slowdown_budget = slowdown_budget;
+		sim.params[i].base_freq = base_freq;
+		sim.params[i].turbo_ratio = turbo_ratio;
+	}
+
+	if (sim.max_freq == 0) {
+		if (optind == argc) {
+			fprintf(stderr, "-f is needed when reading from stdin\n");
+			return EXIT_FAILURE;
+		}
+		if (for_each_input(&sim, argc - optind, argv + optind, scan_frequency_range) || sim.max_freq == 0) {
+			fprintf(stderr, "Could not determine the frequency range, use -f\n");
+			return EXIT_FAILURE;
+		}
+		sim.malformed_lines = 0;
+	}
+
+	if (timeline_path) {
+		sim.timeline = fopen(timeline_path, "w");
+		if (!sim.timeline) {
+			fprintf(stderr, "Failed to open %s: %s\n", timeline_path, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		fprintf(sim.timeline, "set,cpu,timestamp,recorded_freq,simulated_freq\n");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (for_each_input(&sim, argc - optind, argv + optind, replay_sample)) {
+		return EXIT_FAILURE;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (sim.timeline) {
+		fclose(sim.timeline);
+	}
+
+	printf("set,min_ratio,max_ratio,samples,mean_freq_khz,freq_changes,busy_s,energy_j,time_change_pct,energy_change_pct\n");
+	print_result(&sim, "recorded", 0, 0, &sim.recorded);
+	for (i = 0; i < sim.param_count; ++i) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "%u", i);
+		print_result(&sim, name, sim.params[i].min_ratio, sim.params[i].max_ratio, &sim.results[i]);
+	}
+
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	fprintf(stderr, "%" PRIu64 " samples, %u parameter sets, frequency range %d-%d KHz, %.2f s (%.1f M samples/s)\n",
+		sim.samples, sim.param_count, sim.min_freq, sim.max_freq, seconds,
+		seconds > 0 ? sim.samples / seconds * 1e-6 : 0.0);
+	if (sim.malformed_lines) {
+		fprintf(stderr, "%" PRIu64 " malformed lines skipped\n", sim.malformed_lines);
+	}
+	for (i = 0; i < sim.cpu_count; ++i) {
+		free(sim.cpus[i].sim_freq);
+		free(sim.cpus[i].params);
+		free(sim.cpus[i].autorange);
+	}
+	free(sim.cpus);
+	return EXIT_SUCCESS;
+}
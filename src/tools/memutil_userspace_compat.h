@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * memutil_userspace_compat.h
+ *
+ * Minimal replacements for the kernel types and helpers used by the parts of
+ * memutil that are also compiled into the userspace tools (currently
+ * memutil_heuristic.c and memutil_autorange.c for memutil-sim).
+ *
+ * Copyright (C) 2021-2022 Leon Matthes, Maximilian Stiede, Erik Griese
+ *
+ * Authors: Leon Matthes, Maximilian Stiede, Erik Griese
+ */
+
+#ifndef _MEMUTIL_USERSPACE_COMPAT_H
+#define _MEMUTIL_USERSPACE_COMPAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int64_t s64;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef uint32_t u32;
+typedef uint16_t u16;
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#define max(x, y) ((x) > (y) ? (x) : (y))
+#define clamp(val, lo, hi) min(max(val, lo), hi)
+#define min_t(type, x, y) min((type)(x), (type)(y))
+#define max_t(type, x, y) max((type)(x), (type)(y))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+
+#endif //_MEMUTIL_USERSPACE_COMPAT_H